@@ -2,21 +2,34 @@
 
 #include "aws_mqtt.h"
 #include "aws_mqtt_common.h"
+#include "aws_mqtt_tls.h"
 #include "system.h"
 
 #include "aws_iot_config.h"
 #include "aws_iot_log.h"
 #include "aws_iot_version.h"
 #include "aws_iot_mqtt_client_interface.h"
+#include "aws_iot_mqtt_client_common_internal.h"
 #include "aws_iot_shadow_interface.h"
 
 /***** Defines *****/
 
 #define AWS_TOPIC_NAME "hatchtrack/data/put"
 
+// MQTT PUBLISH packet type in the upper nibble of the fixed header.
+#define _MQTT_PUBLISH (0x30)
+// A remaining length takes at most 4 bytes.
+#define _MQTT_LEN_BYTES_MAX (4)
+
 /***** Local Data *****/
 
 static AWS_IoT_Client _client;
+// Streaming publish in progress, see aws_mqtt_publish_begin().
+static ClientState _publish_state;
+static char * _publish_topic = NULL;
+static uint32_t _publish_topic_len = 0;
+static uint32_t _publish_offset = 0;
+static bool _is_publishing = false;
 
 /***** Local Functions *****/
 
@@ -54,6 +67,97 @@ _subscribe_cb(AWS_IoT_Client * p_client, char * topic, uint16_t topic_len,
   cb(params->payload, params->payloadLen);
 }
 
+// Bytes it takes to encode an MQTT remaining length.
+static uint32_t
+_mqtt_len_bytes(uint32_t len)
+{
+  uint32_t bytes = 1;
+
+  while ((len >= 128) && (bytes < _MQTT_LEN_BYTES_MAX)) {
+    len /= 128;
+    bytes++;
+  }
+
+  return bytes;
+}
+
+static void
+_mqtt_len_write(uint8_t * buf, uint32_t len)
+{
+  do {
+    *buf = len % 128;
+    len /= 128;
+    *buf++ |= (len > 0) ? 0x80 : 0;
+  } while (len > 0);
+}
+
+// Write len bytes of buf to the network, the part of
+// aws_iot_mqtt_internal_send_packet() that does not assume the packet starts
+// at the beginning of the TX buffer.
+static bool
+_send(uint8_t * buf, uint32_t len)
+{
+  Timer timer;
+  size_t written = 0;
+  size_t sent = 0;
+  IoT_Error_t err = SUCCESS;
+
+  init_timer(&timer);
+  countdown_ms(&timer, _client.clientData.commandTimeoutMs);
+
+  while ((SUCCESS == err) && (sent < len) && !has_timer_expired(&timer)) {
+    written = 0;
+    err = _client.networkStack.write(&(_client.networkStack), &buf[sent],
+      len - sent, &timer, &written);
+    sent += written;
+  }
+
+  if (SUCCESS != err) {
+    LOGE("network write returned error %d", err);
+  }
+
+  return (sent == len) ? true : false;
+}
+
+// Write the headers of the streaming publish in front of its len bytes of
+// payload and send it.
+static bool
+_publish_send(uint32_t len, QoS qos, uint16_t packet_id)
+{
+  uint8_t * buf = _client.clientData.writeBuf;
+  uint32_t start = _publish_offset;
+  uint32_t remaining = 2 + _publish_topic_len + len;
+
+  if (QOS0 != qos) {
+    remaining += 2;
+    buf[--start] = packet_id & 0xff;
+    buf[--start] = packet_id >> 8;
+  }
+
+  start -= _publish_topic_len;
+  memcpy(&buf[start], _publish_topic, _publish_topic_len);
+  buf[--start] = _publish_topic_len & 0xff;
+  buf[--start] = _publish_topic_len >> 8;
+  start -= _mqtt_len_bytes(remaining);
+  _mqtt_len_write(&buf[start], remaining);
+  // AWS does not support retain.
+  buf[--start] = _MQTT_PUBLISH | (qos << 1);
+
+  return _send(&buf[start], _publish_offset + len - start);
+}
+
+static void
+_publish_release(void)
+{
+  if (_is_publishing) {
+    _is_publishing = false;
+    aws_iot_mqtt_client_unlock_mutex(&_client,
+      &(_client.clientData.tls_write_mutex));
+    aws_iot_mqtt_set_client_state(&_client,
+      CLIENT_STATE_CONNECTED_PUBLISH_IN_PROGRESS, _publish_state);
+  }
+}
+
 /***** Global Functions *****/
 
 bool
@@ -90,6 +194,10 @@ aws_mqtt_init(char * root_ca, char * client_cert, char * client_key,
     RESULT_TEST(SUCCESS == err, "aws_iot_mqtt_init returned error %d\n", err);
   }
 
+  if (r) {
+    _client.networkStack.connect = aws_mqtt_tls_connect;
+  }
+
   if (r) {
     LOGI("Connecting to AWS...");
     do {
@@ -123,6 +231,16 @@ aws_mqtt_disconnect(void)
 
 bool
 aws_mqtt_publish(char * topic, char * message, bool retain)
+{
+  printf("%s\n%s\n", topic, message);
+
+  return aws_mqtt_publish_bytes(topic, (uint8_t *) message, strlen(message),
+    retain);
+}
+
+bool
+aws_mqtt_publish_bytes(char * topic, uint8_t * payload, uint32_t len,
+  bool retain)
 {
   IoT_Publish_Message_Params publish_params;
   IoT_Error_t r = SUCCESS;
@@ -132,15 +250,148 @@ aws_mqtt_publish(char * topic, char * message, bool retain)
 
   publish_params.qos = QOS0;
   publish_params.isRetained = 0;
-  publish_params.payload = (void *) message;
-  publish_params.payloadLen = strlen(message);
+  publish_params.payload = (void *) payload;
+  publish_params.payloadLen = len;
 
-  printf("%s\n%s\n", topic, message);
   r = aws_iot_mqtt_publish(&_client, topic, strlen(topic), &publish_params);
 
   return (SUCCESS == r) ? true : false;
 }
 
+bool
+aws_mqtt_publish_begin(char * topic, uint8_t ** payload, uint32_t * payload_max)
+{
+  uint32_t buf_len = _client.clientData.writeBufSize;
+  IoT_Error_t err = SUCCESS;
+  bool r = true;
+
+  *payload = NULL;
+  *payload_max = 0;
+
+  if (_is_publishing || !aws_iot_mqtt_is_client_connected(&_client)) {
+    r = false;
+  }
+
+  if (r) {
+    _publish_state = aws_iot_mqtt_get_client_state(&_client);
+    r = (CLIENT_STATE_CONNECTED_IDLE == _publish_state) ||
+      (CLIENT_STATE_CONNECTED_WAIT_FOR_CB_RETURN == _publish_state);
+  }
+
+  if (r) {
+    err = aws_iot_mqtt_set_client_state(&_client, _publish_state,
+      CLIENT_STATE_CONNECTED_PUBLISH_IN_PROGRESS);
+    if (SUCCESS != err) {
+      LOGE("client busy (%d)", err);
+      r = false;
+    }
+  }
+
+  if (r) {
+    err = aws_iot_mqtt_client_lock_mutex(&_client,
+      &(_client.clientData.tls_write_mutex));
+    if (SUCCESS != err) {
+      LOGE("TX buffer lock failed (%d)", err);
+      aws_iot_mqtt_set_client_state(&_client,
+        CLIENT_STATE_CONNECTED_PUBLISH_IN_PROGRESS, _publish_state);
+      r = false;
+    }
+  }
+
+  if (r) {
+    _is_publishing = true;
+    _publish_topic = topic;
+    _publish_topic_len = strlen(topic);
+
+    // Neither the payload length nor the QoS are known yet, so room is kept
+    // for the longest remaining length the TX buffer can need and a packet
+    // id. _publish_send() writes the headers right up against the payload,
+    // the packet then starts wherever that leaves it.
+    _publish_offset = 1 + _mqtt_len_bytes(buf_len) + 2 + _publish_topic_len +
+      2;
+    r = (_publish_offset < buf_len);
+  }
+
+  if (r) {
+    *payload = &(_client.clientData.writeBuf[_publish_offset]);
+    *payload_max = buf_len - _publish_offset;
+  }
+  else if (_is_publishing) {
+    aws_mqtt_publish_end(0);
+  }
+
+  return r;
+}
+
+bool
+aws_mqtt_publish_end(uint32_t len)
+{
+  bool r = true;
+
+  if (!_is_publishing) {
+    r = false;
+  }
+  else if (len > 0) {
+    r = _publish_send(len, QOS0, 0);
+  }
+
+  _publish_release();
+
+  return r;
+}
+
+bool
+aws_mqtt_publish_end_qos1(uint32_t len, uint16_t * packet_id)
+{
+  bool r = true;
+
+  if (!_is_publishing || (0 == len)) {
+    r = false;
+  }
+
+  if (r) {
+    *packet_id = aws_iot_mqtt_get_next_packet_id(&_client);
+    r = _publish_send(len, QOS1, *packet_id);
+  }
+
+  _publish_release();
+
+  return r;
+}
+
+bool
+aws_mqtt_puback_wait(uint32_t timeout_ms, uint16_t * packet_id)
+{
+  Timer timer;
+  uint8_t packet_type = 0;
+  uint8_t dup = 0;
+  IoT_Error_t err = SUCCESS;
+  bool r = false;
+
+  init_timer(&timer);
+  countdown_ms(&timer, timeout_ms);
+
+  // Incoming messages other than a PUBACK are handled as in a yield.
+  do {
+    packet_type = 0;
+    err = aws_iot_mqtt_internal_cycle_read(&_client, &timer, &packet_type);
+
+    if ((SUCCESS == err) && (PUBACK == packet_type)) {
+      err = aws_iot_mqtt_internal_deserialize_ack(&packet_type, &dup,
+        packet_id, _client.clientData.readBuf,
+        _client.clientData.readBufSize);
+      r = (SUCCESS == err);
+    }
+  } while (!r && ((SUCCESS == err) || (MQTT_NOTHING_TO_READ == err)) &&
+    !has_timer_expired(&timer));
+
+  if ((SUCCESS != err) && (MQTT_NOTHING_TO_READ != err)) {
+    LOGE("error waiting for PUBACK (%d)", err);
+  }
+
+  return r;
+}
+
 bool
 aws_mqtt_subscribe(char * topic, aws_subscribe_cb cb)
 {
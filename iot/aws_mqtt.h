@@ -24,6 +24,36 @@ aws_mqtt_disconnect(void);
 extern bool
 aws_mqtt_publish(char * topic, char * message, bool retain);
 
+// Publish len bytes of binary payload.
+extern bool
+aws_mqtt_publish_bytes(char * topic, uint8_t * payload, uint32_t len,
+  bool retain);
+
+/*
+ * Streaming publish, the payload is written straight into the TX buffer of the
+ * MQTT client instead of being copied there from a buffer of the caller.
+ * aws_mqtt_publish_begin() points payload at the free part of the TX buffer
+ * and sets payload_max to its size, the payload length need not be known yet.
+ * aws_mqtt_publish_end() then sends the first len bytes written there with
+ * QoS 0, or drops the message if len is 0. The client is locked in between
+ * and topic has to stay valid.
+ */
+extern bool
+aws_mqtt_publish_begin(char * topic, uint8_t ** payload, uint32_t * payload_max);
+
+extern bool
+aws_mqtt_publish_end(uint32_t len);
+
+// Same as aws_mqtt_publish_end() but with QoS 1, without waiting for the
+// PUBACK. Sets packet_id to the id the PUBACK will carry.
+extern bool
+aws_mqtt_publish_end_qos1(uint32_t len, uint16_t * packet_id);
+
+// Wait up to timeout_ms for the next PUBACK and set packet_id to the id it
+// acknowledges. Fails on timeout.
+extern bool
+aws_mqtt_puback_wait(uint32_t timeout_ms, uint16_t * packet_id);
+
 extern bool
 aws_mqtt_subscribe(char * topic, aws_subscribe_cb cb);
 
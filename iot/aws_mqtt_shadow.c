@@ -1,7 +1,9 @@
 /***** Includes *****/
 
 #include "aws_mqtt_shadow.h"
+#include "aws_mqtt.h"
 #include "aws_mqtt_common.h"
+#include "aws_mqtt_tls.h"
 #include "system.h"
 
 #include "aws_iot_config.h"
@@ -13,22 +15,104 @@
 /***** Defines *****/
 
 #define _SHADOW_JSON_MAX_LEN 256
+#define _SHADOW_TOPIC_MAX_LEN 128
 
 /***** Local Data *****/
 
 static AWS_IoT_Client _client;
 static const char * _thing_name;
 static char * _js = NULL;
+// Shadow get over the aws_mqtt connection, the client keeps a pointer to the
+// topic it subscribed to.
+static char _get_topic[_SHADOW_TOPIC_MAX_LEN];
+static char _get_accepted_topic[_SHADOW_TOPIC_MAX_LEN];
+static char _get_rejected_topic[_SHADOW_TOPIC_MAX_LEN];
+static aws_mqtt_shadow_cb _get_shared_cb = NULL;
+static char _delta_topic[_SHADOW_TOPIC_MAX_LEN];
+static aws_mqtt_shadow_cb _delta_cb = NULL;
 
 /***** Local Functions *****/
 
+// Version of the len bytes of shadow document doc, 0 if it has none. The
+// top level "version" comes after the state and its metadata, which hold no
+// key of that name.
+static uint32_t
+_version(const char * doc, uint32_t len)
+{
+  const char * key = "\"version\":";
+  uint32_t key_len = strlen(key);
+  uint32_t version = 0;
+  uint32_t start = len;
+  uint32_t n = 0;
+
+  for (n = 0; (n + key_len) <= len; n++) {
+    if (0 == memcmp(&doc[n], key, key_len)) {
+      start = n + key_len;
+    }
+  }
+
+  for (n = start; (n < len) && (doc[n] >= '0') && (doc[n] <= '9'); n++) {
+    version = (version * 10) + (doc[n] - '0');
+  }
+
+  return version;
+}
+
+// Pass the "desired" object of the len bytes of shadow document doc to cb.
+// The object is expected to hold no nested objects.
+static void
+_desired(const char * doc, uint32_t len, aws_mqtt_shadow_cb cb)
+{
+  const char * key = "\"desired\":";
+  uint32_t key_len = strlen(key);
+  uint32_t start = 0;
+  uint32_t n = 0;
+
+  while (((start + key_len) <= len) &&
+         (0 != memcmp(&doc[start], key, key_len))) {
+    start++;
+  }
+
+  start += key_len;
+  n = start;
+  while ((n < len) && ('}' != doc[n])) {
+    n++;
+  }
+
+  if ((n < len) && ((n - start + 2) <= _SHADOW_JSON_MAX_LEN)) {
+    memcpy(_js, &doc[start], n - start + 1);
+    _js[n - start + 1] = 0;
+
+    cb((uint8_t *) _js, strlen(_js) + 1, _version(doc, len));
+  }
+}
+
+static void
+_get_accepted_cb(uint8_t * buf, uint16_t len)
+{
+  _desired((char *) buf, len, _get_shared_cb);
+}
+
+// The error document says why, a thing without a shadow gets a 404.
+static void
+_get_rejected_cb(uint8_t * buf, uint16_t len)
+{
+  LOGE("shadow get rejected: %.*s", len, (char *) buf);
+  _get_shared_cb(NULL, 0, 0);
+}
+
+static void
+_update_delta_cb(uint8_t * buf, uint16_t len)
+{
+  _delta_cb(buf, len, _version((char *) buf, len));
+}
+
 static void
 _shadow_get_cb(const char *pThingName, ShadowActions_t action,
   Shadow_Ack_Status_t status, const char *pReceivedJsonDocument,
   void *pContextData)
 {
   aws_mqtt_shadow_cb cb = (aws_mqtt_shadow_cb) pContextData;
-  char * js = NULL;
 
   if (SHADOW_GET != action) {
     LOGE("expected SHADOW_GET, but got %d", action);
@@ -41,29 +125,7 @@ _shadow_get_cb(const char *pThingName, ShadowActions_t action,
   }
 
   (void) pThingName;
-  js = strstr(pReceivedJsonDocument, "\"desired\":");
-  if (js) {
-    char * src = (char *) pReceivedJsonDocument;
-    uint32_t len = 0;
-    uint32_t m = 0;
-    uint32_t n = 0;
-
-    js += strlen("\"desired\":");
-    m = strlen(src);
-    n = js - src;
-
-    while (('}' != src[n]) && (n < m)) {
-      len++;
-      n++;
-    }
-
-    if (('}' == src[n]) && (n < m)) {
-      memcpy(_js, js, len + 1);
-      _js[len + 1] = 0;
-
-      cb((uint8_t *) _js, strlen(_js) + 1);
-    }
-  }
+  _desired(pReceivedJsonDocument, strlen(pReceivedJsonDocument), cb);
 }
 
 /***** Global Functions *****/
@@ -107,6 +169,10 @@ aws_mqtt_shadow_init(char * root_ca, char * client_cert, char * client_key,
     }
   }
 
+  if (r) {
+    _client.networkStack.connect = aws_mqtt_tls_connect;
+  }
+
   if (r) {
     LOGI("shadow connect");
     err = aws_iot_shadow_connect(&_client, &scp);
@@ -174,3 +240,67 @@ aws_mqtt_shadow_poll(uint32_t poll_ms)
 
   return (SUCCESS == err) ? true : false;
 }
+
+bool
+aws_mqtt_shadow_get_shared(char * thing_name, aws_mqtt_shadow_cb cb)
+{
+  bool r = true;
+
+  if (NULL == _js) {
+    _js = malloc(_SHADOW_JSON_MAX_LEN);
+    r = (NULL != _js);
+  }
+
+  if (r) {
+    _get_shared_cb = cb;
+    snprintf(_get_topic, sizeof(_get_topic), "$aws/things/%s/shadow/get",
+      thing_name);
+    snprintf(_get_accepted_topic, sizeof(_get_accepted_topic),
+      "$aws/things/%s/shadow/get/accepted", thing_name);
+    snprintf(_get_rejected_topic, sizeof(_get_rejected_topic),
+      "$aws/things/%s/shadow/get/rejected", thing_name);
+
+    LOGI("shadow get thing %s", thing_name);
+    r = aws_mqtt_subscribe(_get_accepted_topic, _get_accepted_cb);
+  }
+
+  if (r) {
+    r = aws_mqtt_subscribe(_get_rejected_topic, _get_rejected_cb);
+    if (!r) {
+      aws_mqtt_unsubscribe(_get_accepted_topic);
+    }
+  }
+
+  if (r) {
+    r = aws_mqtt_publish(_get_topic, "{}", false);
+    if (!r) {
+      aws_mqtt_shadow_get_shared_end();
+    }
+  }
+
+  return r;
+}
+
+bool
+aws_mqtt_shadow_get_shared_end(void)
+{
+  bool r = aws_mqtt_unsubscribe(_get_accepted_topic);
+
+  return aws_mqtt_unsubscribe(_get_rejected_topic) && r;
+}
+
+bool
+aws_mqtt_shadow_delta_shared(char * thing_name, aws_mqtt_shadow_cb cb)
+{
+  _delta_cb = cb;
+  snprintf(_delta_topic, sizeof(_delta_topic),
+    "$aws/things/%s/shadow/update/delta", thing_name);
+
+  return aws_mqtt_subscribe(_delta_topic, _update_delta_cb);
+}
+
+bool
+aws_mqtt_shadow_delta_shared_end(void)
+{
+  return aws_mqtt_unsubscribe(_delta_topic);
+}
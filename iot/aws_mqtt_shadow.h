@@ -8,8 +8,9 @@
 
 /***** Typedefs *****/
 
+// version is the one of the shadow document, 0 if it carries none.
 typedef void
-(*aws_mqtt_shadow_cb)(uint8_t * buf, uint16_t len);
+(*aws_mqtt_shadow_cb)(uint8_t * buf, uint16_t len, uint32_t version);
 
 /***** Global Functions *****/
 
@@ -26,4 +27,30 @@ aws_mqtt_shadow_get(aws_mqtt_shadow_cb cb, uint8_t timeout_sec);
 extern bool
 aws_mqtt_shadow_poll(uint32_t poll_ms);
 
+/*
+ * Get the shadow of thing_name over the connection of aws_mqtt_init() instead
+ * of one of its own, which saves a TLS handshake. Needs no
+ * aws_mqtt_shadow_init(). cb is passed the desired state as with
+ * aws_mqtt_shadow_get(), from within aws_mqtt_subscribe_poll(), until
+ * aws_mqtt_shadow_get_shared_end(). It is passed a NULL buf if the get is
+ * rejected, for instance because the thing has no shadow.
+ */
+extern bool
+aws_mqtt_shadow_get_shared(char * thing_name, aws_mqtt_shadow_cb cb);
+
+extern bool
+aws_mqtt_shadow_get_shared_end(void);
+
+/*
+ * Watch for updates of the shadow of thing_name over the connection of
+ * aws_mqtt_init(), until aws_mqtt_shadow_delta_shared_end(). cb is passed the
+ * whole delta document from within aws_mqtt_subscribe_poll(). Updates are
+ * only seen while connected, there is no persistent session.
+ */
+extern bool
+aws_mqtt_shadow_delta_shared(char * thing_name, aws_mqtt_shadow_cb cb);
+
+extern bool
+aws_mqtt_shadow_delta_shared_end(void);
+
 #endif
@@ -0,0 +1,339 @@
+/***** Includes *****/
+
+#include "aws_mqtt_tls.h"
+#include "system.h"
+#include "wake_timing.h"
+
+#include "esp_attr.h"
+#include "mbedtls/net.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/ctr_drbg.h"
+#include "lwip/sockets.h"
+
+/***** Defines *****/
+
+#define _SESSION_MAGIC (0x544c5331) // "TLS1"
+// AWS IoT tickets are around 200 bytes, larger ones are not cached.
+#define _TICKET_LEN_MAX (512)
+// Read timeout once connected, the SDK polls with short reads.
+#define _READ_TIMEOUT_MS (10)
+
+/***** Structs *****/
+
+// The session is copied by value with its pointers cleared; the ticket is
+// kept alongside. RTC slow memory is internal to the chip, but this does hold
+// the master secret of the session.
+struct _session {
+  uint32_t magic;
+  mbedtls_ssl_session session;
+  uint8_t ticket[_TICKET_LEN_MAX];
+};
+
+/***** Local Data *****/
+
+static RTC_DATA_ATTR struct _session _session;
+static RTC_DATA_ATTR uint32_t _handshakes;
+static RTC_DATA_ATTR uint32_t _resumed;
+
+static const char * _pers = "aws_mqtt_tls";
+
+/***** Local Functions *****/
+
+static bool
+_is_session_cached(void)
+{
+  return (_SESSION_MAGIC == _session.magic) ? true : false;
+}
+
+static void
+_session_save(mbedtls_ssl_context * ssl)
+{
+  mbedtls_ssl_session session;
+  bool r = true;
+
+  mbedtls_ssl_session_init(&session);
+  _session.magic = 0;
+
+  if (0 != mbedtls_ssl_get_session(ssl, &session)) {
+    r = false;
+  }
+
+  #if defined(MBEDTLS_SSL_SESSION_TICKETS)
+  if (r && (session.ticket_len > sizeof(_session.ticket))) {
+    LOGI("session ticket of %d bytes not cached", (int) session.ticket_len);
+    r = false;
+  }
+
+  if (r && (NULL != session.ticket)) {
+    memcpy(_session.ticket, session.ticket, session.ticket_len);
+  }
+  #endif
+
+  if (r) {
+    memcpy(&_session.session, &session, sizeof(session));
+    _session.session.peer_cert = NULL;
+    #if defined(MBEDTLS_SSL_SESSION_TICKETS)
+    _session.session.ticket = NULL;
+    #endif
+    _session.magic = _SESSION_MAGIC;
+  }
+
+  mbedtls_ssl_session_free(&session);
+}
+
+// mbedtls_ssl_set_session() takes a deep copy, so the ticket can be passed
+// straight from RTC memory.
+static void
+_session_offer(mbedtls_ssl_context * ssl)
+{
+  mbedtls_ssl_session session;
+
+  memcpy(&session, &_session.session, sizeof(session));
+  #if defined(MBEDTLS_SSL_SESSION_TICKETS)
+  session.ticket = (0 < session.ticket_len) ? _session.ticket : NULL;
+  #endif
+
+  if (0 != mbedtls_ssl_set_session(ssl, &session)) {
+    LOGE("failed to offer cached session");
+  }
+}
+
+// A resumed session keeps the master secret of the cached one, a full
+// handshake derives a new one.
+static bool
+_is_resumed(mbedtls_ssl_context * ssl)
+{
+  bool r = _is_session_cached();
+
+  if (r) {
+    r = (0 == memcmp(ssl->session->master, _session.session.master,
+      sizeof(_session.session.master))) ? true : false;
+  }
+
+  return r;
+}
+
+// Handshake errors of the network rather than of TLS, a cached session is not
+// to blame for those.
+static bool
+_is_transport_error(int ret)
+{
+  return ((MBEDTLS_ERR_SSL_TIMEOUT == ret) ||
+          (MBEDTLS_ERR_NET_RECV_FAILED == ret) ||
+          (MBEDTLS_ERR_NET_SEND_FAILED == ret) ||
+          (MBEDTLS_ERR_NET_CONN_RESET == ret)) ? true : false;
+}
+
+// is_rejected is set when the TLS handshake itself failed, as opposed to
+// DNS, TCP, a timeout or the local setup.
+static IoT_Error_t
+_connect(Network * network, bool is_resume, bool * is_rejected)
+{
+  TLSDataParams * tls = &(network->tlsDataParams);
+  TLSConnectParams * params = &(network->tlsConnectParams);
+  IoT_Error_t err = SUCCESS;
+  char port[6];
+  int one = 1;
+  int ret = 0;
+
+  *is_rejected = false;
+  mbedtls_net_init(&(tls->server_fd));
+  mbedtls_ssl_init(&(tls->ssl));
+  mbedtls_ssl_config_init(&(tls->conf));
+  mbedtls_ctr_drbg_init(&(tls->ctr_drbg));
+  mbedtls_x509_crt_init(&(tls->cacert));
+  mbedtls_x509_crt_init(&(tls->clicert));
+  mbedtls_pk_init(&(tls->pkey));
+  mbedtls_entropy_init(&(tls->entropy));
+
+  ret = mbedtls_ctr_drbg_seed(&(tls->ctr_drbg), mbedtls_entropy_func,
+    &(tls->entropy), (const unsigned char *) _pers, strlen(_pers));
+  if (0 != ret) {
+    LOGE("mbedtls_ctr_drbg_seed returned -0x%x", -ret);
+    err = NETWORK_MBEDTLS_ERR_CTR_DRBG_ENTROPY_SOURCE_FAILED;
+  }
+
+  if (SUCCESS == err) {
+    ret = mbedtls_x509_crt_parse(&(tls->cacert),
+      (const unsigned char *) params->pRootCALocation,
+      strlen(params->pRootCALocation) + 1);
+    if (0 > ret) {
+      LOGE("mbedtls_x509_crt_parse root CA returned -0x%x", -ret);
+      err = NETWORK_X509_ROOT_CRT_PARSE_ERROR;
+    }
+  }
+
+  if (SUCCESS == err) {
+    ret = mbedtls_x509_crt_parse(&(tls->clicert),
+      (const unsigned char *) params->pDeviceCertLocation,
+      strlen(params->pDeviceCertLocation) + 1);
+    if (0 != ret) {
+      LOGE("mbedtls_x509_crt_parse device cert returned -0x%x", -ret);
+      err = NETWORK_X509_DEVICE_CRT_PARSE_ERROR;
+    }
+  }
+
+  if (SUCCESS == err) {
+    ret = mbedtls_pk_parse_key(&(tls->pkey),
+      (const unsigned char *) params->pDevicePrivateKeyLocation,
+      strlen(params->pDevicePrivateKeyLocation) + 1, NULL, 0);
+    if (0 != ret) {
+      LOGE("mbedtls_pk_parse_key returned -0x%x", -ret);
+      err = NETWORK_PK_PRIVATE_KEY_PARSE_ERROR;
+    }
+  }
+
+  if (SUCCESS == err) {
+    snprintf(port, sizeof(port), "%d", params->DestinationPort);
+    ret = mbedtls_net_connect(&(tls->server_fd), params->pDestinationURL,
+      port, MBEDTLS_NET_PROTO_TCP);
+    if (0 != ret) {
+      LOGE("mbedtls_net_connect returned -0x%x", -ret);
+      err = (MBEDTLS_ERR_NET_UNKNOWN_HOST == ret) ?
+        NETWORK_ERR_NET_UNKNOWN_HOST : NETWORK_ERR_NET_CONNECT_FAILED;
+    }
+  }
+
+  if (SUCCESS == err) {
+    ret = mbedtls_net_set_block(&(tls->server_fd));
+    if (0 != ret) {
+      LOGE("mbedtls_net_set_block returned -0x%x", -ret);
+      err = SSL_CONNECTION_ERROR;
+    }
+  }
+
+  // The MQTT CONNECT right after a resumed handshake would otherwise wait for
+  // the delayed ACK of the client Finished, eating most of the gain.
+  if (SUCCESS == err) {
+    setsockopt(tls->server_fd.fd, IPPROTO_TCP, TCP_NODELAY, &one,
+      sizeof(one));
+  }
+
+  if (SUCCESS == err) {
+    ret = mbedtls_ssl_config_defaults(&(tls->conf), MBEDTLS_SSL_IS_CLIENT,
+      MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT);
+    if (0 != ret) {
+      LOGE("mbedtls_ssl_config_defaults returned -0x%x", -ret);
+      err = SSL_CONNECTION_ERROR;
+    }
+  }
+
+  if (SUCCESS == err) {
+    mbedtls_ssl_conf_authmode(&(tls->conf), (params->ServerVerificationFlag) ?
+      MBEDTLS_SSL_VERIFY_REQUIRED : MBEDTLS_SSL_VERIFY_OPTIONAL);
+    mbedtls_ssl_conf_rng(&(tls->conf), mbedtls_ctr_drbg_random,
+      &(tls->ctr_drbg));
+    mbedtls_ssl_conf_ca_chain(&(tls->conf), &(tls->cacert), NULL);
+    mbedtls_ssl_conf_read_timeout(&(tls->conf), params->timeout_ms);
+    #if defined(MBEDTLS_SSL_SESSION_TICKETS)
+    mbedtls_ssl_conf_session_tickets(&(tls->conf),
+      MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+    #endif
+
+    ret = mbedtls_ssl_conf_own_cert(&(tls->conf), &(tls->clicert),
+      &(tls->pkey));
+    if (0 != ret) {
+      LOGE("mbedtls_ssl_conf_own_cert returned -0x%x", -ret);
+      err = SSL_CONNECTION_ERROR;
+    }
+  }
+
+  if (SUCCESS == err) {
+    ret = mbedtls_ssl_setup(&(tls->ssl), &(tls->conf));
+    if (0 == ret) {
+      ret = mbedtls_ssl_set_hostname(&(tls->ssl), params->pDestinationURL);
+    }
+    if (0 != ret) {
+      LOGE("mbedtls_ssl_setup returned -0x%x", -ret);
+      err = SSL_CONNECTION_ERROR;
+    }
+  }
+
+  if (SUCCESS == err) {
+    mbedtls_ssl_set_bio(&(tls->ssl), &(tls->server_fd), mbedtls_net_send, NULL,
+      mbedtls_net_recv_timeout);
+    if (is_resume) {
+      _session_offer(&(tls->ssl));
+    }
+
+    do {
+      ret = mbedtls_ssl_handshake(&(tls->ssl));
+    } while ((MBEDTLS_ERR_SSL_WANT_READ == ret) ||
+             (MBEDTLS_ERR_SSL_WANT_WRITE == ret));
+
+    if (0 != ret) {
+      LOGE("mbedtls_ssl_handshake returned -0x%x", -ret);
+      *is_rejected = !_is_transport_error(ret);
+      err = (MBEDTLS_ERR_SSL_TIMEOUT == ret) ?
+        NETWORK_SSL_CONNECT_TIMEOUT_ERROR : SSL_CONNECTION_ERROR;
+    }
+  }
+
+  if (SUCCESS == err) {
+    tls->flags = mbedtls_ssl_get_verify_result(&(tls->ssl));
+    if (0 != tls->flags) {
+      LOGE("server certificate verification failed 0x%x", tls->flags);
+      err = (params->ServerVerificationFlag) ? SSL_CONNECTION_ERROR : SUCCESS;
+    }
+  }
+
+  if (SUCCESS == err) {
+    mbedtls_ssl_conf_read_timeout(&(tls->conf), _READ_TIMEOUT_MS);
+  }
+
+  return err;
+}
+
+/***** Global Functions *****/
+
+IoT_Error_t
+aws_mqtt_tls_connect(Network * network, TLSConnectParams * params)
+{
+  TickType_t start = xTaskGetTickCount();
+  IoT_Error_t err = SUCCESS;
+  bool is_resume = _is_session_cached();
+  bool is_resumed = false;
+  bool is_rejected = false;
+
+  if (NULL == network) {
+    return NULL_VALUE_ERROR;
+  }
+
+  if (NULL != params) {
+    network->tlsConnectParams = *params;
+  }
+
+  wake_timing_begin(WAKE_PHASE_TLS_HANDSHAKE);
+  err = _connect(network, is_resume, &is_rejected);
+  if ((SUCCESS != err) && is_resume && is_rejected) {
+    // The broker might choke on the session rather than ignore it. Anything
+    // else failing would fail the same way again, and says nothing about the
+    // session.
+    LOGI("falling back to a full handshake");
+    aws_mqtt_tls_forget();
+    network->destroy(network);
+    err = _connect(network, false, &is_rejected);
+  }
+  wake_timing_end(WAKE_PHASE_TLS_HANDSHAKE);
+
+  if (SUCCESS == err) {
+    is_resumed = _is_resumed(&(network->tlsDataParams.ssl));
+    _handshakes++;
+    _resumed += (is_resumed) ? 1 : 0;
+    _session_save(&(network->tlsDataParams.ssl));
+
+    LOGI("%s handshake in %d ms, %d of %d handshakes resumed",
+      (is_resumed) ? "resumed" : "full",
+      (xTaskGetTickCount() - start) * portTICK_PERIOD_MS, _resumed,
+      _handshakes);
+  }
+
+  return err;
+}
+
+void
+aws_mqtt_tls_forget(void)
+{
+  _session.magic = 0;
+}
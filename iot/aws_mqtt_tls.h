@@ -0,0 +1,32 @@
+#ifndef _AWS_MQTT_TLS_H
+#define _AWS_MQTT_TLS_H
+
+/***** Includes *****/
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "network_interface.h"
+
+/***** Global Functions *****/
+
+/*
+ * Drop in for the SDK's iot_tls_connect(), install it as the connect function
+ * of the network stack after aws_iot_mqtt_init() or aws_iot_shadow_init().
+ *
+ * The TLS session of the last successful connect is kept in RTC memory and
+ * offered to the broker, which can then resume it and skip the certificate
+ * exchange and the public key operations of a full handshake. A broker that
+ * does not know the session any more answers with a full handshake; if the
+ * TLS handshake fails outright the session is forgotten and a full handshake
+ * is tried right away. DNS, TCP and timeout errors are returned as they are
+ * and keep the session. Credentials must be PEM strings in memory.
+ */
+extern IoT_Error_t
+aws_mqtt_tls_connect(Network * network, TLSConnectParams * params);
+
+// Forget the cached session, the next connect does a full handshake.
+extern void
+aws_mqtt_tls_forget(void);
+
+#endif
@@ -0,0 +1,79 @@
+/***** Includes *****/
+
+#include "aws_mqtt_window.h"
+
+/***** Local Functions *****/
+
+static uint32_t
+_slot(struct aws_mqtt_window * window, uint32_t n)
+{
+  return (window->first + n) % AWS_MQTT_WINDOW_LEN_MAX;
+}
+
+/***** Global Functions *****/
+
+void
+aws_mqtt_window_init(struct aws_mqtt_window * window, uint32_t len)
+{
+  window->first = 0;
+  window->total = 0;
+  window->len = (len < AWS_MQTT_WINDOW_LEN_MAX) ? len :
+    AWS_MQTT_WINDOW_LEN_MAX;
+}
+
+bool
+aws_mqtt_window_is_full(struct aws_mqtt_window * window)
+{
+  return (window->total >= window->len) ? true : false;
+}
+
+uint32_t
+aws_mqtt_window_total(struct aws_mqtt_window * window)
+{
+  return window->total;
+}
+
+bool
+aws_mqtt_window_add(struct aws_mqtt_window * window, uint16_t packet_id,
+  uint32_t records)
+{
+  uint32_t slot = _slot(window, window->total);
+  bool r = true;
+
+  if (aws_mqtt_window_is_full(window)) {
+    r = false;
+  }
+
+  if (r) {
+    window->packet_id[slot] = packet_id;
+    window->records[slot] = records;
+    window->is_acked[slot] = false;
+    window->total++;
+  }
+
+  return r;
+}
+
+uint32_t
+aws_mqtt_window_ack(struct aws_mqtt_window * window, uint16_t packet_id)
+{
+  uint32_t records = 0;
+  uint32_t slot = 0;
+  uint32_t n = 0;
+
+  for (n = 0; n < window->total; n++) {
+    slot = _slot(window, n);
+    if (packet_id == window->packet_id[slot]) {
+      window->is_acked[slot] = true;
+      break;
+    }
+  }
+
+  while (window->total && window->is_acked[window->first]) {
+    records += window->records[window->first];
+    window->first = _slot(window, 1);
+    window->total--;
+  }
+
+  return records;
+}
@@ -0,0 +1,57 @@
+#ifndef _AWS_MQTT_WINDOW_H
+#define _AWS_MQTT_WINDOW_H
+
+/***** Includes *****/
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/***** Defines *****/
+
+// Most QoS 1 messages that can wait for their PUBACK at once.
+#define AWS_MQTT_WINDOW_LEN_MAX (16)
+
+/***** Structs *****/
+
+/*
+ * QoS 1 messages sent and not yet acknowledged, oldest first, each carrying a
+ * number of records. PUBACKs may arrive in any order, but records only count
+ * as delivered once every older message was acknowledged too, so the sender
+ * can delete its records oldest first without leaving gaps.
+ */
+struct aws_mqtt_window {
+  uint16_t packet_id[AWS_MQTT_WINDOW_LEN_MAX];
+  uint32_t records[AWS_MQTT_WINDOW_LEN_MAX];
+  bool is_acked[AWS_MQTT_WINDOW_LEN_MAX];
+  uint32_t first;
+  uint32_t total;
+  uint32_t len;
+};
+
+/***** Global Functions *****/
+
+// Empty the window and let up to len messages in flight, at most
+// AWS_MQTT_WINDOW_LEN_MAX.
+extern void
+aws_mqtt_window_init(struct aws_mqtt_window * window, uint32_t len);
+
+extern bool
+aws_mqtt_window_is_full(struct aws_mqtt_window * window);
+
+// Messages waiting for their PUBACK.
+extern uint32_t
+aws_mqtt_window_total(struct aws_mqtt_window * window);
+
+// Fails if the window is full.
+extern bool
+aws_mqtt_window_add(struct aws_mqtt_window * window, uint16_t packet_id,
+  uint32_t records);
+
+// Mark the message with packet_id acknowledged. Returns the number of records
+// delivered with it, which is 0 while an older message is still waiting, and
+// includes those of newer messages that were acknowledged before. Unknown and
+// repeated packet ids are ignored.
+extern uint32_t
+aws_mqtt_window_ack(struct aws_mqtt_window * window, uint16_t packet_id);
+
+#endif
@@ -1,7 +1,10 @@
 COMPONENT_PRIV_INCLUDEDIRS := \
   . \
-  ../main
+  ../main \
+  ../peep
 
 COMPONENT_OBJS := \
   aws_mqtt.o \
-  aws_mqtt_shadow.o
+  aws_mqtt_shadow.o \
+  aws_mqtt_tls.o \
+  aws_mqtt_window.o
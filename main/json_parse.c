@@ -68,7 +68,7 @@ json_parse_hatch_config_msg(char * js, struct hatch_configuration * config)
 {
   static char key[128];
   static char value[128];
-  jsmntok_t t[16];
+  jsmntok_t t[32];
   jsmn_parser p;
   jsmntok_t json_value;
   jsmntok_t json_key;
@@ -120,6 +120,22 @@ json_parse_hatch_config_msg(char * js, struct hatch_configuration * config)
     else if (0 == strcmp(key, "temperatureOffsetCelsius")) {
       config->temperature_offset_celsius = strtol(value, NULL, 0);
     }
+    else if (0 == strcmp(key, "uplinkFormat")) {
+      config->uplink_format = (0 == strcmp(value, "protobuf")) ?
+        HATCH_UPLINK_FORMAT_PROTOBUF :
+        HATCH_UPLINK_FORMAT_JSON;
+    }
+    else if (0 == strcmp(key, "uploadBudgetSec")) {
+      config->upload_budget_sec = strtol(value, NULL, 0);
+    }
+    else if (0 == strcmp(key, "uploadBudgetBytes")) {
+      config->upload_budget_bytes = strtol(value, NULL, 0);
+    }
+    else if (0 == strcmp(key, "uploadOrder")) {
+      config->upload_order = (0 == strcmp(value, "newestFirst")) ?
+        HATCH_UPLOAD_ORDER_NEWEST_FIRST :
+        HATCH_UPLOAD_ORDER_OLDEST_FIRST;
+    }
 
     n++;
   }
@@ -25,7 +25,11 @@ json_parse_wifi_credentials_msg(char * js, char * ssid, uint32_t ssid_max_len,
  * Parse a JSON message that looks like the following...
  * {
  *    "endUnixTimestamp", 1551935397,
- *    "measureIntervalSec", 900
+ *    "measureIntervalSec", 900,
+ *    "uplinkFormat", "protobuf",
+ *    "uploadBudgetSec", 30,
+ *    "uploadBudgetBytes", 262144,
+ *    "uploadOrder", "newestFirst"
  * }
  */
 
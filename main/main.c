@@ -12,6 +12,7 @@
 #include "state.h"
 #include "system.h"
 #include "tasks.h"
+#include "wake_timing.h"
 
 /***** Global Functions *****/
 
@@ -23,6 +24,8 @@ app_main()
   bool r = true;
   int32_t len = 0;
 
+  wake_timing_init();
+
 #if defined (PEEP_TEST_STATE_DEEP_SLEEP) || \
     defined(PEEP_TEST_STATE_MEASURE) || \
     defined(PEEP_TEST_STATE_MEASURE_CONFIG) || \
@@ -37,7 +40,9 @@ app_main()
 #endif
 
   nvs_flash_init();
+  wake_timing_begin(WAKE_PHASE_MEMORY_INIT);
   r = memory_init();
+  wake_timing_end(WAKE_PHASE_MEMORY_INIT);
   RESULT_TEST_ERROR_TRACE(r);
 
   r = memory_measurement_db_init();
@@ -114,13 +119,15 @@ app_main()
   }
   else if (PEEP_STATE_MEASURE == state) {
     LOGD("PEEP_STATE_MEASURE");
-    xTaskCreate(
+    // Network on core 0 with the WiFi driver, the sensor is read on core 1.
+    xTaskCreatePinnedToCore(
       task_measure,
       "measurement task",
       10240,
       NULL,
       2,
-      NULL);
+      NULL,
+      0);
   }
   else if (PEEP_STATE_MEASURE_CONFIG == state) {
     LOGD("PEEP_STATE_MEASURE_CONFIG");
@@ -1,29 +1,74 @@
 /***** Includes *****/
 
 #include <time.h>
+#include <sys/time.h>
 
 #include "tasks.h"
 #include "aws_mqtt.h"
 #include "aws_mqtt_shadow.h"
+#include "aws_mqtt_window.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
 #include "hal.h"
 #include "hatch_config.h"
 #include "hatch_measurement.h"
+#include "hatch_measurement_json.h"
+#include "hatch_measurement_pb.h"
 #include "json_parse.h"
 #include "memory.h"
 #include "memory_measurement_db.h"
 #include "state.h"
 #include "system.h"
+#include "timekeeper.h"
+#include "wake_timing.h"
 #include "wifi.h"
 
 /***** Defines *****/
 
 // Comment this out to enter deep sleep when not active.
 //#define _NO_DEEP_SLEEP 1
-#define _BUFFER_LEN (2048)
 #define _AWS_SHADOW_GET_TIMEOUT_SEC (30)
+// The configuration in flash is fetched from the shadow again on every this
+// many wakes, or sooner when an update of the shadow is seen while connected.
+#define _SHADOW_GET_INTERVAL_WAKES (12)
+#define _SHADOW_MAGIC (0x57444853) // "SHDW"
 #define _UNIX_TIMESTAMP_THRESHOLD (1546300800)
+// The clock is synced over SNTP once its predicted error exceeds this.
+#define _TIME_ERROR_MAX_MS (2000)
+#define _TIME_SYNC_TIMEOUT_SEC (5)
+// The sensor is read on the other core while the network comes up on this
+// one, see _task_sensor().
+#define _SENSOR_TASK_CORE (1)
+#define _SENSOR_TASK_STACK_LEN (4096)
+#define _SENSOR_READ_TIMEOUT_SEC (10)
 #define _HATCH_CONFIG_DEFAULT_MEASURE_INTERVAL_SEC (5 * 60)
 #define _HATCH_CONFIG_DEFAULT_END_UNIX_TIMESTAMP (2147483647)
+// Stored measurements buffered for batch messages. A measurement with
+// readings takes more than 16 bytes even as protobuf, so this is enough to
+// fill a message in the MQTT TX buffer with any uplink format.
+#define _PUBLISH_COMMIT_LEN (CONFIG_AWS_IOT_MQTT_TX_BUF_LEN / 16)
+// Rollups read from flash at once, they go out one per message.
+#define _PUBLISH_ROLLUP_LEN (16)
+// Stored measurements go out with QoS 1, with up to this many messages
+// waiting for their PUBACK. They are removed from flash once acknowledged,
+// anything else is sent again on the next wake.
+#define _PUBLISH_WINDOW_LEN (16)
+#define _PUBACK_TIMEOUT_MS (5000)
+// Uploading stored measurements stops once a wake spent this much time or
+// sent this many payload bytes on it, unless the hatch configuration says
+// otherwise. The time is capped well below the task watchdog.
+#define _UPLOAD_BUDGET_SEC_DEFAULT (30)
+#define _UPLOAD_BUDGET_SEC_MAX (45)
+#define _UPLOAD_BUDGET_BYTES_DEFAULT (256 * 1024)
+// Newest first uploads go back in time this many measurement intervals at a
+// time.
+#define _UPLOAD_CHUNK_LEN (128)
+// Comment this out to upload stored measurements one per message.
+#define _PUBLISH_BATCH 1
+#define _TOPIC_DATA "hatchtrack/data/put"
+#define _TOPIC_DATA_BATCH "hatchtrack/data/batch/put"
+#define _TOPIC_DATA_PB "hatchtrack/data/pb/put"
+#define _TOPIC_TELEMETRY "hatchtrack/telemetry/put"
 
 #if defined(PEEP_TEST_STATE_MEASURE) || (PEEP_TEST_STATE_MEASURE_CONFIG)
   // SSID of the WiFi AP connect to.
@@ -38,6 +83,29 @@
   #define _TEST_HATCH_CONFIG_END_UNIX_TIMESTAMP 1735084800
 #endif
 
+/***** Structs *****/
+
+// Progress of one upload of stored measurements.
+struct _upload {
+  // Measurements acknowledged without gaps, and the times of the first and
+  // last of them.
+  uint32_t acked;
+  uint32_t first;
+  uint32_t last;
+  // All measurements asked for are acknowledged.
+  bool is_done;
+};
+
+// Wakes since the shadow was last fetched, in RTC memory. Shadow versions that
+// left the configuration as it is are only kept here, with the version of the
+// stored configuration they apply to.
+struct _shadow {
+  uint32_t magic;
+  uint32_t wakes;
+  uint32_t version;
+  uint32_t stored_version;
+};
+
 /***** Extern Data *****/
 
 extern const uint8_t _root_ca_start[]   asm("_binary_root_ca_txt_start");
@@ -55,94 +123,515 @@ extern const uint8_t _uuid_end[]   asm("_binary_uuid_txt_end");
 /***** Local Data *****/
 
 static struct hatch_configuration _config;
-static uint8_t * _buffer = NULL;
+// Configuration of the last shadow get, and the newest shadow version seen in
+// an update.
+static struct hatch_configuration _shadow_config;
+static uint32_t _shadow_delta_version = 0;
+// Shadow version of the configuration in flash.
+static uint32_t _stored_version = 0;
+static RTC_DATA_ATTR struct _shadow _shadow;
+static RTC_DATA_ATTR struct timekeeper _timekeeper;
+// Upload budget of this wake, see _is_upload_budget_left().
+static TickType_t _upload_start = 0;
+static uint32_t _upload_bytes = 0;
 static char * _ssid = NULL;
 static char * _pass = NULL;
 
 static EventGroupHandle_t _sync_event_group = NULL;
 static const int SYNC_BIT = BIT0;
+static const int SENSOR_BIT = BIT1;
+static const int SYNC_REJECTED_BIT = BIT2;
+// Result of _task_sensor() and the esp_timer time of its reading.
+static bool _is_measured = false;
+static int64_t _measured_us = 0;
 
 /***** Local Functions *****/
 
+static int64_t
+_clock_us(void)
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+
+  return ((int64_t) tv.tv_sec * 1000000) + tv.tv_usec;
+}
+
+// Unix time at esp_timer time timer_us with the drift of the clock since the
+// last sync taken out. Going by esp_timer keeps it right when the clock was
+// synced in between.
+static uint32_t
+_timestamp(int64_t timer_us)
+{
+  return (timekeeper_now_us(&_timekeeper, _clock_us()) -
+    (esp_timer_get_time() - timer_us)) / 1000000;
+}
+
+// Sync the clock over SNTP, unless it is still known well enough.
+static void
+_time_sync(void)
+{
+  struct timeval tv;
+  int64_t clock_us = 0;
+  int64_t ntp_us = 0;
+  uint32_t error_ms = timekeeper_error_ms(&_timekeeper, _clock_us());
+  bool r = true;
+
+  if (error_ms <= _TIME_ERROR_MAX_MS) {
+    LOGI("time sync skipped, error within %d ms", error_ms);
+    return;
+  }
+
+  wake_timing_begin(WAKE_PHASE_TIME_SYNC);
+  r = wifi_time_query(_TIME_SYNC_TIMEOUT_SEC, &clock_us, &ntp_us);
+
+  if (r) {
+    timekeeper_sync(&_timekeeper, clock_us, ntp_us);
+    LOGI("time synced %d ms off, drift %d ppm",
+      (int32_t) ((clock_us - ntp_us) / 1000),
+      (int32_t) _timekeeper.drift_ppm);
+
+    ntp_us += _clock_us() - clock_us;
+    tv.tv_sec = ntp_us / 1000000;
+    tv.tv_usec = ntp_us % 1000000;
+    settimeofday(&tv, NULL);
+  }
+  else {
+    LOGE("time sync failed");
+  }
+
+  wake_timing_end(WAKE_PHASE_TIME_SYNC);
+}
+
 static bool
-_format_json(uint8_t * buf, uint32_t buf_len,
-  struct hatch_measurement * meas, char * peep_uuid, char * hatch_uuid)
+_is_upload_budget_left(void)
+{
+  uint32_t sec = _config.upload_budget_sec;
+  uint32_t bytes = _config.upload_budget_bytes;
+
+  sec = (0 == sec) ? _UPLOAD_BUDGET_SEC_DEFAULT : sec;
+  sec = (sec > _UPLOAD_BUDGET_SEC_MAX) ? _UPLOAD_BUDGET_SEC_MAX : sec;
+  bytes = (0 == bytes) ? _UPLOAD_BUDGET_BYTES_DEFAULT : bytes;
+
+  return ((xTaskGetTickCount() - _upload_start) <
+    ((sec * 1000) / portTICK_PERIOD_MS)) && (_upload_bytes < bytes);
+}
+
+// Send the message encoded into the MQTT TX buffer, with QoS 1 if packet_id is
+// given, or drop it if it could not be encoded.
+static bool
+_publish_end(bool is_encoded, uint32_t len, uint16_t * packet_id)
 {
-  int32_t bytes = 0;
   bool r = true;
 
-  bytes = snprintf(
-    (char *) buf,
-    buf_len,
-    "{\n"
-    "\"unixTime\": %d,\n"
-    "\"peepUUID\": \"%s\",\n"
-    "\"hatchUUID\": \"%s\",\n"
-    "\"temperature\": %f,\n"
-    "\"humidity\": %f,\n"
-    "\"pressure\": %f,\n"
-    "\"gasResistance\": %f\n"
-    "}",
-    meas->unix_timestamp,
-    (const char *) peep_uuid,
-    (const char *) hatch_uuid,
-    meas->temperature,
-    meas->humidity,
-    meas->air_pressure,
-    meas->gas_resistance);
-
-  if ((bytes < 0) || (bytes >= buf_len)) {
+  if (!is_encoded) {
+    aws_mqtt_publish_end(0);
     r = false;
   }
+  else if (packet_id) {
+    r = aws_mqtt_publish_end_qos1(len, packet_id);
+  }
+  else {
+    r = aws_mqtt_publish_end(len);
+  }
+
+  if (r) {
+    _upload_bytes += len;
+  }
 
   return r;
 }
 
+// Upload the rollups, oldest first, ahead of the stored measurements so the
+// data arrives in time order. They are the only copy of the measurements
+// they replaced, so each goes out with QoS 1 and is removed only once it and
+// every older one is acknowledged.
 static bool
-_publish_measurements(uint8_t * buf, uint32_t buf_len,
-  struct hatch_measurement * meas, char * peep_uuid, char * hatch_uuid)
+_publish_rollups(char * peep_uuid, char * hatch_uuid)
 {
-  struct hatch_measurement old;
-  uint32_t total = 0;
+  struct hatch_measurement_rollup old[_PUBLISH_ROLLUP_LEN];
+  struct aws_mqtt_window window;
+  uint8_t * buf = NULL;
+  uint32_t buf_len = 0;
+  uint16_t packet_id = 0;
+  uint32_t acked = 0;
+  uint32_t n = 0;
+  uint32_t i = 0;
   bool r = true;
 
-  if (r) {
-    _format_json(buf, buf_len, meas, peep_uuid, hatch_uuid);
+  if (memory_measurement_db_rollup_total()) {
+    LOGI("%d rollups to upload", memory_measurement_db_rollup_total());
   }
 
-  if (r) {
-    r = aws_mqtt_publish("hatchtrack/data/put", (char *) buf, false);
+  aws_mqtt_window_init(&window, _PUBLISH_WINDOW_LEN);
+
+  while (r && memory_measurement_db_rollup_total() &&
+    _is_upload_budget_left()) {
+    r = memory_measurement_db_rollup_read(old, _PUBLISH_ROLLUP_LEN, &n);
+    if (r && (0 == n)) {
+      break;
+    }
+
+    i = 0;
+    while (r && ((i < n) || aws_mqtt_window_total(&window))) {
+      if ((i < n) && !aws_mqtt_window_is_full(&window)) {
+        r = aws_mqtt_publish_begin(_TOPIC_DATA, &buf, &buf_len);
+
+        if (r) {
+          r = hatch_measurement_json_format_rollup((char *) buf, buf_len,
+            &old[i], peep_uuid, hatch_uuid);
+          r = _publish_end(r, (r) ? strlen((char *) buf) : 0, &packet_id);
+        }
+
+        if (r) {
+          aws_mqtt_window_add(&window, packet_id, 1);
+          i++;
+        }
+      }
+      else {
+        r = aws_mqtt_puback_wait(_PUBACK_TIMEOUT_MS, &packet_id);
+        acked = (r) ? aws_mqtt_window_ack(&window, packet_id) : 0;
+
+        if (acked) {
+          r = memory_measurement_db_rollup_delete_oldest(acked);
+        }
+      }
+    }
+  }
+
+  if (aws_mqtt_window_total(&window)) {
+    LOGE("%d rollup messages not acknowledged",
+      aws_mqtt_window_total(&window));
   }
 
+  return r;
+}
+
+// Publish one message with as many of the total measurements as the uplink
+// format allows, setting count to the number sent. The message is encoded
+// straight into the MQTT TX buffer, and sent with QoS 1 if packet_id is given.
+static bool
+_publish_batch(struct hatch_measurement * meas, uint32_t total,
+  char * peep_uuid, char * hatch_uuid, uint32_t * count, uint16_t * packet_id)
+{
+  uint8_t * buf = NULL;
+  uint32_t buf_len = 0;
+  uint32_t len = 0;
+  bool r = true;
+
+  if (HATCH_UPLINK_FORMAT_PROTOBUF == _config.uplink_format) {
+    r = aws_mqtt_publish_begin(_TOPIC_DATA_PB, &buf, &buf_len);
+
+    if (r) {
+      r = hatch_measurement_pb_encode_batch(buf, buf_len, meas, total,
+        peep_uuid, hatch_uuid, count, &len);
+      r = _publish_end(r, len, packet_id);
+    }
+  }
+  else {
+#ifdef _PUBLISH_BATCH
+    r = aws_mqtt_publish_begin(_TOPIC_DATA_BATCH, &buf, &buf_len);
+
+    if (r) {
+      r = hatch_measurement_json_format_batch((char *) buf, buf_len, meas,
+        total, peep_uuid, hatch_uuid, count);
+      r = _publish_end(r, (r) ? strlen((char *) buf) : 0, packet_id);
+    }
+#else
+    *count = 1;
+    r = aws_mqtt_publish_begin(_TOPIC_DATA, &buf, &buf_len);
+
+    if (r) {
+      r = hatch_measurement_json_format((char *) buf, buf_len, meas,
+        peep_uuid, hatch_uuid);
+      r = _publish_end(r, (r) ? strlen((char *) buf) : 0, packet_id);
+    }
+#endif
+  }
+
+  return r;
+}
+
+// Upload the stored measurements taken from start on up to before end, oldest
+// first, with QoS 1 and as many messages in flight as the window allows,
+// until the upload budget runs out. With is_delete measurements are removed
+// as soon as they are acknowledged, which requires start to be at or before
+// the oldest one.
+static bool
+_publish_stored(uint32_t start, uint32_t end, bool is_delete,
+  char * peep_uuid, char * hatch_uuid, struct _upload * up)
+{
+  static struct hatch_measurement old[_PUBLISH_COMMIT_LEN];
+  struct aws_mqtt_window window;
+  // Time of the last measurement of each message, by number of message sent.
+  uint32_t last[AWS_MQTT_WINDOW_LEN_MAX];
+  uint16_t packet_id = 0;
+  uint32_t in_flight = 0;
+  uint32_t count = 0;
+  uint32_t read = 0;
+  uint32_t acked = 0;
+  uint32_t sent = 0;
+  uint32_t done = 0;
+  uint32_t n = 0;
+  uint32_t i = 0;
+  bool is_end = false;
+  bool is_cut = false;
+  bool r = true;
+
+  up->acked = 0;
+  up->first = 0;
+  up->last = 0;
+  up->is_done = false;
+
+  r = memory_measurement_db_read_open();
+
   if (r) {
-    total = memory_measurement_db_total();
-    LOGI("%d old measurements to upload", total);
+    r = memory_measurement_db_seek_time(start);
   }
 
-  if (r && total) {
+  aws_mqtt_window_init(&window, _PUBLISH_WINDOW_LEN);
 
-    r = memory_measurement_db_read_open();
+  while (r && (!is_end || (i < n) || aws_mqtt_window_total(&window))) {
+    // Measurements not sent yet are carried over and the buffer topped up,
+    // so every message but the last is filled up to the TX buffer.
+    if (((n - i) < _PUBLISH_COMMIT_LEN) && !is_end) {
+      memmove(old, &old[i], (n - i) * sizeof(old[0]));
+      n -= i;
+      i = 0;
 
-    while (r && total--) {
-      r = memory_measurement_db_read_entry(&old);
+      is_cut = !_is_upload_budget_left();
+      is_end = is_cut || !memory_measurement_db_read_batch(&old[n],
+        _PUBLISH_COMMIT_LEN - n, &read);
+      // Reading can stop short of the newest measurement, that is no end.
+      is_cut = is_cut || (is_end && !memory_measurement_db_read_is_end());
+      read = (is_end) ? 0 : read;
 
-      if (r) {
-        r = _format_json(buf, buf_len, &old, peep_uuid, hatch_uuid);
+      // Measurements from end on are not part of this upload.
+      count = 0;
+      while ((count < read) && (old[n + count].unix_timestamp < end)) {
+        count++;
       }
+      is_end = is_end || (count < read);
+      n += count;
+    }
+
+    if ((i < n) && !aws_mqtt_window_is_full(&window)) {
+      r = _publish_batch(&old[i], n - i, peep_uuid, hatch_uuid, &count,
+        &packet_id);
 
       if (r) {
-        r = aws_mqtt_publish("hatchtrack/data/put", (char *) buf, false);
+        up->first = (0 == sent) ? old[i].unix_timestamp : up->first;
+        last[sent % AWS_MQTT_WINDOW_LEN_MAX] =
+          old[i + count - 1].unix_timestamp;
+        aws_mqtt_window_add(&window, packet_id, count);
+        sent++;
+        i += count;
       }
     }
+    else if (aws_mqtt_window_total(&window)) {
+      r = aws_mqtt_puback_wait(_PUBACK_TIMEOUT_MS, &packet_id);
+      in_flight = aws_mqtt_window_total(&window);
+      acked = (r) ? aws_mqtt_window_ack(&window, packet_id) : 0;
+
+      if (acked) {
+        done += in_flight - aws_mqtt_window_total(&window);
+        up->acked += acked;
+        up->last = last[(done - 1) % AWS_MQTT_WINDOW_LEN_MAX];
+      }
+
+      if (acked && is_delete) {
+        r = memory_measurement_db_delete_oldest(acked);
+      }
+    }
+  }
+
+  if (aws_mqtt_window_total(&window)) {
+    LOGE("%d messages not acknowledged", aws_mqtt_window_total(&window));
+  }
 
+  memory_measurement_db_read_close();
+
+  up->is_done = (r && !is_cut);
+
+  return r;
+}
+
+// Time of the oldest stored measurement.
+static bool
+_stored_oldest(uint32_t * unix_timestamp)
+{
+  struct hatch_measurement meas;
+  bool r = true;
+
+  r = memory_measurement_db_read_open();
+
+  if (r) {
+    r = memory_measurement_db_read_entry(&meas);
     memory_measurement_db_read_close();
+  }
+
+  if (r) {
+    *unix_timestamp = meas.unix_timestamp;
+  }
+
+  return r;
+}
+
+// Upload the measurements stored since the last newest first upload, then go
+// back in time a chunk at a time. Once everything is uploaded it is removed.
+// Measurements taken from "from" to "until" were uploaded already; the log
+// can only drop its oldest measurements, so these stay in flash until
+// everything older is uploaded as well. The range is stored with the log each
+// time it grows, a power cycle does not send them again.
+static bool
+_publish_newest_first(uint32_t now, char * peep_uuid, char * hatch_uuid)
+{
+  struct _upload up = {0};
+  uint32_t interval = _config.measure_interval_sec;
+  uint32_t start = 0;
+  uint32_t end = 0;
+  uint32_t span = 0;
+  uint32_t oldest = 0;
+  uint32_t from = 0;
+  uint32_t until = 0;
+  bool r = true;
+
+  interval = (interval) ? interval : _HATCH_CONFIG_DEFAULT_MEASURE_INTERVAL_SEC;
+  span = _UPLOAD_CHUNK_LEN * interval;
+  up.is_done = true;
+
+  r = memory_measurement_db_uploaded_get(&from, &until);
+  if (r && (from > until)) {
+    from = 0;
+    until = 0;
+  }
+
+  if (r) {
+    r = _stored_oldest(&oldest);
+  }
+
+  if (r && until) {
+    r = _publish_stored(until + 1, UINT32_MAX, false, peep_uuid,
+      hatch_uuid, &up);
+    until = (up.is_done) ? now : (up.acked) ? up.last : until;
+    r = memory_measurement_db_uploaded_set(from, until) && r;
+  }
+
+  while (r && up.is_done && _is_upload_budget_left() &&
+         ((0 == until) || (from > oldest))) {
+    end = (until) ? from : UINT32_MAX;
+    start = (until) ? from : now;
+    start = (start > span) ? (start - span) : 0;
+
+    r = _publish_stored(start, end, false, peep_uuid, hatch_uuid, &up);
+
+    // A chunk acknowledged only in part does not join up with what was
+    // uploaded before, it is sent again next time.
+    if (up.is_done) {
+      from = start;
+      until = (until) ? until : now;
+    }
+    else if (up.acked && (0 == until)) {
+      from = up.first;
+      until = up.last;
+    }
+    r = memory_measurement_db_uploaded_set(from, until) && r;
+  }
+
+  if (r && up.is_done && until && (from <= oldest)) {
+    r = memory_measurement_db_delete_oldest(memory_measurement_db_total());
+    r = memory_measurement_db_uploaded_set(0, 0) && r;
+  }
+
+  return r;
+}
+
+static bool
+_publish_measurements(struct hatch_measurement * meas, char * peep_uuid,
+  char * hatch_uuid)
+{
+  struct _upload up;
+  uint8_t * buf = NULL;
+  uint32_t buf_len = 0;
+  uint32_t count = 0;
+  uint32_t total = 0;
+  bool r = true;
+
+  _upload_start = xTaskGetTickCount();
+  _upload_bytes = 0;
+  wake_timing_begin(WAKE_PHASE_PUBLISH);
+
+  if (HATCH_UPLINK_FORMAT_PROTOBUF == _config.uplink_format) {
+    r = _publish_batch(meas, 1, peep_uuid, hatch_uuid, &count, NULL);
+  }
+  else {
+    r = aws_mqtt_publish_begin(_TOPIC_DATA, &buf, &buf_len);
 
     if (r) {
-      LOGI("deleting old data");
-      memory_measurement_db_delete_all();
+      r = hatch_measurement_json_format((char *) buf, buf_len, meas,
+        peep_uuid, hatch_uuid);
+      r = _publish_end(r, (r) ? strlen((char *) buf) : 0, NULL);
     }
   }
 
+  if (r) {
+    r = _publish_rollups(peep_uuid, hatch_uuid);
+  }
+  wake_timing_end(WAKE_PHASE_PUBLISH);
+
+  if (r) {
+    total = memory_measurement_db_total();
+    LOGI("%d old measurements to upload", total);
+  }
+
+  if (r && total) {
+    wake_timing_begin(WAKE_PHASE_BACKLOG);
+    if (HATCH_UPLOAD_ORDER_NEWEST_FIRST == _config.upload_order) {
+      r = _publish_newest_first(meas->unix_timestamp, peep_uuid, hatch_uuid);
+    }
+    else {
+      // Anything uploaded newest first before is sent again.
+      memory_measurement_db_uploaded_set(0, 0);
+      r = _publish_stored(0, UINT32_MAX, true, peep_uuid, hatch_uuid, &up);
+    }
+
+    LOGI("%d old measurements remaining, %d bytes uploaded in %d ms",
+      memory_measurement_db_total(), _upload_bytes,
+      (xTaskGetTickCount() - _upload_start) * portTICK_PERIOD_MS);
+    wake_timing_end(WAKE_PHASE_BACKLOG);
+  }
+
+  return r;
+}
+
+// Publish the phase timings of the wakes since the last telemetry message,
+// once the ring of them is full. One message per WAKE_TIMING_LEN wakes keeps
+// the airtime of the other wakes down, and the next wake would overwrite the
+// oldest of them.
+static bool
+_publish_telemetry(char * peep_uuid)
+{
+  uint8_t * buf = NULL;
+  uint32_t buf_len = 0;
+  bool r = true;
+
+  if (wake_timing_total() < WAKE_TIMING_LEN) {
+    return true;
+  }
+
+  LOGI("publishing wake timing of %d wakes", wake_timing_total());
+  wake_timing_begin(WAKE_PHASE_PUBLISH);
+  r = aws_mqtt_publish_begin(_TOPIC_TELEMETRY, &buf, &buf_len);
+
+  if (r) {
+    r = wake_timing_format_json((char *) buf, buf_len, peep_uuid);
+    r = _publish_end(r, (r) ? strlen((char *) buf) : 0, NULL);
+  }
+
+  if (r) {
+    wake_timing_clear();
+  }
+  wake_timing_end(WAKE_PHASE_PUBLISH);
 
   return r;
 }
@@ -188,17 +677,83 @@ _get_wifi_ssid_pasword(char * ssid, char * password)
   return r;
 }
 
+// Reads the sensor into the measurement given as arg, which takes twice the
+// BME680 profile duration. Runs on the other core so WiFi association, time
+// sync and the TLS handshake do not wait for it, task_measure() joins it with
+// SENSOR_BIT before the measurement is used.
 static void
-_shadow_callback(uint8_t * buf, uint16_t buf_len)
+_task_sensor(void * arg)
 {
+  struct hatch_measurement * meas = (struct hatch_measurement *) arg;
   bool r = true;
 
+  LOGI("initializing hardware");
+  wake_timing_begin(WAKE_PHASE_HAL_INIT);
+  r = hal_init();
+  wake_timing_end(WAKE_PHASE_HAL_INIT);
+
+  if (r) {
+    LOGI("performing measurement");
+    wake_timing_begin(WAKE_PHASE_SENSOR_READ);
+    r = hal_read_temperature_humdity_pressure_resistance(
+      &(meas->temperature),
+      &(meas->humidity),
+      &(meas->air_pressure),
+      &(meas->gas_resistance));
+    wake_timing_end(WAKE_PHASE_SENSOR_READ);
+  }
+
+  _measured_us = esp_timer_get_time();
+  _is_measured = r;
+  xEventGroupSetBits(_sync_event_group, SENSOR_BIT);
+
+  vTaskDelete(NULL);
+}
+
+// Wait for _task_sensor() to finish.
+static bool
+_sensor_join(void)
+{
+  EventBits_t bits = 0;
+
+  bits = xEventGroupWaitBits(
+    _sync_event_group,
+    SENSOR_BIT,
+    false,
+    true,
+    _SENSOR_READ_TIMEOUT_SEC * 1000 / portTICK_PERIOD_MS);
+
+  if (0 == (bits & SENSOR_BIT)) {
+    LOGE("sensor read timed out");
+    return false;
+  }
+
+  if (!_is_measured) {
+    LOGE("sensor read failed");
+  }
+
+  return _is_measured;
+}
+
+static void
+_shadow_callback(uint8_t * buf, uint16_t buf_len, uint32_t version)
+{
+  bool r = true;
+
+  if (NULL == buf) {
+    xEventGroupSetBits(_sync_event_group, SYNC_REJECTED_BIT);
+    return;
+  }
+
 #if defined(PEEP_TEST_STATE_MEASURE) || defined(PEEP_TEST_STATE_MEASURE_CONFIG)
   LOGI("AWS Shadow: %s", buf);
 #endif
 
-  r = json_parse_hatch_config_msg((char *) buf, &_config);
+  memset(&_shadow_config, 0, sizeof(struct hatch_configuration));
+  HATCH_CONFIG_INIT(_shadow_config);
+  r = json_parse_hatch_config_msg((char *) buf, &_shadow_config);
   if (r) {
+    _shadow_config.shadow_version = version;
     xEventGroupSetBits(_sync_event_group, SYNC_BIT);
   }
   else {
@@ -208,12 +763,96 @@ _shadow_callback(uint8_t * buf, uint16_t buf_len)
   }
 }
 
+static void
+_shadow_delta_callback(uint8_t * buf, uint16_t buf_len, uint32_t version)
+{
+  (void) buf;
+  (void) buf_len;
+
+  LOGI("shadow updated to version %d", version);
+  _shadow_delta_version = (version > _shadow_delta_version) ? version :
+    _shadow_delta_version;
+}
+
+// Get the shadow over the aws_mqtt connection and take its configuration,
+// writing it to flash only if it changed.
+static bool
+_shadow_get(char * peep_uuid)
+{
+  EventBits_t bits = 0;
+  TickType_t start = 0;
+  uint32_t version = 0;
+  bool is_requested = false;
+  bool is_changed = false;
+  bool r = true;
+
+  LOGI("AWS MQTT shadow get timeout %d seconds", _AWS_SHADOW_GET_TIMEOUT_SEC);
+  wake_timing_begin(WAKE_PHASE_SHADOW_GET);
+  xEventGroupClearBits(_sync_event_group, SYNC_BIT | SYNC_REJECTED_BIT);
+  is_requested = aws_mqtt_shadow_get_shared(peep_uuid, _shadow_callback);
+  start = xTaskGetTickCount();
+
+  while (is_requested && (0 == (bits & (SYNC_BIT | SYNC_REJECTED_BIT)))) {
+    if ((xTaskGetTickCount() - start) >=
+        (_AWS_SHADOW_GET_TIMEOUT_SEC * 1000 / portTICK_PERIOD_MS)) {
+      LOGE("shadow get timed out");
+      break;
+    }
+
+    aws_mqtt_subscribe_poll(500);
+
+    bits = xEventGroupWaitBits(
+      _sync_event_group,
+      SYNC_BIT | SYNC_REJECTED_BIT,
+      false,
+      false,
+      0);
+  }
+
+  if (is_requested) {
+    aws_mqtt_shadow_get_shared_end();
+  }
+  wake_timing_end(WAKE_PHASE_SHADOW_GET);
+
+  r = (0 != (bits & SYNC_BIT)) ? true : false;
+
+  if (r) {
+    _shadow.wakes = 0;
+
+    // Shadow versions also count updates that leave the configuration as it
+    // is, those are not worth a flash write. Their version is kept in RTC
+    // memory so later updates don't look newer than the configuration.
+    version = _shadow_config.shadow_version;
+    _shadow_config.shadow_version = _config.shadow_version;
+    is_changed = ((0 == _config.shadow_version) ||
+      (0 != memcmp(&_shadow_config, &_config,
+        sizeof(struct hatch_configuration))));
+    _config = _shadow_config;
+    _config.shadow_version = version;
+    _shadow.version = version;
+
+    if (is_changed) {
+      LOGI("hatch configuration changed in shadow version %d", version);
+      _stored_version = version;
+      memory_set_item(
+        MEMORY_ITEM_HATCH_CONFIG,
+        (uint8_t *) &_config,
+        sizeof(struct hatch_configuration));
+
+      // feed watchdog
+      vTaskDelay(100 / portTICK_PERIOD_MS);
+    }
+    _shadow.stored_version = _stored_version;
+  }
+
+  return r;
+}
+
 /***** Global Functions *****/
 
 void
 task_measure(void * arg)
 {
-  EventBits_t bits = 0;
   struct hatch_measurement meas;
   char * peep_uuid = (char *) _uuid_start;
   char * root_ca = (char *) _root_ca_start;
@@ -221,8 +860,11 @@ task_measure(void * arg)
   char * key = (char *) _key_start;
   char * ssid = _ssid;
   char * pass = _pass;
-  bool is_shadow_connected = false;
+  bool is_config_valid = false;
+  bool is_shadow_due = false;
+  bool is_shadow_watched = false;
   bool is_unix_time_in_range = false;
+  bool is_sensor_started = false;
   bool is_local_measure = false;
   bool r = true;
 
@@ -235,106 +877,128 @@ task_measure(void * arg)
   #endif
 
   _sync_event_group = xEventGroupCreate();
-  _buffer = malloc(_BUFFER_LEN);
   _ssid = malloc(WIFI_SSID_LEN_MAX);
   _pass = malloc(WIFI_PASSWORD_LEN_MAX);
-  if ((NULL == _buffer) || (NULL == _ssid) || (NULL == _pass)) {
+  if ((NULL == _ssid) || (NULL == _pass)) {
     LOGE_TRAP("failed to allocate memory");
   }
   ssid = _ssid;
   pass = _pass;
 
+  // Start from the configuration of the last shadow get, configurations
+  // stored before the shadow version was added read as version 0.
+  memset(&_config, 0, sizeof(struct hatch_configuration));
+  memory_get_item(
+    MEMORY_ITEM_HATCH_CONFIG,
+    (uint8_t *) &_config,
+    sizeof(struct hatch_configuration));
+  is_config_valid = IS_HATCH_CONFIG_VALID(_config);
+  _stored_version = _config.shadow_version;
+
+  if (_SHADOW_MAGIC != _shadow.magic) {
+    _shadow.magic = _SHADOW_MAGIC;
+    _shadow.wakes = _SHADOW_GET_INTERVAL_WAKES;
+    _shadow.version = 0;
+    _shadow.stored_version = 0;
+  }
+  _shadow.wakes++;
+  // Take the newest shadow version, unless another task stored a
+  // configuration since.
+  if ((0 != _stored_version) && (_shadow.stored_version == _stored_version) &&
+      (_shadow.version > _config.shadow_version)) {
+    _config.shadow_version = _shadow.version;
+  }
+  is_shadow_due = (!is_config_valid || (0 == _config.shadow_version) ||
+    (_shadow.wakes >= _SHADOW_GET_INTERVAL_WAKES));
+
   if (r) {
     r = _get_wifi_ssid_pasword(ssid, pass);
   }
 
   if (r) {
-    LOGI("initializing hardware");
-    r = hal_init();
+    is_sensor_started = (pdPASS == xTaskCreatePinnedToCore(
+      _task_sensor,
+      "sensor task",
+      _SENSOR_TASK_STACK_LEN,
+      &meas,
+      uxTaskPriorityGet(NULL),
+      NULL,
+      _SENSOR_TASK_CORE));
+    if (!is_sensor_started) {
+      LOGE("failed to start sensor task");
+      r = false;
+    }
   }
 
   if (r) {
-    LOGI("performing measurement");
-    r = hal_read_temperature_humdity_pressure_resistance(
-      &(meas.temperature),
-      &(meas.humidity),
-      &(meas.air_pressure),
-      &(meas.gas_resistance));
+    timekeeper_init(&_timekeeper);
   }
 
   if (r && !is_local_measure) {
     LOGI("WiFi connect to SSID %s", ssid);
+    wake_timing_begin(WAKE_PHASE_WIFI_CONNECT);
     r = wifi_connect(ssid, pass, 15);
+    wake_timing_end(WAKE_PHASE_WIFI_CONNECT);
     is_local_measure = (r) ? false : true;
     r = true;
   }
 
   if (r && !is_local_measure) {
-    LOGI("AWS MQTT shadow connect");
-    r = aws_mqtt_shadow_init(root_ca, cert, key, peep_uuid, 60);
+    _time_sync();
   }
 
+  // One connection serves the shadow get and the publishes, which saves a
+  // TLS handshake per wake.
   if (r && !is_local_measure) {
-    LOGI("AWS MQTT shadow get timeout %d seconds", _AWS_SHADOW_GET_TIMEOUT_SEC);
-    r = aws_mqtt_shadow_get(_shadow_callback, _AWS_SHADOW_GET_TIMEOUT_SEC);
-    is_shadow_connected = true;
+    LOGI("AWS MQTT connect");
+    wake_timing_begin(WAKE_PHASE_MQTT_CONNECT);
+    r = aws_mqtt_init(root_ca, cert, key, peep_uuid, 5);
+    wake_timing_end(WAKE_PHASE_MQTT_CONNECT);
+    is_local_measure = (r) ? false : true;
+    r = true;
   }
 
-  while (r && !is_local_measure && (0 == (bits & SYNC_BIT))) {
-    aws_mqtt_shadow_poll(2500);
-    vTaskDelay(100 / portTICK_PERIOD_MS);
-
-    bits = xEventGroupWaitBits(
-      _sync_event_group,
-      SYNC_BIT,
-      false,
-      true,
-      0);
+  if (r && !is_local_measure && is_shadow_due) {
+    _shadow_get(peep_uuid);
+    is_config_valid = IS_HATCH_CONFIG_VALID(_config);
+  }
+  else if (r && !is_local_measure) {
+    LOGI("shadow get skipped, %d wakes since the last one", _shadow.wakes);
   }
 
-  if (is_shadow_connected) {
-    memory_set_item(
-      MEMORY_ITEM_HATCH_CONFIG,
-      (uint8_t *) &_config,
-      sizeof(struct hatch_configuration));
+  // Watching for shadow updates costs a subscribe round trip, which is only
+  // worth it when uploading stored measurements keeps the connection open for
+  // a while. Updates seen are fetched before disconnecting.
+  if (r && !is_local_measure && !is_shadow_due &&
+      memory_measurement_db_total()) {
+    is_shadow_watched = aws_mqtt_shadow_delta_shared(peep_uuid,
+      _shadow_delta_callback);
+  }
 
-    // feed watchdog
-    vTaskDelay(100 / portTICK_PERIOD_MS);
+  if (!is_config_valid) {
+    // Can't get config from AWS nor is there a previous config stored in
+    // flash memory. We'll go to sleep for awhile and then try again in at a
+    // later point and hope for better results.
+    _config.measure_interval_sec = _HATCH_CONFIG_DEFAULT_MEASURE_INTERVAL_SEC;
+    r = false;
 
-    LOGI("AWS MQTT shadow disconnect");
-    aws_mqtt_shadow_disconnect();
+    LOGE("failed to load previous hatch configuration");
+    LOGE("retry in %d seconds", _config.measure_interval_sec);
   }
   else {
-    memory_get_item(
-      MEMORY_ITEM_HATCH_CONFIG,
-      (uint8_t *) &_config,
-      sizeof(struct hatch_configuration));
-
-    if (false == IS_HATCH_CONFIG_VALID(_config)) {
-      // Can't get config from AWS nor is there a previous config stored in
-      // flash memory. We'll go to sleep for awhile and then try again in at a
-      // later point and hope for better results.
-      _config.measure_interval_sec = _HATCH_CONFIG_DEFAULT_MEASURE_INTERVAL_SEC;
-      r = false;
-
-      LOGE("failed to load previous hatch configuration");
-      LOGE("retry in %d seconds", _config.measure_interval_sec);
-    }
-    else {
-      LOGI("loaded previous hatch configuration");
-    }
+    LOGI("hatch configuration of shadow version %d",
+      _config.shadow_version);
   }
 
-  if (r && !is_local_measure) {
-    LOGI("AWS MQTT connect");
-    r = aws_mqtt_init(root_ca, cert, key, peep_uuid, 5);
-    is_local_measure = (r) ? false : true;
-    r = true;
+  // The measurement is stamped with the time it was taken, which is known
+  // best after the time sync.
+  if (is_sensor_started && !_sensor_join()) {
+    r = false;
   }
 
   if (r) {
-    meas.unix_timestamp = time(NULL);
-    LOGI("current Unix time %d", meas.unix_timestamp);
+    meas.unix_timestamp = _timestamp(_measured_us);
+    LOGI("measurement Unix time %d", meas.unix_timestamp);
     if (meas.unix_timestamp < _UNIX_TIMESTAMP_THRESHOLD) {
       LOGE("timestamp is invalid");
       r = false;
@@ -362,8 +1026,6 @@ task_measure(void * arg)
   if (r && !is_local_measure && is_unix_time_in_range) {
     LOGI("publishing measurement results over MQTT");
     r = _publish_measurements(
-      _buffer,
-      _BUFFER_LEN,
       &meas,
       (char *) _uuid_start,
       _config.uuid);
@@ -377,7 +1039,19 @@ task_measure(void * arg)
     LOGI("%d measurements stored", total);
   }
 
+  if (is_shadow_watched) {
+    if (_shadow_delta_version > _config.shadow_version) {
+      _shadow_get(peep_uuid);
+    }
+    aws_mqtt_shadow_delta_shared_end();
+  }
+
+  if (r && !is_local_measure) {
+    _publish_telemetry((char *) _uuid_start);
+  }
+
   LOGI("WiFi disconnect");
   wifi_disconnect();
+  wake_timing_commit();
   hal_deep_sleep_timer(_config.measure_interval_sec);
 }
@@ -1,5 +1,8 @@
 /***** Includes *****/
 
+#include <time.h>
+#include <sys/time.h>
+
 #include "tasks.h"
 #include "aws_mqtt.h"
 #include "aws_mqtt_shadow.h"
@@ -14,6 +17,9 @@
 
 #define _BUFFER_LEN (2048)
 #define _AWS_SHADOW_GET_TIMEOUT_SEC (30)
+#define _TIME_SET_TIMEOUT_SEC (5)
+// 2016-01-01, any clock behind this was never set.
+#define _TIME_SET_MIN_SEC (1451606400)
 
 #ifdef PEEP_TEST_STATE_MEASURE_CONFIG
   #define _TEST_WIFI_SSID "thesignal"
@@ -112,13 +118,53 @@ _get_wifi_ssid_pasword(char * ssid, char * password)
   return r;
 }
 
+static int64_t
+_clock_us(void)
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+
+  return ((int64_t) tv.tv_sec * 1000000) + tv.tv_usec;
+}
+
+// Set the clock over SNTP if it was never set, the broker certificate can not
+// be checked without it.
+static bool
+_time_set(void)
+{
+  struct timeval tv;
+  int64_t clock_us = 0;
+  int64_t ntp_us = 0;
+  bool r = true;
+
+  // Is time set? If not, it is still close to 1970.
+  if (time(NULL) < _TIME_SET_MIN_SEC) {
+    LOGI("time not set, querying SNTP");
+    r = wifi_time_query(_TIME_SET_TIMEOUT_SEC, &clock_us, &ntp_us);
+
+    if (r) {
+      ntp_us += _clock_us() - clock_us;
+      tv.tv_sec = ntp_us / 1000000;
+      tv.tv_usec = ntp_us % 1000000;
+      settimeofday(&tv, NULL);
+    }
+    else {
+      LOGE("failed to sync time");
+    }
+  }
+
+  return r;
+}
+
 static void
-_shadow_callback(uint8_t * buf, uint16_t buf_len)
+_shadow_callback(uint8_t * buf, uint16_t buf_len, uint32_t version)
 {
   bool r = true;
 
   r = json_parse_hatch_config_msg((char *) buf, &_config);
   if (r) {
+    _config.shadow_version = version;
     xEventGroupSetBits(_sync_event_group, SYNC_BIT);
   }
   else {
@@ -175,6 +221,10 @@ task_measure_config(void * arg)
     r = wifi_connect(ssid, pass, 60);
   }
 
+  if (r && (false == _is_button_event)) {
+    r = _time_set();
+  }
+
   if (r && (false == _is_button_event)) {
     LOGI("AWS MQTT shadow connect");
     r = aws_mqtt_shadow_init(root_ca, cert, key, peep_uuid, 60);
@@ -211,6 +261,10 @@ task_measure_config(void * arg)
     LOGI("end_unix_timestamp=%d", _config.end_unix_timestamp);
     LOGI("measure_interval_sec=%d", _config.measure_interval_sec);
     LOGI("temperature_offset_celsius=%d", _config.temperature_offset_celsius);
+    LOGI("uplink_format=%d", _config.uplink_format);
+    LOGI("upload_budget_sec=%d", _config.upload_budget_sec);
+    LOGI("upload_budget_bytes=%d", _config.upload_budget_bytes);
+    LOGI("upload_order=%d", _config.upload_order);
   }
   hal_deep_sleep_timer(30);
 #else
@@ -3,9 +3,17 @@ COMPONENT_PRIV_INCLUDEDIRS := \
   ../main
 
 COMPONENT_OBJS := \
+  hatch_measurement_codec.o \
+  hatch_measurement_json.o \
+  hatch_measurement_pb.o \
+  hatch_measurement_rollup.o \
   memory.o \
   memory_measurement_db.o \
-  state.o
+  memory_measurement_stage.o \
+  ring_log.o \
+  state.o \
+  timekeeper.o \
+  wake_timing.o
 
 ifeq ($(PROJECT_NAME),hatchtrack-peep-unit-test-fw)
   COMPONENT_PRIV_INCLUDEDIRS += ../test/main
@@ -21,11 +21,31 @@
     (config).end_unix_timestamp = 0; \
     (config).measure_interval_sec = 0; \
     (config).temperature_offset_celsius = 0; \
+    (config).uplink_format = HATCH_UPLINK_FORMAT_JSON; \
+    (config).upload_budget_sec = 0; \
+    (config).upload_budget_bytes = 0; \
+    (config).upload_order = HATCH_UPLOAD_ORDER_OLDEST_FIRST; \
+    (config).shadow_version = 0; \
   } while (0)
 
 #define IS_HATCH_CONFIG_VALID(config) \
   (0 == (config).uuid[0]) ? false : true
 
+/***** Enums *****/
+
+// Encoding of the measurements published by the Peep.
+enum hatch_uplink_format {
+  HATCH_UPLINK_FORMAT_JSON = 0,
+  // MeasurementBatch of protobuf/measurement.proto
+  HATCH_UPLINK_FORMAT_PROTOBUF,
+};
+
+// Order stored measurements are uploaded in once the Peep is back online.
+enum hatch_upload_order {
+  HATCH_UPLOAD_ORDER_OLDEST_FIRST = 0,
+  HATCH_UPLOAD_ORDER_NEWEST_FIRST,
+};
+
 /***** Structs *****/
 
 struct hatch_configuration {
@@ -33,6 +53,18 @@ struct hatch_configuration {
   uint32_t end_unix_timestamp;
   uint32_t measure_interval_sec;
   uint32_t temperature_offset_celsius;
+  // enum hatch_uplink_format, configurations stored before it was added read
+  // as HATCH_UPLINK_FORMAT_JSON.
+  uint32_t uplink_format;
+  // Limits on uploading stored measurements in one wake, whatever is left is
+  // uploaded on later wakes. 0 selects the default of the firmware.
+  uint32_t upload_budget_sec;
+  uint32_t upload_budget_bytes;
+  // enum hatch_upload_order
+  uint32_t upload_order;
+  // Version of the shadow document the configuration was last changed by, 0
+  // if unknown.
+  uint32_t shadow_version;
 };
 
 #endif
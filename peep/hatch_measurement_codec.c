@@ -0,0 +1,166 @@
+/***** Includes *****/
+
+#include <math.h>
+#include <string.h>
+
+#include "hatch_measurement_codec.h"
+
+/***** Defines *****/
+
+// Tag byte: codec version in the upper nibble, flags below.
+#define _TAG_KEY (0x01)
+#define _TAG(is_key) \
+  ((HATCH_MEASUREMENT_CODEC_VERSION << 4) | ((is_key) ? _TAG_KEY : 0))
+#define _TAG_VERSION(tag) ((tag) >> 4)
+
+#define _GAS_STEPS_PER_OCTAVE (1024.0f)
+
+/***** Local Functions *****/
+
+static int32_t
+_round(float value)
+{
+  return (int32_t) ((value < 0) ? (value - 0.5f) : (value + 0.5f));
+}
+
+static int32_t
+_gas_to_fixed(float ohm)
+{
+  return (ohm > 1.0f) ? _round(log2f(ohm) * _GAS_STEPS_PER_OCTAVE) : 0;
+}
+
+// Zero is reserved for readings of 1 ohm and below, which the sensor only
+// reports when the heater did not get stable.
+static float
+_gas_from_fixed(int32_t value)
+{
+  return (value > 0) ? exp2f(value / _GAS_STEPS_PER_OCTAVE) : 0.0f;
+}
+
+static uint8_t *
+_varint_put(uint8_t * p, uint32_t value)
+{
+  while (value >= 0x80) {
+    *p++ = (uint8_t) (value | 0x80);
+    value >>= 7;
+  }
+  *p++ = (uint8_t) value;
+
+  return p;
+}
+
+static const uint8_t *
+_varint_get(const uint8_t * p, const uint8_t * end, uint32_t * value)
+{
+  uint32_t shift = 0;
+
+  *value = 0;
+  while ((p < end) && (shift < 35)) {
+    *value |= (uint32_t) (*p & 0x7F) << shift;
+    if (0 == (*p++ & 0x80)) {
+      return p;
+    }
+    shift += 7;
+  }
+
+  return NULL;
+}
+
+// Signed differences are zigzag mapped so small magnitudes stay short.
+static uint8_t *
+_delta_put(uint8_t * p, int32_t delta)
+{
+  return _varint_put(p, ((uint32_t) delta << 1) ^ (uint32_t) (delta >> 31));
+}
+
+static const uint8_t *
+_delta_get(const uint8_t * p, const uint8_t * end, int32_t * delta)
+{
+  uint32_t value = 0;
+
+  p = _varint_get(p, end, &value);
+  *delta = (int32_t) (value >> 1) ^ -(int32_t) (value & 1);
+
+  return p;
+}
+
+/***** Global Functions *****/
+
+void
+hatch_measurement_codec_reset(struct hatch_measurement_codec * codec)
+{
+  memset(codec, 0, sizeof(struct hatch_measurement_codec));
+}
+
+uint32_t
+hatch_measurement_encode(struct hatch_measurement_codec * codec,
+  const struct hatch_measurement * meas, uint8_t * buf, bool is_key)
+{
+  struct hatch_measurement_codec now;
+  uint8_t * p = buf;
+
+  if (is_key) {
+    hatch_measurement_codec_reset(codec);
+  }
+
+  now.unix_timestamp = meas->unix_timestamp;
+  now.temperature = _round(meas->temperature * 100.0f);
+  now.humidity = _round(meas->humidity * 100.0f);
+  now.air_pressure = _round(meas->air_pressure);
+  now.gas_resistance = _gas_to_fixed(meas->gas_resistance);
+
+  *p++ = _TAG(is_key);
+  p = _delta_put(p, (int32_t) (now.unix_timestamp - codec->unix_timestamp));
+  p = _delta_put(p, now.temperature - codec->temperature);
+  p = _delta_put(p, now.humidity - codec->humidity);
+  p = _delta_put(p, now.air_pressure - codec->air_pressure);
+  p = _delta_put(p, now.gas_resistance - codec->gas_resistance);
+
+  *codec = now;
+
+  return p - buf;
+}
+
+bool
+hatch_measurement_decode(struct hatch_measurement_codec * codec,
+  const uint8_t * buf, uint32_t len, struct hatch_measurement * meas)
+{
+  struct hatch_measurement_codec prev = *codec;
+  struct hatch_measurement_codec now;
+  const uint8_t * end = buf + len;
+  const uint8_t * p = buf;
+  int32_t delta = 0;
+
+  if ((0 == len) || (HATCH_MEASUREMENT_CODEC_VERSION != _TAG_VERSION(*p))) {
+    return false;
+  }
+
+  if (*p++ & _TAG_KEY) {
+    hatch_measurement_codec_reset(&prev);
+  }
+
+  p = _delta_get(p, end, &delta);
+  now.unix_timestamp = prev.unix_timestamp + (uint32_t) delta;
+  p = (p) ? _delta_get(p, end, &delta) : NULL;
+  now.temperature = prev.temperature + delta;
+  p = (p) ? _delta_get(p, end, &delta) : NULL;
+  now.humidity = prev.humidity + delta;
+  p = (p) ? _delta_get(p, end, &delta) : NULL;
+  now.air_pressure = prev.air_pressure + delta;
+  p = (p) ? _delta_get(p, end, &delta) : NULL;
+  now.gas_resistance = prev.gas_resistance + delta;
+
+  if (NULL == p) {
+    return false;
+  }
+
+  *codec = now;
+
+  meas->unix_timestamp = now.unix_timestamp;
+  meas->temperature = now.temperature / 100.0f;
+  meas->humidity = now.humidity / 100.0f;
+  meas->air_pressure = (float) now.air_pressure;
+  meas->gas_resistance = _gas_from_fixed(now.gas_resistance);
+
+  return true;
+}
@@ -0,0 +1,53 @@
+#ifndef _HATCH_MEASUREMENT_CODEC_H
+#define _HATCH_MEASUREMENT_CODEC_H
+
+/***** Includes *****/
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "hatch_measurement.h"
+
+/***** Defines *****/
+
+#define HATCH_MEASUREMENT_CODEC_VERSION (1)
+// Longest possible encoding: tag byte plus five worst case varints.
+#define HATCH_MEASUREMENT_CODEC_LEN_MAX (1 + (5 * 5))
+
+/***** Structs *****/
+
+/*
+ * Quantized copy of the previously coded measurement. Each record stores its
+ * fields as a difference from the one before it, so an encoder and decoder
+ * have to see the same sequence of records since the last key record.
+ *
+ *   temperature     0.01 degree Celsius
+ *   humidity        0.01 %RH
+ *   air_pressure    1 Pa
+ *   gas_resistance  log2(ohm) in 1/1024 steps, about 0.07% resolution
+ */
+struct hatch_measurement_codec {
+  uint32_t unix_timestamp;
+  int32_t temperature;
+  int32_t humidity;
+  int32_t air_pressure;
+  int32_t gas_resistance;
+};
+
+/***** Global Functions *****/
+
+extern void
+hatch_measurement_codec_reset(struct hatch_measurement_codec * codec);
+
+// Encode meas into buf, which must hold HATCH_MEASUREMENT_CODEC_LEN_MAX bytes,
+// and return the encoded length. A key record does not depend on any previous
+// record and resets the codec state.
+extern uint32_t
+hatch_measurement_encode(struct hatch_measurement_codec * codec,
+  const struct hatch_measurement * meas, uint8_t * buf, bool is_key);
+
+extern bool
+hatch_measurement_decode(struct hatch_measurement_codec * codec,
+  const uint8_t * buf, uint32_t len, struct hatch_measurement * meas);
+
+#endif
@@ -0,0 +1,243 @@
+/***** Includes *****/
+
+#include <string.h>
+
+#include "hatch_measurement_json.h"
+
+/***** Defines *****/
+
+// Appends a string literal, its length is known at compile time.
+#define _PUT(w, s) _put(w, s, sizeof(s) - 1)
+
+/***** Structs *****/
+
+/*
+ * Output position in the caller's buffer. Everything is written in place,
+ * numbers included, so formatting needs no heap and very little stack. Once
+ * something does not fit is_full is set and nothing more is written.
+ */
+struct _writer {
+  char * p;
+  char * end;
+  bool is_full;
+};
+
+/***** Local Functions *****/
+
+static void
+_init(struct _writer * w, char * buf, uint32_t buf_len)
+{
+  w->p = buf;
+  // Room kept for the zero termination.
+  w->end = buf + buf_len - 1;
+  w->is_full = (0 == buf_len) ? true : false;
+}
+
+static void
+_put(struct _writer * w, const char * s, uint32_t len)
+{
+  if (!w->is_full && (len <= (uint32_t) (w->end - w->p))) {
+    memcpy(w->p, s, len);
+    w->p += len;
+  }
+  else {
+    w->is_full = true;
+  }
+}
+
+static void
+_put_string(struct _writer * w, const char * s)
+{
+  _put(w, s, strlen(s));
+}
+
+static void
+_put_uint(struct _writer * w, uint32_t value)
+{
+  char digits[10];
+  uint32_t n = sizeof(digits);
+
+  do {
+    digits[--n] = '0' + (value % 10);
+    value /= 10;
+  } while (value);
+
+  _put(w, &digits[n], sizeof(digits) - n);
+}
+
+// Magnitude of value rounded to a multiple of 1/scale, clamped rather than
+// wrapped when out of range. A minus sign is written first unless the value
+// rounds to zero.
+static uint32_t
+_put_sign(struct _writer * w, float value, float scale)
+{
+  float scaled = ((value < 0) ? -value : value) * scale;
+  uint32_t n = (scaled < 4294967040.0f) ? (uint32_t) (scaled + 0.5f) :
+    4294967295u;
+
+  if ((value < 0) && (n > 0)) {
+    _PUT(w, "-");
+  }
+
+  return n;
+}
+
+// Value with two decimals, the resolution of the temperature and humidity
+// readings.
+static void
+_put_centi(struct _writer * w, float value)
+{
+  uint32_t centi = _put_sign(w, value, 100.0f);
+  char frac[3] = {'.', '0', '0'};
+
+  frac[1] += (centi % 100) / 10;
+  frac[2] += centi % 10;
+  _put_uint(w, centi / 100);
+  _put(w, frac, sizeof(frac));
+}
+
+// Value as a whole number, for air pressure in Pa and gas resistance in ohm.
+static void
+_put_whole(struct _writer * w, float value)
+{
+  _put_uint(w, _put_sign(w, value, 1.0f));
+}
+
+static bool
+_end(struct _writer * w)
+{
+  if (!w->is_full) {
+    *w->p = 0;
+  }
+
+  return !w->is_full;
+}
+
+/***** Global Functions *****/
+
+bool
+hatch_measurement_json_format(char * buf, uint32_t buf_len,
+  const struct hatch_measurement * meas, const char * peep_uuid,
+  const char * hatch_uuid)
+{
+  struct _writer w;
+
+  _init(&w, buf, buf_len);
+  _PUT(&w, "{\n\"unixTime\": ");
+  _put_uint(&w, meas->unix_timestamp);
+  _PUT(&w, ",\n\"peepUUID\": \"");
+  _put_string(&w, peep_uuid);
+  _PUT(&w, "\",\n\"hatchUUID\": \"");
+  _put_string(&w, hatch_uuid);
+  _PUT(&w, "\",\n\"temperature\": ");
+  _put_centi(&w, meas->temperature);
+  _PUT(&w, ",\n\"humidity\": ");
+  _put_centi(&w, meas->humidity);
+  _PUT(&w, ",\n\"pressure\": ");
+  _put_whole(&w, meas->air_pressure);
+  _PUT(&w, ",\n\"gasResistance\": ");
+  _put_whole(&w, meas->gas_resistance);
+  _PUT(&w, "\n}");
+
+  return _end(&w);
+}
+
+bool
+hatch_measurement_json_format_rollup(char * buf, uint32_t buf_len,
+  const struct hatch_measurement_rollup * rollup, const char * peep_uuid,
+  const char * hatch_uuid)
+{
+  struct _writer w;
+
+  _init(&w, buf, buf_len);
+  _PUT(&w, "{\n\"unixTime\": ");
+  _put_uint(&w, rollup->unix_timestamp);
+  _PUT(&w, ",\n\"peepUUID\": \"");
+  _put_string(&w, peep_uuid);
+  _PUT(&w, "\",\n\"hatchUUID\": \"");
+  _put_string(&w, hatch_uuid);
+  _PUT(&w, "\",\n\"periodSec\": ");
+  _put_uint(&w, rollup->period_sec);
+  _PUT(&w, ",\n\"samples\": ");
+  _put_uint(&w, rollup->samples);
+  _PUT(&w, ",\n\"temperature\": ");
+  _put_centi(&w, rollup->temperature.mean);
+  _PUT(&w, ",\n\"temperatureMin\": ");
+  _put_centi(&w, rollup->temperature.min);
+  _PUT(&w, ",\n\"temperatureMax\": ");
+  _put_centi(&w, rollup->temperature.max);
+  _PUT(&w, ",\n\"humidity\": ");
+  _put_centi(&w, rollup->humidity.mean);
+  _PUT(&w, ",\n\"humidityMin\": ");
+  _put_centi(&w, rollup->humidity.min);
+  _PUT(&w, ",\n\"humidityMax\": ");
+  _put_centi(&w, rollup->humidity.max);
+  _PUT(&w, ",\n\"pressure\": ");
+  _put_whole(&w, rollup->air_pressure.mean);
+  _PUT(&w, ",\n\"pressureMin\": ");
+  _put_whole(&w, rollup->air_pressure.min);
+  _PUT(&w, ",\n\"pressureMax\": ");
+  _put_whole(&w, rollup->air_pressure.max);
+  _PUT(&w, ",\n\"gasResistance\": ");
+  _put_whole(&w, rollup->gas_resistance.mean);
+  _PUT(&w, ",\n\"gasResistanceMin\": ");
+  _put_whole(&w, rollup->gas_resistance.min);
+  _PUT(&w, ",\n\"gasResistanceMax\": ");
+  _put_whole(&w, rollup->gas_resistance.max);
+  _PUT(&w, "\n}");
+
+  return _end(&w);
+}
+
+bool
+hatch_measurement_json_format_batch(char * buf, uint32_t buf_len,
+  const struct hatch_measurement * meas, uint32_t total,
+  const char * peep_uuid, const char * hatch_uuid, uint32_t * count)
+{
+  struct _writer w;
+  char * mark = NULL;
+  uint32_t i = 0;
+
+  *count = 0;
+
+  // The closing "]}" is always written, keep room for it.
+  _init(&w, buf, (buf_len > 2) ? (buf_len - 2) : 0);
+  _PUT(&w, "{\"peepUUID\":\"");
+  _put_string(&w, peep_uuid);
+  _PUT(&w, "\",\"hatchUUID\":\"");
+  _put_string(&w, hatch_uuid);
+  _PUT(&w, "\",\"measurements\":[");
+
+  for (i = 0; !w.is_full && (i < total); i++) {
+    mark = w.p;
+    if (i > 0) {
+      _PUT(&w, ",");
+    }
+    _PUT(&w, "{\"unixTime\":");
+    _put_uint(&w, meas[i].unix_timestamp);
+    _PUT(&w, ",\"temperature\":");
+    _put_centi(&w, meas[i].temperature);
+    _PUT(&w, ",\"humidity\":");
+    _put_centi(&w, meas[i].humidity);
+    _PUT(&w, ",\"pressure\":");
+    _put_whole(&w, meas[i].air_pressure);
+    _PUT(&w, ",\"gasResistance\":");
+    _put_whole(&w, meas[i].gas_resistance);
+    _PUT(&w, "}");
+
+    if (!w.is_full) {
+      *count = i + 1;
+    }
+  }
+
+  if (*count > 0) {
+    // Drop a measurement that only fit in part and close the array.
+    w.p = w.is_full ? mark : w.p;
+    w.end += 2;
+    w.is_full = false;
+    _PUT(&w, "]}");
+    _end(&w);
+  }
+
+  return (*count > 0) ? true : false;
+}
@@ -0,0 +1,59 @@
+#ifndef _HATCH_MEASUREMENT_JSON_H
+#define _HATCH_MEASUREMENT_JSON_H
+
+/***** Includes *****/
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "hatch_measurement.h"
+#include "hatch_measurement_rollup.h"
+
+/***** Global Functions *****/
+
+/*
+ * Each function writes a zero terminated JSON document into buf and fails if
+ * it does not fit in buf_len bytes. Temperature and humidity are written with
+ * two decimals, pressure and gas resistance as whole numbers.
+ */
+
+/**
+ * One measurement, as published for every new one.
+ * {
+ * "unixTime": 1551935397,
+ * "peepUUID": "...",
+ * "hatchUUID": "...",
+ * "temperature": 37.50,
+ * "humidity": 55.00,
+ * "pressure": 101325,
+ * "gasResistance": 120000
+ * }
+ */
+extern bool
+hatch_measurement_json_format(char * buf, uint32_t buf_len,
+  const struct hatch_measurement * meas, const char * peep_uuid,
+  const char * hatch_uuid);
+
+/**
+ * One rollup, the mean values under the keys of a measurement plus
+ * "periodSec", "samples" and a "...Min" and "...Max" key for each value.
+ */
+extern bool
+hatch_measurement_json_format_rollup(char * buf, uint32_t buf_len,
+  const struct hatch_measurement_rollup * rollup, const char * peep_uuid,
+  const char * hatch_uuid);
+
+/**
+ * As many of the total measurements as fit in buf_len, sharing the UUIDs.
+ * {"peepUUID":"...","hatchUUID":"...","measurements":[
+ * {"unixTime":1551935397,"temperature":37.50,...},...]}
+ *
+ * Sets count to the number of measurements written, fails if not even the
+ * first one fits.
+ */
+extern bool
+hatch_measurement_json_format_batch(char * buf, uint32_t buf_len,
+  const struct hatch_measurement * meas, uint32_t total,
+  const char * peep_uuid, const char * hatch_uuid, uint32_t * count);
+
+#endif
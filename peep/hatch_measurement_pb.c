@@ -0,0 +1,282 @@
+/***** Includes *****/
+
+#include <string.h>
+
+#include "hatch_measurement_pb.h"
+
+/***** Defines *****/
+
+#define _WIRE_VARINT (0)
+#define _WIRE_FIXED64 (1)
+#define _WIRE_LEN (2)
+#define _WIRE_FIXED32 (5)
+#define _KEY(field, wire) (((field) << 3) | (wire))
+
+// MeasurementBatch
+#define _FIELD_PEEP_UUID (1)
+#define _FIELD_HATCH_UUID (2)
+#define _FIELD_MEASUREMENTS (3)
+// Measurement
+#define _FIELD_UNIX_TIME (1)
+#define _FIELD_TEMPERATURE (2)
+#define _FIELD_HUMIDITY (3)
+#define _FIELD_PRESSURE (4)
+#define _FIELD_GAS_RESISTANCE (5)
+
+/***** Local Functions *****/
+
+static int32_t
+_round(float value)
+{
+  return (int32_t) ((value < 0) ? (value - 0.5f) : (value + 0.5f));
+}
+
+static uint32_t
+_round_unsigned(float value)
+{
+  return (value > 0) ? (uint32_t) (value + 0.5f) : 0;
+}
+
+static uint8_t *
+_varint_put(uint8_t * p, uint32_t value)
+{
+  while (value >= 0x80) {
+    *p++ = (uint8_t) (value | 0x80);
+    value >>= 7;
+  }
+  *p++ = (uint8_t) value;
+
+  return p;
+}
+
+static const uint8_t *
+_varint_get(const uint8_t * p, const uint8_t * end, uint32_t * value)
+{
+  uint32_t shift = 0;
+
+  *value = 0;
+  // Varints of up to 64 bits are read, only the low 32 bits are kept.
+  while ((p < end) && (shift < 70)) {
+    if (shift < 32) {
+      *value |= (uint32_t) (*p & 0x7F) << shift;
+    }
+    if (0 == (*p++ & 0x80)) {
+      return p;
+    }
+    shift += 7;
+  }
+
+  return NULL;
+}
+
+// Proto3 leaves out fields with the default value.
+static uint8_t *
+_field_put(uint8_t * p, uint32_t field, uint32_t value)
+{
+  if (value) {
+    p = _varint_put(p, _KEY(field, _WIRE_VARINT));
+    p = _varint_put(p, value);
+  }
+
+  return p;
+}
+
+static uint8_t *
+_string_put(uint8_t * p, uint32_t field, const char * s, uint32_t len)
+{
+  p = _varint_put(p, _KEY(field, _WIRE_LEN));
+  p = _varint_put(p, len);
+  memcpy(p, s, len);
+
+  return p + len;
+}
+
+static uint32_t
+_measurement_put(uint8_t * p, const struct hatch_measurement * meas)
+{
+  uint8_t * start = p;
+  int32_t temperature = _round(meas->temperature * 100.0f);
+
+  p = _field_put(p, _FIELD_UNIX_TIME, meas->unix_timestamp);
+  p = _field_put(p, _FIELD_TEMPERATURE,
+    ((uint32_t) temperature << 1) ^ (uint32_t) (temperature >> 31));
+  p = _field_put(p, _FIELD_HUMIDITY, _round_unsigned(meas->humidity * 100.0f));
+  p = _field_put(p, _FIELD_PRESSURE, _round_unsigned(meas->air_pressure));
+  p = _field_put(p, _FIELD_GAS_RESISTANCE,
+    _round_unsigned(meas->gas_resistance));
+
+  return p - start;
+}
+
+// Skip the value of a field of the given wire type.
+static const uint8_t *
+_skip(const uint8_t * p, const uint8_t * end, uint32_t wire)
+{
+  uint32_t value = 0;
+
+  if (_WIRE_VARINT == wire) {
+    p = _varint_get(p, end, &value);
+  }
+  else if (_WIRE_FIXED64 == wire) {
+    p = ((end - p) >= 8) ? (p + 8) : NULL;
+  }
+  else if (_WIRE_FIXED32 == wire) {
+    p = ((end - p) >= 4) ? (p + 4) : NULL;
+  }
+  else if (_WIRE_LEN == wire) {
+    p = _varint_get(p, end, &value);
+    p = (p && (value <= (end - p))) ? (p + value) : NULL;
+  }
+  else {
+    p = NULL;
+  }
+
+  return p;
+}
+
+static bool
+_measurement_get(const uint8_t * p, const uint8_t * end,
+  struct hatch_measurement * meas)
+{
+  uint32_t value = 0;
+  uint32_t key = 0;
+
+  memset(meas, 0, sizeof(*meas));
+
+  while (p && (p < end)) {
+    p = _varint_get(p, end, &key);
+    if (p && (_WIRE_VARINT == (key & 0x07))) {
+      p = _varint_get(p, end, &value);
+      switch (key >> 3) {
+        case _FIELD_UNIX_TIME:
+          meas->unix_timestamp = value;
+          break;
+        case _FIELD_TEMPERATURE:
+          meas->temperature =
+            (int32_t) ((value >> 1) ^ (0 - (value & 1))) / 100.0f;
+          break;
+        case _FIELD_HUMIDITY:
+          meas->humidity = value / 100.0f;
+          break;
+        case _FIELD_PRESSURE:
+          meas->air_pressure = value;
+          break;
+        case _FIELD_GAS_RESISTANCE:
+          meas->gas_resistance = value;
+          break;
+      }
+    }
+    else if (p) {
+      p = _skip(p, end, key & 0x07);
+    }
+  }
+
+  return (NULL != p) ? true : false;
+}
+
+static const uint8_t *
+_uuid_get(const uint8_t * p, const uint8_t * end, char * uuid)
+{
+  uint32_t len = 0;
+
+  p = _varint_get(p, end, &len);
+  if (p && (len <= (end - p))) {
+    memcpy(uuid, p, (len < UUID_BUF_LEN) ? len : (UUID_BUF_LEN - 1));
+    uuid[(len < UUID_BUF_LEN) ? len : (UUID_BUF_LEN - 1)] = 0;
+    p += len;
+  }
+  else {
+    p = NULL;
+  }
+
+  return p;
+}
+
+/***** Global Functions *****/
+
+bool
+hatch_measurement_pb_encode_batch(uint8_t * buf, uint32_t buf_len,
+  const struct hatch_measurement * meas, uint32_t total,
+  const char * peep_uuid, const char * hatch_uuid, uint32_t * count,
+  uint32_t * len)
+{
+  uint8_t tmp[HATCH_MEASUREMENT_PB_LEN_MAX];
+  uint32_t peep_len = strlen(peep_uuid);
+  uint32_t hatch_len = strlen(hatch_uuid);
+  uint8_t * p = buf;
+  uint32_t n = 0;
+  uint32_t i = 0;
+
+  *count = 0;
+  *len = 0;
+
+  // Keys and lengths of the UUIDs take two bytes each while they are short.
+  if ((peep_len > 127) || (hatch_len > 127) ||
+      ((4 + peep_len + hatch_len) > buf_len)) {
+    return false;
+  }
+
+  p = _string_put(p, _FIELD_PEEP_UUID, peep_uuid, peep_len);
+  p = _string_put(p, _FIELD_HATCH_UUID, hatch_uuid, hatch_len);
+
+  for (i = 0; i < total; i++) {
+    n = _measurement_put(tmp, &meas[i]);
+    if ((2 + n) > (buf_len - (p - buf))) {
+      break;
+    }
+    p = _varint_put(p, _KEY(_FIELD_MEASUREMENTS, _WIRE_LEN));
+    p = _varint_put(p, n);
+    memcpy(p, tmp, n);
+    p += n;
+    *count = i + 1;
+  }
+
+  *len = p - buf;
+
+  return (*count > 0) ? true : false;
+}
+
+bool
+hatch_measurement_pb_decode_batch(const uint8_t * buf, uint32_t len,
+  char * peep_uuid, char * hatch_uuid, struct hatch_measurement * meas,
+  uint32_t max, uint32_t * total)
+{
+  const uint8_t * end = buf + len;
+  const uint8_t * p = buf;
+  uint32_t value = 0;
+  uint32_t key = 0;
+
+  *total = 0;
+  peep_uuid[0] = 0;
+  hatch_uuid[0] = 0;
+
+  while (p && (p < end)) {
+    p = _varint_get(p, end, &key);
+    if (NULL == p) {
+      break;
+    }
+
+    if (_KEY(_FIELD_PEEP_UUID, _WIRE_LEN) == key) {
+      p = _uuid_get(p, end, peep_uuid);
+    }
+    else if (_KEY(_FIELD_HATCH_UUID, _WIRE_LEN) == key) {
+      p = _uuid_get(p, end, hatch_uuid);
+    }
+    else if (_KEY(_FIELD_MEASUREMENTS, _WIRE_LEN) == key) {
+      p = _varint_get(p, end, &value);
+      if (p && (value <= (end - p)) && (*total < max) &&
+          _measurement_get(p, p + value, &meas[*total])) {
+        (*total)++;
+        p += value;
+      }
+      else {
+        p = NULL;
+      }
+    }
+    else {
+      p = _skip(p, end, key & 0x07);
+    }
+  }
+
+  return (NULL != p) ? true : false;
+}
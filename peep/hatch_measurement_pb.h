@@ -0,0 +1,42 @@
+#ifndef _HATCH_MEASUREMENT_PB_H
+#define _HATCH_MEASUREMENT_PB_H
+
+/***** Includes *****/
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "hatch_config.h"
+#include "hatch_measurement.h"
+
+/***** Defines *****/
+
+// Longest encoding of one Measurement in a batch, tag and length included.
+#define HATCH_MEASUREMENT_PB_LEN_MAX (2 + (5 * 6))
+
+/***** Global Functions *****/
+
+/*
+ * Protocol buffer encoding of measurements, the MeasurementBatch message of
+ * protobuf/measurement.proto. Written by hand, the firmware only ever needs
+ * this one message.
+ */
+
+// Encode as many of the total measurements as fit in buf_len bytes. Sets
+// count to the number encoded and len to the bytes used, fails if not even
+// the first one fits.
+extern bool
+hatch_measurement_pb_encode_batch(uint8_t * buf, uint32_t buf_len,
+  const struct hatch_measurement * meas, uint32_t total,
+  const char * peep_uuid, const char * hatch_uuid, uint32_t * count,
+  uint32_t * len);
+
+// Decode a MeasurementBatch of len bytes into up to max measurements, setting
+// total to the number decoded. The UUIDs are copied into buffers of
+// UUID_BUF_LEN bytes. Fails on malformed input or more than max measurements.
+extern bool
+hatch_measurement_pb_decode_batch(const uint8_t * buf, uint32_t len,
+  char * peep_uuid, char * hatch_uuid, struct hatch_measurement * meas,
+  uint32_t max, uint32_t * total);
+
+#endif
@@ -0,0 +1,59 @@
+/***** Includes *****/
+
+#include <string.h>
+
+#include "hatch_measurement_rollup.h"
+
+/***** Local Functions *****/
+
+static void
+_range_add(struct hatch_measurement_range * range, float value,
+  uint32_t samples)
+{
+  if (1 == samples) {
+    range->min = value;
+    range->max = value;
+    range->mean = value;
+  }
+  else {
+    range->min = (value < range->min) ? value : range->min;
+    range->max = (value > range->max) ? value : range->max;
+    // Running mean, a plain sum would lose precision on the pressure.
+    range->mean += (value - range->mean) / samples;
+  }
+}
+
+/***** Global Functions *****/
+
+void
+hatch_measurement_rollup_init(struct hatch_measurement_rollup * rollup,
+  uint32_t unix_timestamp, uint32_t period_sec)
+{
+  memset(rollup, 0, sizeof(struct hatch_measurement_rollup));
+  rollup->unix_timestamp = unix_timestamp - (unix_timestamp % period_sec);
+  rollup->period_sec = period_sec;
+}
+
+bool
+hatch_measurement_rollup_add(struct hatch_measurement_rollup * rollup,
+  const struct hatch_measurement * meas)
+{
+  bool r = true;
+
+  if ((meas->unix_timestamp < rollup->unix_timestamp) ||
+      ((meas->unix_timestamp - rollup->unix_timestamp) >=
+       rollup->period_sec)) {
+    r = false;
+  }
+
+  if (r) {
+    rollup->samples++;
+    _range_add(&(rollup->temperature), meas->temperature, rollup->samples);
+    _range_add(&(rollup->humidity), meas->humidity, rollup->samples);
+    _range_add(&(rollup->air_pressure), meas->air_pressure, rollup->samples);
+    _range_add(&(rollup->gas_resistance), meas->gas_resistance,
+      rollup->samples);
+  }
+
+  return r;
+}
@@ -0,0 +1,46 @@
+#ifndef _HATCH_MEASUREMENT_ROLLUP_H
+#define _HATCH_MEASUREMENT_ROLLUP_H
+
+/***** Includes *****/
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "hatch_measurement.h"
+
+/***** Structs *****/
+
+struct hatch_measurement_range {
+  float min;
+  float max;
+  float mean;
+};
+
+/*
+ * Summary of the measurements taken in the period starting at
+ * unix_timestamp, kept in place of them once they get old.
+ */
+struct hatch_measurement_rollup {
+  uint32_t unix_timestamp;
+  uint32_t period_sec;
+  uint32_t samples;
+  struct hatch_measurement_range temperature;
+  struct hatch_measurement_range humidity;
+  struct hatch_measurement_range air_pressure;
+  struct hatch_measurement_range gas_resistance;
+};
+
+/***** Global Functions *****/
+
+// Start an empty rollup for the period_sec long period that holds
+// unix_timestamp, periods are aligned to multiples of period_sec.
+extern void
+hatch_measurement_rollup_init(struct hatch_measurement_rollup * rollup,
+  uint32_t unix_timestamp, uint32_t period_sec);
+
+// Fold meas into the rollup. Fails if it was not taken during its period.
+extern bool
+hatch_measurement_rollup_add(struct hatch_measurement_rollup * rollup,
+  const struct hatch_measurement * meas);
+
+#endif
@@ -3,8 +3,27 @@
 #include <string.h>
 #include "system.h"
 #include "memory.h"
+#include "esp_attr.h"
 #include "esp_spiffs.h"
 
+/***** Defines *****/
+
+#define _SETTINGS_MAGIC (0x54455350) // "PSET"
+#define _SETTINGS_VERSION (1)
+#define _ITEM_TOTAL (sizeof(_file_lut) / sizeof(_file_lut[0]))
+// magic, version, generation and item count in front, CRC32 behind.
+#define _SETTINGS_HEADER_LEN (4 + 2 + 4 + 1)
+#define _SETTINGS_LEN_MAX \
+  (_SETTINGS_HEADER_LEN + (_ITEM_TOTAL * (2 + MEMORY_ITEM_LEN_MAX)) + 4)
+
+/***** Structs *****/
+
+struct _item {
+  bool is_set;
+  uint8_t len;
+  uint8_t data[MEMORY_ITEM_LEN_MAX];
+};
+
 /***** Local Data *****/
 
 static SemaphoreHandle_t _mutex = NULL;
@@ -14,6 +33,9 @@ static char * _file_lut[] = {
    * Max file length is 16 characters, including zero termination character.
    * This leaves 15 characters for each file name. Visual guide below...
    *
+   * Items used to be kept one per file, these are only read to move them
+   * into the settings file.
+   *
   ________MAX_LEN
   */
   NULL, // MEMORY_ITEM_INVALID
@@ -25,10 +47,147 @@ static char * _file_lut[] = {
   "/p/hatch", // MEMORY_ITEM_HATCH_CONFIG
 };
 
-/***** Global Functions *****/
+/*
+ * All items are kept together and read once by memory_init(). Each write goes
+ * to the other file than the last one, one generation newer, and the newest
+ * copy with a good CRC is the one in effect. A reset in the middle of a write
+ * leaves the copy from before it.
+ */
+static const char * _settings_files[2] = {
+  "/p/settings0",
+  "/p/settings1",
+};
 
-bool
-memory_init(void)
+// RAM copy of the settings in effect.
+static struct _item _items[_ITEM_TOTAL];
+static uint32_t _generation = 0;
+static uint8_t _blob[_SETTINGS_LEN_MAX];
+// Items being unpacked, they only replace the ones in effect once all of them
+// are read.
+static struct _item _scratch[_ITEM_TOTAL];
+
+// Copy of the settings file that survives deep sleep, so a wake that only reads
+// settings never has to mount SPIFFS. Its CRC fails after a power cycle.
+RTC_DATA_ATTR static uint8_t _rtc_blob[_SETTINGS_LEN_MAX];
+RTC_DATA_ATTR static uint32_t _rtc_len;
+
+/***** Local Functions *****/
+
+static uint32_t
+_crc32(uint32_t crc, const void * buf, uint32_t len)
+{
+  const uint8_t * p = buf;
+  uint32_t n = 0;
+
+  crc = ~crc;
+  while (len--) {
+    crc ^= *p++;
+    for (n = 0; n < 8; n++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+
+  return ~crc;
+}
+
+static void
+_put_u32(uint8_t * p, uint32_t value)
+{
+  p[0] = value & 0xFF;
+  p[1] = (value >> 8) & 0xFF;
+  p[2] = (value >> 16) & 0xFF;
+  p[3] = (value >> 24) & 0xFF;
+}
+
+static uint32_t
+_get_u32(const uint8_t * p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+// Pack the items that are set into _blob, returns its length.
+static uint32_t
+_pack(uint32_t generation)
+{
+  uint32_t len = _SETTINGS_HEADER_LEN;
+  uint32_t total = 0;
+  uint32_t n = 0;
+
+  for (n = 1; n < _ITEM_TOTAL; n++) {
+    if (_items[n].is_set) {
+      _blob[len++] = n;
+      _blob[len++] = _items[n].len;
+      memcpy(&_blob[len], _items[n].data, _items[n].len);
+      len += _items[n].len;
+      total++;
+    }
+  }
+
+  _put_u32(&_blob[0], _SETTINGS_MAGIC);
+  _blob[4] = _SETTINGS_VERSION & 0xFF;
+  _blob[5] = (_SETTINGS_VERSION >> 8) & 0xFF;
+  _put_u32(&_blob[6], generation);
+  _blob[10] = total;
+  _put_u32(&_blob[len], _crc32(0, _blob, len));
+
+  return len + 4;
+}
+
+// True if the len bytes of _blob are a complete settings copy.
+static bool
+_is_valid(uint32_t len)
+{
+  return ((len >= (_SETTINGS_HEADER_LEN + 4)) &&
+          (_SETTINGS_MAGIC == _get_u32(&_blob[0])) &&
+          (_crc32(0, _blob, len - 4) == _get_u32(&_blob[len - 4]))) ?
+    true :
+    false;
+}
+
+// Fill the items from the len bytes of _blob. Items from a newer version that
+// are unknown here are skipped. On failure the items in effect are kept.
+static bool
+_unpack(uint32_t len)
+{
+  uint32_t total = 0;
+  uint32_t item = 0;
+  uint32_t i = _SETTINGS_HEADER_LEN;
+  uint32_t n = 0;
+  bool r = true;
+
+  memset(_scratch, 0, sizeof(_scratch));
+  r = _is_valid(len);
+
+  if (r) {
+    total = _blob[10];
+    len -= 4;
+  }
+
+  for (n = 0; r && (n < total); n++) {
+    item = _blob[i];
+    if (((i + 2) > len) || ((i + 2 + _blob[i + 1]) > len)) {
+      r = false;
+    }
+    else if ((item > MEMORY_ITEM_INVALID) && (item < _ITEM_TOTAL) &&
+             (_blob[i + 1] <= MEMORY_ITEM_LEN_MAX)) {
+      _scratch[item].is_set = true;
+      _scratch[item].len = _blob[i + 1];
+      memcpy(_scratch[item].data, &_blob[i + 2], _blob[i + 1]);
+    }
+
+    i += 2 + _blob[i + 1];
+  }
+
+  if (r) {
+    memcpy(_items, _scratch, sizeof(_items));
+    _generation = _get_u32(&_blob[6]);
+  }
+
+  return r;
+}
+
+static bool
+_mount(void)
 {
   bool r = true;
   esp_err_t err = ESP_OK;
@@ -43,7 +202,10 @@ memory_init(void)
     // Use settings defined above to initialize and mount SPIFFS filesystem.
     // Note: esp_vfs_spiffs_register is an all-in-one convenience function.
     err = esp_vfs_spiffs_register(&conf);
-    if (err == ESP_FAIL) {
+    if (err == ESP_ERR_INVALID_STATE) {
+      // Already mounted.
+    }
+    else if (err == ESP_FAIL) {
       LOGE("Failed to mount or format filesystem");
       r = false;
     }
@@ -57,6 +219,136 @@ memory_init(void)
     }
   }
 
+  return r;
+}
+
+// Mirror the packed settings in _blob to RTC memory.
+static void
+_cache(uint32_t len)
+{
+  memcpy(_rtc_blob, _blob, len);
+  _rtc_len = len;
+}
+
+static bool
+_save(void)
+{
+  const char * path = _settings_files[(_generation + 1) & 1];
+  FILE * fp = NULL;
+  uint32_t len = _pack(_generation + 1);
+  bool r = true;
+
+  r = _mount();
+
+  if (r) {
+    fp = fopen(path, "w");
+  }
+
+  if (r && (NULL == fp)) {
+    LOGE("failed to open %s", path);
+    r = false;
+  }
+
+  if (r && (len != fwrite(_blob, sizeof(uint8_t), len, fp))) {
+    LOGE("failed to write %s", path);
+    r = false;
+  }
+
+  if (fp && (0 != fclose(fp))) {
+    r = false;
+  }
+
+  // Whatever is in the files now, the RTC copy must not claim otherwise.
+  _rtc_len = 0;
+  if (r) {
+    _generation++;
+    _cache(len);
+  }
+
+  return r;
+}
+
+// Read the file at path into _blob, returns the number of bytes read.
+static uint32_t
+_read(const char * path)
+{
+  FILE * fp = NULL;
+  uint32_t len = 0;
+
+  fp = fopen(path, "r");
+  if (fp) {
+    len = fread(_blob, sizeof(uint8_t), sizeof(_blob), fp);
+    fclose(fp);
+  }
+
+  return len;
+}
+
+// Load the newest good copy of the settings. A copy that cannot be unpacked
+// leaves the other one in effect.
+static bool
+_load(void)
+{
+  uint32_t len = 0;
+  uint32_t n = 0;
+  bool r = false;
+
+  memset(_items, 0, sizeof(_items));
+  _generation = 0;
+
+  for (n = 0; n < 2; n++) {
+    len = _read(_settings_files[n]);
+    if ((len > 0) && !_is_valid(len)) {
+      LOGE("%s is corrupt", _settings_files[n]);
+    }
+    else if ((len > 0) && (!r || (_get_u32(&_blob[6]) > _generation))) {
+      if (_unpack(len)) {
+        r = true;
+      }
+      else {
+        LOGE("%s is malformed", _settings_files[n]);
+      }
+    }
+  }
+
+  return r;
+}
+
+// Move the items from the files of older firmware into the settings file.
+static void
+_migrate(void)
+{
+  FILE * fp = NULL;
+  uint32_t total = 0;
+  uint32_t n = 0;
+
+  for (n = 1; n < _ITEM_TOTAL; n++) {
+    fp = fopen(_file_lut[n], "r");
+    if (fp) {
+      _items[n].len = fread(_items[n].data, sizeof(uint8_t),
+        MEMORY_ITEM_LEN_MAX, fp);
+      _items[n].is_set = true;
+      fclose(fp);
+      total++;
+    }
+  }
+
+  if (total && _save()) {
+    LOGI("moved %d items into %s", total, _settings_files[_generation & 1]);
+    for (n = 1; n < _ITEM_TOTAL; n++) {
+      remove(_file_lut[n]);
+    }
+  }
+}
+
+/***** Global Functions *****/
+
+bool
+memory_init(void)
+{
+  bool is_cached = false;
+  bool r = true;
+
   if (r) {
     _mutex = xSemaphoreCreateMutex();
     if (NULL == _mutex) {
@@ -64,49 +356,56 @@ memory_init(void)
     }
   }
 
-  // TODO: Remove this...
-  if (r) {
-    size_t total = 0, used = 0;
-    err = esp_spiffs_info(NULL, &total, &used);
-    if (err != ESP_OK) {
-      LOGE("Failed to get SPIFFS partition information");
+  if (r && (_rtc_len <= sizeof(_blob))) {
+    memcpy(_blob, _rtc_blob, _rtc_len);
+    is_cached = _unpack(_rtc_len);
+  }
+
+  // No settings in RTC memory after a power cycle, go to the file system.
+  if (r && !is_cached) {
+    r = _mount();
+
+    if (r && !_load()) {
+      _migrate();
     }
-    else {
-      LOGI("Partition size: total: %d, used: %d", total, used);
+
+    if (r) {
+      _cache(_pack(_generation));
     }
   }
 
   return r;
 }
 
+void
+memory_deinit(void)
+{
+  _rtc_len = 0;
+  esp_vfs_spiffs_unregister(NULL);
+}
+
 int32_t
 memory_get_item(enum memory_item item, uint8_t * dst, uint32_t len)
 {
-  FILE * fp = NULL;
   int32_t s = -1;
   bool r = true;
 
-  if (item <= MEMORY_ITEM_INVALID) {
+  if ((item <= MEMORY_ITEM_INVALID) || (item >= _ITEM_TOTAL)) {
     LOGE("item = %d", item);
     r = false;
   }
 
   if (xSemaphoreTake(_mutex, portMAX_DELAY)) {
-    if (r) {
-      fp = fopen(_file_lut[item], "r");
-      if (!fp) {
-        LOGE("failed to open %s", _file_lut[item]);
-        r = false;
-      }
+    if (r && !_items[item].is_set) {
+      LOGE("item %d is not set", item);
+      r = false;
     }
 
     if (r) {
-      s = fread(dst, sizeof(uint8_t), len, fp);
+      s = (len < _items[item].len) ? len : _items[item].len;
+      memcpy(dst, _items[item].data, s);
     }
 
-    if (fp) {
-      fclose(fp);
-    }
     xSemaphoreGive(_mutex);
   }
 
@@ -116,30 +415,38 @@ memory_get_item(enum memory_item item, uint8_t * dst, uint32_t len)
 int32_t
 memory_set_item(enum memory_item item, uint8_t * src, uint32_t len)
 {
-  FILE * fp = NULL;
+  struct _item old;
   int32_t s = -1;
   bool r = true;
 
-  if (item <= MEMORY_ITEM_INVALID) {
+  if ((item <= MEMORY_ITEM_INVALID) || (item >= _ITEM_TOTAL) ||
+      (len > MEMORY_ITEM_LEN_MAX)) {
+    LOGE("item = %d, len = %d", item, len);
     r = false;
   }
 
   if (xSemaphoreTake(_mutex, portMAX_DELAY)) {
-    if (r) {
-      fp = fopen(_file_lut[item], "w");
-      if (NULL == fp) {
-        LOGE("failed to open %s", _file_lut[item]);
-        r = false;
-      }
+    // Only go to the file system when the item changes.
+    if (r && _items[item].is_set && (len == _items[item].len) &&
+        (0 == memcmp(src, _items[item].data, len))) {
+      s = len;
+      r = false;
     }
 
     if (r) {
-      s = fwrite(src, sizeof(uint8_t), len, fp);
-    }
+      old = _items[item];
+      _items[item].is_set = true;
+      _items[item].len = len;
+      memcpy(_items[item].data, src, len);
 
-    if (fp) {
-      fclose(fp);
+      if (_save()) {
+        s = len;
+      }
+      else {
+        _items[item] = old;
+      }
     }
+
     xSemaphoreGive(_mutex);
   }
 
@@ -149,12 +456,27 @@ memory_set_item(enum memory_item item, uint8_t * src, uint32_t len)
 bool
 memory_delete_item(enum memory_item item)
 {
-  bool r = false;
+  struct _item old;
+  bool r = true;
+
+  if ((item <= MEMORY_ITEM_INVALID) || (item >= _ITEM_TOTAL)) {
+    return false;
+  }
 
   if (xSemaphoreTake(_mutex, portMAX_DELAY)) {
-    if (0 != remove(_file_lut[item])) {
+    if (!_items[item].is_set) {
       r = false;
     }
+
+    if (r) {
+      old = _items[item];
+      _items[item].is_set = false;
+      r = _save();
+      if (!r) {
+        _items[item] = old;
+      }
+    }
+
     xSemaphoreGive(_mutex);
   }
 
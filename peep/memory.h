@@ -4,6 +4,12 @@
 /***** Includes *****/
 
 #include <stdint.h>
+#include <stdbool.h>
+
+/***** Defines *****/
+
+// Longest item, room for struct hatch_configuration to grow.
+#define MEMORY_ITEM_LEN_MAX (96)
 
 /***** Enums *****/
 
@@ -20,9 +26,23 @@ enum memory_item {
 
 /***** Global Functions *****/
 
+/*
+ * Items are kept together in one CRC protected settings file on SPIFFS. It is
+ * read into RAM once by memory_init(), gets are served from RAM and sets only
+ * write the file when the item changes. Items are at most MEMORY_ITEM_LEN_MAX
+ * bytes long.
+ *
+ * A copy of the file is kept in RTC memory, so after deep sleep memory_init()
+ * does not mount SPIFFS at all; that is left to the first set.
+ */
+
 extern bool
 memory_init(void);
 
+// Unmount SPIFFS and forget the copy in RTC memory, as after a power cycle.
+extern void
+memory_deinit(void);
+
 extern int32_t
 memory_get_item(enum memory_item item, uint8_t * dst, uint32_t len);
 
@@ -1,60 +1,548 @@
-/***** Local Data *****/
+/***** Includes *****/
+
+#include <string.h>
 
 #include "memory_measurement_db.h"
 #include "hatch_measurement.h"
+#include "hatch_measurement_codec.h"
+#include "hatch_measurement_rollup.h"
+#include "memory_measurement_stage.h"
+#include "ring_log.h"
 #include "system.h"
 
+#include "esp_attr.h"
+#include "esp_partition.h"
+
 /***** Defines *****/
 
-#define _FILE "/p/db"
+// Raw data partition the measurement log lives in, see partitions.csv.
+#define _PARTITION_LABEL "measure"
+// Log file used by older firmware, imported once and then removed.
+#define _LEGACY_FILE "/p/db"
+// Flash read size used when draining the log in batches.
+#define _BATCH_BUF_LEN (512)
+// Space at the end of the partition for the log of rollups, the rest holds
+// the measurements themselves.
+#define _ROLLUP_REGION_LEN (16 * RING_LOG_SECTOR_SIZE)
+// Once the measurement log is filled past this, the oldest measurements are
+// replaced by rollups of this period...
+#define _COMPACT_FILL_PERCENT (75)
+#define _COMPACT_PERIOD_SEC (60 * 60)
+// ...unless they are among the newest ones kept at full resolution.
+#define _COMPACT_KEEP_SEC (24 * 60 * 60)
+// Bounds the work done each time measurements are written.
+#define _COMPACT_PERIODS_MAX (8)
+// Records a reader can pass over for not decoding before it has to delete
+// what it read.
+#define _SKIPPED_LEN (64)
+// Words of the measurement log header holding the range uploaded newest
+// first.
+#define _USER_UPLOADED_FROM (0)
+#define _USER_UPLOADED_UNTIL (1)
+
+/***** Structs *****/
+
+struct _region {
+  const esp_partition_t * part;
+  uint32_t base;
+};
+
+// Entries handed to a reader and not deleted yet, and for each record it
+// passed over how many of them came before it. Deleting the oldest entries
+// removes those records along with them.
+struct _skips {
+  uint32_t read;
+  uint32_t skipped[_SKIPPED_LEN];
+  uint32_t total;
+};
 
 /***** Local Data *****/
 
 static SemaphoreHandle_t _mutex = NULL;
-static FILE * _fp = NULL;
+static struct _region _log_region;
+static struct _region _rollup_region;
+static struct ring_log _log;
+static struct ring_log _rollup_log;
+static struct hatch_measurement_codec _encoder;
+static struct hatch_measurement_codec _decoder;
+static uint8_t _batch_buf[_BATCH_BUF_LEN];
+// Measurements taken while offline wait here across deep sleeps, so flash is
+// only written once per MEMORY_MEASUREMENT_STAGE_LEN of them.
+static RTC_DATA_ATTR struct memory_measurement_stage _stage;
+static bool _is_reading = false;
+// The reader went past the newest measurement.
+static bool _is_read_end = false;
+// Records the measurement reader passed over. Only kept while the reader
+// started at the oldest measurement, as deleting counts from there.
+static bool _is_skip_tracked = false;
+static struct _skips _read_skips;
+// Records the last rollup read passed over, it always starts at the oldest.
+static struct _skips _rollup_skips;
+
+/***** Local Functions *****/
+
+static bool
+_flash_read(void * ctx, uint32_t addr, void * dst, uint32_t len)
+{
+  const struct _region * region = (const struct _region *) ctx;
+
+  return (ESP_OK ==
+          esp_partition_read(region->part, region->base + addr, dst, len)) ?
+    true :
+    false;
+}
+
+static bool
+_flash_write(void * ctx, uint32_t addr, const void * src, uint32_t len)
+{
+  const struct _region * region = (const struct _region *) ctx;
+
+  return (ESP_OK ==
+          esp_partition_write(region->part, region->base + addr, src, len)) ?
+    true :
+    false;
+}
+
+static bool
+_flash_erase(void * ctx, uint32_t addr, uint32_t len)
+{
+  const struct _region * region = (const struct _region *) ctx;
+
+  return (ESP_OK ==
+          esp_partition_erase_range(region->part, region->base + addr, len)) ?
+    true :
+    false;
+}
+
+static bool
+_log_open(struct ring_log * log, struct _region * region, uint32_t size,
+  const char * name)
+{
+  struct ring_log_flash flash;
+  bool r = true;
+
+  flash.read = _flash_read;
+  flash.write = _flash_write;
+  flash.erase = _flash_erase;
+  flash.ctx = (void *) region;
+  flash.size = size;
+  r = ring_log_init(log, &flash);
+
+  if (r && !ring_log_mount(log)) {
+    LOGI("no valid %s log, formatting", name);
+    r = ring_log_format(log);
+    if (!r) {
+      LOGE("failed to format %s log", name);
+    }
+  }
+
+  return r;
+}
+
+// Records are delta coded from the previous one in the same sector, so bring
+// the codec up to date by decoding from the start of end's sector. A record
+// that does not decode leaves the codec as it was, for readers as well.
+static bool
+_codec_sync(struct hatch_measurement_codec * codec, struct ring_log_pos end)
+{
+  struct hatch_measurement meas;
+  struct ring_log_pos pos = {end.sector, 0};
+  uint8_t buf[RING_LOG_RECORD_LEN_MAX];
+  uint32_t len = 0;
+  bool r = true;
+
+  hatch_measurement_codec_reset(codec);
+
+  while (r && (pos.sector == end.sector) && (pos.offset < end.offset)) {
+    r = ring_log_read_at(&_log, &pos, buf, &len);
+    if (r) {
+      hatch_measurement_decode(codec, buf, len, &meas);
+    }
+  }
+
+  return r;
+}
+
+static bool
+_append(const struct hatch_measurement * p_meas)
+{
+  struct hatch_measurement_codec codec = _encoder;
+  uint8_t buf[HATCH_MEASUREMENT_CODEC_LEN_MAX];
+  uint32_t len = 0;
+  bool r = true;
+
+  len = hatch_measurement_encode(&codec, p_meas, buf, false);
+  if (ring_log_is_sector_start(&_log, len)) {
+    len = hatch_measurement_encode(&codec, p_meas, buf, true);
+  }
+
+  r = ring_log_append(&_log, buf, len);
+  if (r) {
+    _encoder = codec;
+  }
+
+  return r;
+}
+
+// Timestamp of the key record that starts the n-th sector in use.
+static bool
+_sector_time(uint32_t n, uint32_t * unix_timestamp)
+{
+  struct hatch_measurement_codec codec;
+  struct hatch_measurement meas;
+  struct ring_log_pos pos = ring_log_sector_pos(&_log, n);
+  uint8_t buf[RING_LOG_RECORD_LEN_MAX];
+  uint32_t len = 0;
+  bool r = true;
+
+  hatch_measurement_codec_reset(&codec);
+
+  r = ring_log_read_at(&_log, &pos, buf, &len);
+  if (r) {
+    r = hatch_measurement_decode(&codec, buf, len, &meas);
+  }
+
+  if (r) {
+    *unix_timestamp = meas.unix_timestamp;
+  }
+
+  return r;
+}
+
+// Move the read cursor and decoder to the first measurement taken at or
+// after unix_timestamp.
+static bool
+_seek_time(uint32_t unix_timestamp)
+{
+  struct hatch_measurement_codec codec;
+  struct hatch_measurement meas;
+  struct ring_log_pos tail = ring_log_tail(&_log);
+  struct ring_log_pos pos;
+  struct ring_log_pos prev;
+  uint8_t buf[RING_LOG_RECORD_LEN_MAX];
+  uint32_t len = 0;
+  uint32_t lo = 0;
+  uint32_t hi = ring_log_sectors_used(&_log);
+  uint32_t mid = 0;
+  uint32_t ts = 0;
+  bool r = true;
+
+  // Find the last sector that starts at or before the time, its key record
+  // makes any sector decodable on its own.
+  while (r && ((lo + 1) < hi)) {
+    mid = lo + ((hi - lo) / 2);
+    r = _sector_time(mid, &ts);
+    if (r && (ts <= unix_timestamp)) {
+      lo = mid;
+    }
+    else if (r) {
+      hi = mid;
+    }
+  }
+
+  // Then walk that sector. Records before the tail only feed the decoder.
+  hatch_measurement_codec_reset(&codec);
+  pos = ring_log_sector_pos(&_log, lo);
+  prev = pos;
+  while (r) {
+    _decoder = codec;
+    prev = pos;
+    if (!ring_log_read_at(&_log, &pos, buf, &len)) {
+      break;
+    }
+    if (hatch_measurement_decode(&codec, buf, len, &meas) &&
+        (meas.unix_timestamp >= unix_timestamp) &&
+        ((prev.sector != tail.sector) || (prev.offset >= tail.offset))) {
+      break;
+    }
+  }
+
+  if (r) {
+    ring_log_read_seek(&_log, prev);
+    _is_skip_tracked =
+      ((prev.sector == tail.sector) && (prev.offset == tail.offset)) ?
+      true : false;
+    memset(&_read_skips, 0, sizeof(_read_skips));
+  }
+
+  return r;
+}
+
+// Decode the next measurement from the log's read cursor, going through
+// _batch_buf. i and len keep track of what is left in the buffer, offset is
+// moved past the frame of the measurement.
+static bool
+_read_buffered(struct hatch_measurement_codec * codec, uint32_t * i,
+  uint32_t * len, uint32_t * offset, struct hatch_measurement * meas)
+{
+  uint32_t total = 0;
+  bool r = true;
+
+  if (*i >= *len) {
+    *i = 0;
+    r = ring_log_read_frames(&_log, _batch_buf, sizeof(_batch_buf),
+      UINT32_MAX, len, &total);
+  }
+
+  if (r) {
+    r = hatch_measurement_decode(codec, &_batch_buf[*i + 1], _batch_buf[*i],
+      meas);
+    *offset += _batch_buf[*i] + RING_LOG_FRAME_OVERHEAD;
+    *i += _batch_buf[*i] + 1;
+  }
+
+  return r;
+}
+
+// Replace the oldest measurements with rollups, one period at a time, while
+// the log is too full. Measurements taken within _COMPACT_KEEP_SEC of newest
+// are left alone.
+static bool
+_compact(uint32_t newest)
+{
+  struct hatch_measurement_rollup rollup;
+  struct hatch_measurement_codec codec;
+  struct hatch_measurement meas;
+  struct ring_log_pos tail = ring_log_tail(&_log);
+  struct ring_log_pos start = {tail.sector, 0};
+  uint32_t offset = 0;
+  uint32_t limit = 0;
+  uint32_t periods = 0;
+  uint32_t total = 0;
+  uint32_t len = 0;
+  uint32_t i = 0;
+  bool is_found = false;
+  bool r = true;
+
+  limit = (ring_log_capacity(&_log) / 100) * _COMPACT_FILL_PERCENT;
+  if (ring_log_used(&_log) <= limit) {
+    return true;
+  }
+
+  // Read from the key record of the tail sector, to get the codec in sync
+  // with the tail without a flash read per record.
+  hatch_measurement_codec_reset(&codec);
+  ring_log_read_seek(&_log, start);
+  do {
+    is_found = _read_buffered(&codec, &i, &len, &offset, &meas);
+  } while (is_found && (offset <= tail.offset));
+
+  while (r && is_found && (periods < _COMPACT_PERIODS_MAX) &&
+         (ring_log_used(&_log) > limit)) {
+    hatch_measurement_rollup_init(&rollup, meas.unix_timestamp,
+      _COMPACT_PERIOD_SEC);
+    if ((rollup.unix_timestamp + _COMPACT_PERIOD_SEC + _COMPACT_KEEP_SEC) >
+        newest) {
+      break;
+    }
+
+    total = 0;
+    while (is_found && hatch_measurement_rollup_add(&rollup, &meas)) {
+      total++;
+      is_found = _read_buffered(&codec, &i, &len, &offset, &meas);
+    }
+
+    // A full rollup log gives up its oldest rollups, which moves what the
+    // last rollup read counted from.
+    r = ring_log_append(&_rollup_log, &rollup, sizeof(rollup));
+    memset(&_rollup_skips, 0, sizeof(_rollup_skips));
+
+    if (r) {
+      r = ring_log_discard(&_log, total);
+    }
+
+    periods++;
+  }
+
+  if (!r) {
+    LOGE("failed to compact measurements");
+  }
+  else if (periods > 0) {
+    LOGI("compacted %d hours of measurements", periods);
+  }
+
+  return r;
+}
+
+static bool
+_stage_flush(void)
+{
+  uint32_t total = memory_measurement_stage_total(&_stage);
+  uint32_t n = 0;
+  bool r = true;
+
+  ring_log_append_begin(&_log);
+  for (n = 0; r && (n < total); n++) {
+    r = _append(memory_measurement_stage_get(&_stage, n));
+  }
+  r = ring_log_append_end(&_log) && r;
+
+  if (r && (total > 0)) {
+    _compact(memory_measurement_stage_get(&_stage, total - 1)->unix_timestamp);
+  }
+
+  if (r) {
+    memory_measurement_stage_clear(&_stage);
+  }
+  else {
+    // The encoder may have moved on with records that did not make it.
+    _codec_sync(&_encoder, ring_log_head(&_log));
+    LOGE("failed to write %d staged measurements", total);
+  }
+
+  return r;
+}
+
+// SPIFFS is only mounted here on a cold boot, which is how the first boot
+// after a firmware update starts.
+static void
+_legacy_import(void)
+{
+  struct hatch_measurement meas;
+  FILE * fp = NULL;
+  uint32_t total = 0;
+
+  fp = fopen(_LEGACY_FILE, "r");
+  if (fp) {
+    while (sizeof(meas) == fread(&meas, 1, sizeof(meas), fp)) {
+      if (_append(&meas)) {
+        total++;
+      }
+    }
+    fclose(fp);
+    remove(_LEGACY_FILE);
+    LOGI("imported %d measurements from %s", total, _LEGACY_FILE);
+  }
+}
+
+// Discard the total oldest entries of log the reader was handed, and the
+// records it passed over up to the next entry.
+static bool
+_skips_discard(struct ring_log * log, struct _skips * skips, uint32_t total)
+{
+  uint32_t records = total;
+  uint32_t n = 0;
+
+  total = (total < skips->read) ? total : skips->read;
+  while ((n < skips->total) && (skips->skipped[n] <= total)) {
+    n++;
+  }
+  records += n;
+
+  skips->total -= n;
+  memmove(skips->skipped, &skips->skipped[n],
+    skips->total * sizeof(skips->skipped[0]));
+  for (n = 0; n < skips->total; n++) {
+    skips->skipped[n] -= total;
+  }
+  skips->read -= total;
+
+  return ring_log_discard(log, records);
+}
+
+static bool
+_uploaded_set(uint32_t from, uint32_t until)
+{
+  uint32_t user[RING_LOG_USER_LEN];
+  bool r = true;
+
+  ring_log_user_get(&_log, user);
+  user[_USER_UPLOADED_FROM] = from;
+  user[_USER_UPLOADED_UNTIL] = until;
+  r = ring_log_user_set(&_log, user);
+  if (!r) {
+    LOGE("failed to store the uploaded range");
+  }
+
+  return r;
+}
 
 /***** Global Functions *****/
 
 bool
 memory_measurement_db_init(void)
 {
-  _mutex = xSemaphoreCreateMutex();
+  const esp_partition_t * part = NULL;
+  bool r = true;
 
-  return (NULL != _mutex) ? true : false;
+  if (r) {
+    _mutex = xSemaphoreCreateMutex();
+    if (NULL == _mutex) {
+      r = false;
+    }
+  }
+
+  if (r) {
+    part = esp_partition_find_first(
+      ESP_PARTITION_TYPE_DATA,
+      ESP_PARTITION_SUBTYPE_ANY,
+      _PARTITION_LABEL);
+    if (NULL == part) {
+      LOGE("failed to find %s partition", _PARTITION_LABEL);
+      r = false;
+    }
+  }
+
+  if (r && (part->size < (2 * _ROLLUP_REGION_LEN))) {
+    LOGE("%s partition is too small", _PARTITION_LABEL);
+    r = false;
+  }
+
+  if (r) {
+    _log_region.part = part;
+    _log_region.base = 0;
+    r = _log_open(&_log, &_log_region, part->size - _ROLLUP_REGION_LEN,
+      "measurement");
+  }
+
+  if (r) {
+    _rollup_region.part = part;
+    _rollup_region.base = part->size - _ROLLUP_REGION_LEN;
+    r = _log_open(&_rollup_log, &_rollup_region, _ROLLUP_REGION_LEN,
+      "rollup");
+    memset(&_rollup_skips, 0, sizeof(_rollup_skips));
+  }
+
+  if (r) {
+    r = _codec_sync(&_encoder, ring_log_head(&_log));
+    if (!r) {
+      LOGE("failed to decode measurement log");
+    }
+  }
+
+  if (r) {
+    memory_measurement_stage_init(&_stage);
+    _legacy_import();
+    LOGI("%d measurements stored, %d staged, %d rollups",
+      ring_log_count(&_log),
+      memory_measurement_stage_total(&_stage),
+      ring_log_count(&_rollup_log));
+  }
+
+  return r;
 }
 
 bool
 memory_measurement_db_add(struct hatch_measurement * p_meas)
 {
-  uint8_t * src = (uint8_t *) p_meas;
-  uint32_t len = sizeof(struct hatch_measurement);
-  int32_t s = 0;
   bool r = true;
 
-  if (_fp) {
+  if (_is_reading) {
     r = false;
   }
 
   if ((r) && xSemaphoreTake(_mutex, portMAX_DELAY)) {
-    if (r) {
-      _fp = fopen(_FILE, "a");
-      if (NULL == _fp) {
-        r = false;
-      }
+    if (memory_measurement_stage_is_full(&_stage)) {
+      r = _stage_flush();
     }
 
     if (r) {
-      s = fwrite(src, sizeof(uint8_t), len, _fp);
-    }
-
-    if (s != len) {
-      LOGE("wrote %d of %d bytes", s, len);
-      r = false;
+      r = memory_measurement_stage_add(&_stage, p_meas);
     }
 
-    if (_fp) {
-      fclose(_fp);
-      _fp = NULL;
+    if (r && memory_measurement_stage_is_full(&_stage)) {
+      // Already staged, it is written on a later try if this fails.
+      _stage_flush();
     }
 
     xSemaphoreGive(_mutex);
@@ -67,46 +555,117 @@ uint32_t
 memory_measurement_db_total(void)
 {
   uint32_t total = 0;
+
+  if (xSemaphoreTake(_mutex, portMAX_DELAY)) {
+    total = ring_log_count(&_log) + memory_measurement_stage_total(&_stage);
+
+    xSemaphoreGive(_mutex);
+  }
+
+  return total;
+}
+
+bool
+memory_measurement_db_delete_all(void)
+{
   bool r = true;
 
-  if (_fp) {
+  if (_is_reading) {
     r = false;
   }
 
   if ((r) && xSemaphoreTake(_mutex, portMAX_DELAY)) {
+    memory_measurement_stage_clear(&_stage);
+    r = ring_log_clear(&_log);
     if (r) {
-      _fp = fopen(_FILE, "r");
-      if (NULL == _fp) {
-        r = false;
-      }
+      r = ring_log_clear(&_rollup_log);
+      memset(&_rollup_skips, 0, sizeof(_rollup_skips));
     }
-
     if (r) {
-      fseek(_fp, 0L, SEEK_END);
-      total = ftell(_fp);
-      total = total / sizeof(struct hatch_measurement);
-      fclose(_fp);
-      _fp = NULL;
+      r = _uploaded_set(0, 0);
     }
 
     xSemaphoreGive(_mutex);
   }
 
-  return total;
+  return r;
 }
 
 bool
-memory_measurement_db_delete_all(void)
+memory_measurement_db_delete_oldest(uint32_t total)
+{
+  bool r = true;
+
+  if (xSemaphoreTake(_mutex, portMAX_DELAY)) {
+    r = (_is_reading && _is_skip_tracked) ?
+      _skips_discard(&_log, &_read_skips, total) :
+      ring_log_discard(&_log, total);
+    if (!r) {
+      LOGE("failed to delete %d measurements", total);
+    }
+
+    xSemaphoreGive(_mutex);
+  }
+
+  return r;
+}
+
+bool
+memory_measurement_db_uploaded_get(uint32_t * from, uint32_t * until)
+{
+  uint32_t user[RING_LOG_USER_LEN];
+  bool r = true;
+
+  if (xSemaphoreTake(_mutex, portMAX_DELAY)) {
+    ring_log_user_get(&_log, user);
+    *from = user[_USER_UPLOADED_FROM];
+    *until = user[_USER_UPLOADED_UNTIL];
+
+    xSemaphoreGive(_mutex);
+  }
+
+  return r;
+}
+
+bool
+memory_measurement_db_uploaded_set(uint32_t from, uint32_t until)
+{
+  bool r = true;
+
+  if (xSemaphoreTake(_mutex, portMAX_DELAY)) {
+    r = _uploaded_set(from, until);
+
+    xSemaphoreGive(_mutex);
+  }
+
+  return r;
+}
+
+bool
+memory_measurement_db_read_open(void)
 {
   bool r = true;
 
-  if (_fp) {
+  if (_is_reading) {
     r = false;
   }
 
   if ((r) && xSemaphoreTake(_mutex, portMAX_DELAY)) {
-    if (0 != remove(_FILE)) {
-      r = false;
+    // Everything is read back from flash, so staged measurements go first.
+    if (memory_measurement_stage_total(&_stage) > 0) {
+      r = _stage_flush();
+    }
+
+    if (r) {
+      r = _codec_sync(&_decoder, ring_log_tail(&_log));
+    }
+
+    if (r) {
+      ring_log_read_rewind(&_log);
+      _is_skip_tracked = true;
+      memset(&_read_skips, 0, sizeof(_read_skips));
+      _is_read_end = false;
+      _is_reading = true;
     }
 
     xSemaphoreGive(_mutex);
@@ -116,19 +675,26 @@ memory_measurement_db_delete_all(void)
 }
 
 bool
-memory_measurement_db_read_open(void)
+memory_measurement_db_read_entry(struct hatch_measurement * p_meas)
 {
+  uint8_t buf[RING_LOG_RECORD_LEN_MAX];
+  uint32_t len = 0;
   bool r = true;
 
-  if (_fp) {
+  if (!_is_reading) {
     r = false;
   }
 
   if ((r) && xSemaphoreTake(_mutex, portMAX_DELAY)) {
+    r = ring_log_read_next(&_log, buf, &len);
+    _is_read_end = !r;
     if (r) {
-      _fp = fopen(_FILE, "r");
-      if (NULL == _fp) {
-        r = false;
+      r = hatch_measurement_decode(&_decoder, buf, len, p_meas);
+      if (r) {
+        _read_skips.read++;
+      }
+      else if (_is_skip_tracked && (_read_skips.total < _SKIPPED_LEN)) {
+        _read_skips.skipped[_read_skips.total++] = _read_skips.read;
       }
     }
 
@@ -139,26 +705,77 @@ memory_measurement_db_read_open(void)
 }
 
 bool
-memory_measurement_db_read_entry(struct hatch_measurement * p_meas)
+memory_measurement_db_read_batch(struct hatch_measurement * dst, uint32_t max,
+  uint32_t * total)
 {
-  uint8_t * dst = (uint8_t *) p_meas;
-  uint32_t len = sizeof(struct hatch_measurement);
-  int32_t s = -1;
+  uint32_t frames = 0;
+  uint32_t len = 0;
+  uint32_t n = 0;
+  uint32_t i = 0;
   bool r = true;
 
-  if (NULL == _fp) {
+  *total = 0;
+
+  if (!_is_reading) {
     r = false;
   }
 
   if ((r) && xSemaphoreTake(_mutex, portMAX_DELAY)) {
-    if (r) {
-      s = fread(dst, sizeof(uint8_t), len, _fp);
+    // Never read more records than could be noted as passed over.
+    while (r && (*total < max) && (_read_skips.total < _SKIPPED_LEN)) {
+      frames = max - *total;
+      frames = (!_is_skip_tracked ||
+                (frames < (_SKIPPED_LEN - _read_skips.total))) ? frames :
+        (_SKIPPED_LEN - _read_skips.total);
+      r = ring_log_read_frames(&_log, _batch_buf, sizeof(_batch_buf),
+        frames, &len, &n);
+      _is_read_end = !r;
+
+      for (i = 0; r && (i < len); i += _batch_buf[i] + 1) {
+        if (hatch_measurement_decode(&_decoder, &_batch_buf[i + 1],
+            _batch_buf[i], &dst[*total])) {
+          (*total)++;
+          _read_skips.read++;
+        }
+        else if (_is_skip_tracked) {
+          _read_skips.skipped[_read_skips.total++] = _read_skips.read;
+        }
+      }
+    }
+    r = (*total) ? true : false;
+
+    xSemaphoreGive(_mutex);
+  }
+
+  return r;
+}
+
+bool
+memory_measurement_db_read_is_end(void)
+{
+  return _is_read_end;
+}
+
+bool
+memory_measurement_db_seek_time(uint32_t unix_timestamp)
+{
+  bool r = true;
+
+  if (!_is_reading) {
+    r = false;
+  }
+
+  if ((r) && xSemaphoreTake(_mutex, portMAX_DELAY)) {
+    r = _seek_time(unix_timestamp);
+    if (!r) {
+      LOGE("failed to seek to %d", unix_timestamp);
     }
+    _is_read_end = false;
 
     xSemaphoreGive(_mutex);
   }
 
-  return s;
+  return r;
 }
 
 bool
@@ -166,13 +783,78 @@ memory_measurement_db_read_close(void)
 {
   bool r = true;
 
-  if (NULL == _fp) {
+  if (!_is_reading) {
     r = false;
   }
 
   if ((r) && xSemaphoreTake(_mutex, portMAX_DELAY)) {
-    fclose(_fp);
-    _fp = NULL;
+    _is_reading = false;
+
+    xSemaphoreGive(_mutex);
+  }
+
+  return r;
+}
+
+uint32_t
+memory_measurement_db_rollup_total(void)
+{
+  uint32_t total = 0;
+
+  if (xSemaphoreTake(_mutex, portMAX_DELAY)) {
+    total = ring_log_count(&_rollup_log);
+
+    xSemaphoreGive(_mutex);
+  }
+
+  return total;
+}
+
+bool
+memory_measurement_db_rollup_read(struct hatch_measurement_rollup * dst,
+  uint32_t max, uint32_t * total)
+{
+  uint32_t len = 0;
+  bool r = true;
+
+  *total = 0;
+
+  if (xSemaphoreTake(_mutex, portMAX_DELAY)) {
+    memset(&_rollup_skips, 0, sizeof(_rollup_skips));
+    do {
+      // Records passed over ahead of the first rollup can go right away.
+      r = ring_log_discard(&_rollup_log, _rollup_skips.total);
+      ring_log_read_rewind(&_rollup_log);
+      memset(&_rollup_skips, 0, sizeof(_rollup_skips));
+      while (r && (*total < max) && (_rollup_skips.total < _SKIPPED_LEN)) {
+        r = ring_log_read_next(&_rollup_log, &dst[*total], &len);
+        if (r && (sizeof(struct hatch_measurement_rollup) == len)) {
+          (*total)++;
+          _rollup_skips.read++;
+        }
+        else if (r) {
+          _rollup_skips.skipped[_rollup_skips.total++] = _rollup_skips.read;
+        }
+      }
+    } while ((0 == *total) && _rollup_skips.total);
+    r = (*total) ? true : false;
+
+    xSemaphoreGive(_mutex);
+  }
+
+  return r;
+}
+
+bool
+memory_measurement_db_rollup_delete_oldest(uint32_t total)
+{
+  bool r = true;
+
+  if (xSemaphoreTake(_mutex, portMAX_DELAY)) {
+    r = _skips_discard(&_rollup_log, &_rollup_skips, total);
+    if (!r) {
+      LOGE("failed to delete %d rollups", total);
+    }
 
     xSemaphoreGive(_mutex);
   }
@@ -7,12 +7,15 @@
 #include <stdbool.h>
 
 #include "hatch_measurement.h"
+#include "hatch_measurement_rollup.h"
 
 /***** Global Functions *****/
 
 extern bool
 memory_measurement_db_init(void);
 
+// Measurements are staged in RTC memory and written to flash in batches of
+// MEMORY_MEASUREMENT_STAGE_LEN, or once the database is opened for reading.
 extern bool
 memory_measurement_db_add(struct hatch_measurement * meas);
 
@@ -22,15 +25,72 @@ memory_measurement_db_total(void);
 extern bool
 memory_measurement_db_delete_all(void);
 
+// Permanently remove the total oldest measurements, typically the ones just
+// uploaded. Can be called while the database is open for reading; the read
+// position is kept so uploading can continue with the next entry. Records the
+// reader passed over because they did not decode go along with the
+// measurements around them.
+extern bool
+memory_measurement_db_delete_oldest(uint32_t total);
+
+// Time range of the stored measurements already uploaded newest first, both
+// zero if there is none. It is kept in flash with the log, so an upload going
+// back in time picks up where it left off after a power cycle.
+extern bool
+memory_measurement_db_uploaded_get(uint32_t * from, uint32_t * until);
+
+extern bool
+memory_measurement_db_uploaded_set(uint32_t from, uint32_t until);
+
 extern bool
 memory_measurement_db_read_open(void);
 
 extern bool
 memory_measurement_db_read_entry(struct hatch_measurement * p_meas);
 
+// Read up to max of the next measurements into dst and set total to the
+// number read. Records that do not decode are passed over. Fails once no
+// measurements are left.
+extern bool
+memory_measurement_db_read_batch(struct hatch_measurement * dst, uint32_t max,
+  uint32_t * total);
+
+// True once reading went past the newest measurement. Reading from the oldest
+// one, read_batch() also fails short of it when too many records were passed
+// over since the last delete. The rest is then left for the next time the
+// database is opened.
+extern bool
+memory_measurement_db_read_is_end(void);
+
+// Position the read cursor on the first measurement taken at or after
+// unix_timestamp, or past the last one if there is none. Takes about log2 of
+// the number of flash sectors in use plus one sector worth of reads, relying
+// on measurements being stored in time order.
+extern bool
+memory_measurement_db_seek_time(uint32_t unix_timestamp);
+
 extern bool
 memory_measurement_db_read_close(void);
 
+/*
+ * When the log runs low on space the oldest measurements are replaced by
+ * hourly rollups, though never the ones from the last day. Rollups are kept
+ * apart from the measurements and cover the time before the oldest of them.
+ */
+
+extern uint32_t
+memory_measurement_db_rollup_total(void);
+
+// Read up to max of the oldest rollups into dst and set total to the number
+// read. Fails if there are none. Records that are not rollups are passed over
+// and go with the rollups around them when those are deleted.
+extern bool
+memory_measurement_db_rollup_read(struct hatch_measurement_rollup * dst,
+  uint32_t max, uint32_t * total);
+
+extern bool
+memory_measurement_db_rollup_delete_oldest(uint32_t total);
+
 #endif
 
 
@@ -0,0 +1,67 @@
+/***** Includes *****/
+
+#include <string.h>
+
+#include "memory_measurement_stage.h"
+
+/***** Defines *****/
+
+#define _MAGIC (0x47545350) // "PSTG"
+
+/***** Global Functions *****/
+
+uint32_t
+memory_measurement_stage_init(struct memory_measurement_stage * stage)
+{
+  if ((_MAGIC != stage->magic) ||
+      (stage->total > MEMORY_MEASUREMENT_STAGE_LEN)) {
+    memory_measurement_stage_clear(stage);
+  }
+
+  return stage->total;
+}
+
+bool
+memory_measurement_stage_add(struct memory_measurement_stage * stage,
+  const struct hatch_measurement * meas)
+{
+  bool r = true;
+
+  if (stage->total >= MEMORY_MEASUREMENT_STAGE_LEN) {
+    r = false;
+  }
+
+  if (r) {
+    // Count it only once it is complete, in case of a reset in between.
+    stage->meas[stage->total] = *meas;
+    stage->total++;
+  }
+
+  return r;
+}
+
+bool
+memory_measurement_stage_is_full(struct memory_measurement_stage * stage)
+{
+  return (stage->total >= MEMORY_MEASUREMENT_STAGE_LEN) ? true : false;
+}
+
+uint32_t
+memory_measurement_stage_total(struct memory_measurement_stage * stage)
+{
+  return stage->total;
+}
+
+const struct hatch_measurement *
+memory_measurement_stage_get(struct memory_measurement_stage * stage,
+  uint32_t n)
+{
+  return (n < stage->total) ? &(stage->meas[n]) : NULL;
+}
+
+void
+memory_measurement_stage_clear(struct memory_measurement_stage * stage)
+{
+  memset(stage, 0, sizeof(struct memory_measurement_stage));
+  stage->magic = _MAGIC;
+}
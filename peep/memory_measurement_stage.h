@@ -0,0 +1,56 @@
+#ifndef _MEMORY_MEASUREMENT_STAGE_H
+#define _MEMORY_MEASUREMENT_STAGE_H
+
+/***** Includes *****/
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "hatch_measurement.h"
+
+/***** Defines *****/
+
+// Measurements collected before they have to be written to flash.
+#define MEMORY_MEASUREMENT_STAGE_LEN (16)
+
+/***** Structs *****/
+
+/*
+ * Measurements waiting to be written to flash, meant to live in RTC memory so
+ * they survive deep sleep. RTC memory holds garbage after a power on, which
+ * memory_measurement_stage_init() detects and starts over. A power cut loses
+ * whatever is staged.
+ */
+struct memory_measurement_stage {
+  uint32_t magic;
+  uint32_t total;
+  struct hatch_measurement meas[MEMORY_MEASUREMENT_STAGE_LEN];
+};
+
+/***** Global Functions *****/
+
+// Keep the staged measurements if stage holds a valid state, otherwise empty
+// it. Returns the number of measurements kept.
+extern uint32_t
+memory_measurement_stage_init(struct memory_measurement_stage * stage);
+
+// Fails if the stage is full.
+extern bool
+memory_measurement_stage_add(struct memory_measurement_stage * stage,
+  const struct hatch_measurement * meas);
+
+extern bool
+memory_measurement_stage_is_full(struct memory_measurement_stage * stage);
+
+extern uint32_t
+memory_measurement_stage_total(struct memory_measurement_stage * stage);
+
+// Get the n-th oldest staged measurement.
+extern const struct hatch_measurement *
+memory_measurement_stage_get(struct memory_measurement_stage * stage,
+  uint32_t n);
+
+extern void
+memory_measurement_stage_clear(struct memory_measurement_stage * stage);
+
+#endif
@@ -0,0 +1,870 @@
+/***** Includes *****/
+
+#include <stddef.h>
+#include <string.h>
+
+#include "ring_log.h"
+
+/***** Defines *****/
+
+#define _MAGIC (0x474F4C50) // "PLOG"
+#define _META_SIZE (RING_LOG_META_SECTORS * RING_LOG_SECTOR_SIZE)
+#define _META_SLOT_LEN (sizeof(struct ring_log_header))
+// Headers read per flash access while looking for the newest one.
+#define _META_SCAN_SLOTS (8)
+// Layout version of the data area, bumped on incompatible changes.
+#define _VERSION (4)
+// Bytes in front of the record: length, then the low byte of its sequence
+// number.
+#define _FRAME_HDR_LEN (2)
+// Flash read per access while walking the records of a sector.
+#define _WALK_CHUNK_LEN (256)
+
+/***** Macros *****/
+
+#define _FRAME_LEN(len) (RING_LOG_FRAME_OVERHEAD + (len))
+
+/***** Local Functions *****/
+
+static uint32_t
+_crc32(uint32_t crc, const void * buf, uint32_t len)
+{
+  const uint8_t * p = (const uint8_t *) buf;
+  uint32_t n = 0;
+
+  crc = ~crc;
+  while (len--) {
+    crc ^= *p++;
+    for (n = 0; n < 8; n++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+
+  return ~crc;
+}
+
+static uint16_t
+_crc16(const uint8_t * p, uint32_t len)
+{
+  uint16_t crc = 0xFFFF;
+  uint32_t n = 0;
+
+  while (len--) {
+    crc ^= (uint16_t) (*p++) << 8;
+    for (n = 0; n < 8; n++) {
+      crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+    }
+  }
+
+  return crc;
+}
+
+static bool
+_is_blank(const void * buf, uint32_t len)
+{
+  const uint8_t * p = (const uint8_t *) buf;
+
+  while (len--) {
+    if (0xFF != *p++) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static bool
+_is_header_valid(const struct ring_log_header * hdr)
+{
+  if (_MAGIC != hdr->magic) {
+    return false;
+  }
+
+  return (hdr->crc == _crc32(0, hdr, offsetof(struct ring_log_header, crc))) ?
+    true :
+    false;
+}
+
+static uint32_t
+_sector_addr(struct ring_log * log, uint32_t sector)
+{
+  return _META_SIZE + (sector * RING_LOG_SECTOR_SIZE);
+}
+
+static uint32_t
+_pos_addr(struct ring_log * log, const struct ring_log_pos * pos)
+{
+  return _sector_addr(log, pos->sector) + pos->offset;
+}
+
+// Distance of pos from the start of sector, following the ring.
+static uint32_t
+_pos_rank(struct ring_log * log, uint32_t sector,
+  const struct ring_log_pos * pos)
+{
+  uint32_t n = (pos->sector + log->sectors - sector) % log->sectors;
+
+  return (n * RING_LOG_SECTOR_SIZE) + pos->offset;
+}
+
+// True if there are records from pos on, up to the head.
+static bool
+_pos_is_before_head(struct ring_log * log, const struct ring_log_pos * pos)
+{
+  const struct ring_log_header * hdr = &(log->hdr);
+
+  return (_pos_rank(log, hdr->tail.sector, pos) <
+          _pos_rank(log, hdr->tail.sector, &(hdr->head))) ?
+    true :
+    false;
+}
+
+static void
+_pos_next_sector(struct ring_log * log, struct ring_log_pos * pos)
+{
+  pos->sector = (pos->sector + 1) % log->sectors;
+  pos->offset = 0;
+}
+
+// Length of the record in the frame at the start of buf, or 0 if there is no
+// complete frame with a good CRC in the avail bytes.
+static uint32_t
+_frame_check(const uint8_t * buf, uint32_t avail)
+{
+  uint32_t len = (avail > 0) ? buf[0] : 0;
+  uint32_t end = 0;
+  uint16_t crc = 0;
+
+  if ((avail < _FRAME_LEN(1)) || (0 == len) ||
+      (len > RING_LOG_RECORD_LEN_MAX) || (_FRAME_LEN(len) > avail)) {
+    return 0;
+  }
+
+  end = _FRAME_HDR_LEN + len;
+  crc = (uint16_t) (buf[end] | (buf[end + 1] << 8));
+
+  return (crc == _crc16(buf, end)) ? len : 0;
+}
+
+/*
+ * Walk up to max records starting at pos, which ends up just past the last
+ * one. total is set to the number walked. Reads go in chunks so a whole
+ * sector costs a couple of dozen accesses at most.
+ *
+ * With seq set every record also has to carry the expected sequence number,
+ * which is advanced as records are found. With is_clean set the space after
+ * the last record is checked to still be erased.
+ */
+static bool
+_sector_walk(struct ring_log * log, struct ring_log_pos * pos, uint32_t max,
+  uint32_t * total, uint32_t * seq, bool * is_clean)
+{
+  const struct ring_log_flash * f = &(log->flash);
+  uint8_t buf[_WALK_CHUNK_LEN];
+  uint32_t base = pos->offset;
+  uint32_t chunk = 0;
+  uint32_t len = 0;
+  uint32_t i = 0;
+  bool is_done = false;
+  bool r = true;
+
+  *total = 0;
+
+  while (r && !is_done && (*total < max)) {
+    base = pos->offset;
+    chunk = RING_LOG_SECTOR_SIZE - base;
+    if (chunk > sizeof(buf)) {
+      chunk = sizeof(buf);
+    }
+    if (chunk < _FRAME_LEN(1)) {
+      break;
+    }
+
+    r = f->read(f->ctx, _sector_addr(log, pos->sector) + base, buf, chunk);
+
+    for (i = 0; r && (*total < max); i += _FRAME_LEN(len)) {
+      len = _frame_check(&buf[i], chunk - i);
+      if ((len > 0) && seq && (buf[i + 1] != (uint8_t) *seq)) {
+        len = 0;
+      }
+      if (0 == len) {
+        // Either the frame runs past the chunk and is read again from its
+        // start, or this is where the records end.
+        is_done = ((chunk - i) >= _FRAME_LEN(RING_LOG_RECORD_LEN_MAX)) ||
+          ((base + chunk) == RING_LOG_SECTOR_SIZE);
+        is_done = is_done || (0 == i);
+        break;
+      }
+      pos->offset += _FRAME_LEN(len);
+      (*total)++;
+      if (seq) {
+        (*seq)++;
+      }
+    }
+  }
+
+  if (is_clean) {
+    *is_clean = true;
+    for (base = pos->offset; r && *is_clean && (base < RING_LOG_SECTOR_SIZE);
+         base += chunk) {
+      chunk = RING_LOG_SECTOR_SIZE - base;
+      if (chunk > sizeof(buf)) {
+        chunk = sizeof(buf);
+      }
+      r = f->read(f->ctx, _sector_addr(log, pos->sector) + base, buf, chunk);
+      *is_clean = r && _is_blank(buf, chunk);
+    }
+  }
+
+  return r;
+}
+
+// Read the frame at pos. len is set to 0 if there is none.
+static bool
+_frame_get(struct ring_log * log, const struct ring_log_pos * pos,
+  uint8_t * buf, uint32_t * len)
+{
+  const struct ring_log_flash * f = &(log->flash);
+  uint32_t chunk = _FRAME_LEN(RING_LOG_RECORD_LEN_MAX);
+  bool r = true;
+
+  *len = 0;
+
+  // Grab the largest possible frame in one access.
+  if ((pos->offset + chunk) > RING_LOG_SECTOR_SIZE) {
+    chunk = RING_LOG_SECTOR_SIZE - pos->offset;
+  }
+
+  if (chunk >= _FRAME_LEN(1)) {
+    r = f->read(f->ctx, _pos_addr(log, pos), buf, chunk);
+    if (r) {
+      *len = _frame_check(buf, chunk);
+    }
+  }
+
+  return r;
+}
+
+// Make sure pos points at a record, moving on to the next sector if the
+// current one has no more.
+static bool
+_pos_normalize(struct ring_log * log, struct ring_log_pos * pos)
+{
+  uint8_t buf[_FRAME_LEN(RING_LOG_RECORD_LEN_MAX)];
+  uint32_t len = 0;
+  bool r = true;
+
+  r = _frame_get(log, pos, buf, &len);
+  if (r && (0 == len)) {
+    _pos_next_sector(log, pos);
+  }
+
+  return r;
+}
+
+static bool
+_header_commit(struct ring_log * log)
+{
+  const struct ring_log_flash * f = &(log->flash);
+  bool r = true;
+
+  log->hdr.generation++;
+  log->hdr.crc = _crc32(0, &(log->hdr), offsetof(struct ring_log_header, crc));
+
+  if (0 == (log->meta_addr % RING_LOG_SECTOR_SIZE)) {
+    // Starting over in a meta sector, the other one still has a good copy.
+    r = f->erase(f->ctx, log->meta_addr, RING_LOG_SECTOR_SIZE);
+  }
+
+  if (r) {
+    r = f->write(f->ctx, log->meta_addr, &(log->hdr), _META_SLOT_LEN);
+  }
+
+  log->meta_addr = (log->meta_addr + _META_SLOT_LEN) % _META_SIZE;
+
+  return r;
+}
+
+static bool
+_header_load(struct ring_log * log)
+{
+  const struct ring_log_flash * f = &(log->flash);
+  struct ring_log_header buf[_META_SCAN_SLOTS];
+  uint32_t newest = 0;
+  uint32_t addr = 0;
+  uint32_t n = 0;
+  bool is_found = false;
+  bool r = true;
+
+  for (addr = 0; r && (addr < _META_SIZE); addr += sizeof(buf)) {
+    r = f->read(f->ctx, addr, buf, sizeof(buf));
+
+    for (n = 0; r && (n < _META_SCAN_SLOTS); n++) {
+      if (_is_header_valid(&buf[n]) &&
+          (!is_found || (buf[n].generation > log->hdr.generation))) {
+        log->hdr = buf[n];
+        newest = addr + (n * _META_SLOT_LEN);
+        is_found = true;
+      }
+    }
+  }
+
+  if (r && !is_found) {
+    r = false;
+  }
+
+  if (r) {
+    // Step over any torn copies written after the newest good one. Once a
+    // sector boundary is reached the next commit erases it anyway.
+    log->meta_addr = (newest + _META_SLOT_LEN) % _META_SIZE;
+    while (r && (0 != (log->meta_addr % RING_LOG_SECTOR_SIZE))) {
+      r = f->read(f->ctx, log->meta_addr, &buf[0], _META_SLOT_LEN);
+      if (r && _is_blank(&buf[0], _META_SLOT_LEN)) {
+        break;
+      }
+      log->meta_addr = (log->meta_addr + _META_SLOT_LEN) % _META_SIZE;
+    }
+  }
+
+  return r;
+}
+
+// The bytes at the head were partly programmed, so the rest of the sector can
+// not be written safely any more. It is closed and appending resumes in the
+// next one. A sector torn right at its start is erased instead, readers rely
+// on every sector up to the head holding at least one record.
+static bool
+_head_close(struct ring_log * log)
+{
+  const struct ring_log_flash * f = &(log->flash);
+  struct ring_log_header * hdr = &(log->hdr);
+  bool r = true;
+
+  if (0 == hdr->head.offset) {
+    r = f->erase(f->ctx, _pos_addr(log, &(hdr->head)), RING_LOG_SECTOR_SIZE);
+  }
+  else {
+    hdr->head.offset = RING_LOG_SECTOR_SIZE;
+  }
+
+  return r;
+}
+
+// Count the records appended to the head sector since the header was last
+// committed, closing it if an append was interrupted.
+static bool
+_head_scan(struct ring_log * log)
+{
+  struct ring_log_header * hdr = &(log->hdr);
+  uint32_t total = 0;
+  bool is_clean = true;
+  bool r = true;
+
+  r = _sector_walk(log, &(hdr->head), UINT32_MAX, &total, &(hdr->seq),
+    &is_clean);
+
+  if (r) {
+    hdr->count += total;
+  }
+
+  if (r && !is_clean) {
+    r = _head_close(log);
+  }
+
+  return r;
+}
+
+// Move the tail past the total oldest records, moving the read cursor along
+// if it was on one of them.
+static bool
+_tail_advance(struct ring_log * log, uint32_t total)
+{
+  struct ring_log_header * hdr = &(log->hdr);
+  uint32_t sector = hdr->tail.sector;
+  uint32_t hops = 0;
+  uint32_t n = 0;
+  bool r = true;
+
+  if (total > hdr->count) {
+    total = hdr->count;
+  }
+
+  hdr->count -= total;
+  while (r && (total > 0)) {
+    r = _sector_walk(log, &(hdr->tail), total, &n, NULL, NULL);
+    total -= (r) ? n : 0;
+    if (r && (total > 0)) {
+      r = (++hops < log->sectors) ? true : false;
+      _pos_next_sector(log, &(hdr->tail));
+    }
+  }
+
+  if (r && (0 == hdr->count)) {
+    hdr->tail = hdr->head;
+  }
+  else if (r) {
+    // Keep the tail in the sector that holds the oldest record, the head
+    // relies on that to notice when it catches up.
+    r = _pos_normalize(log, &(hdr->tail));
+  }
+
+  if (_pos_rank(log, sector, &(log->read)) <
+      _pos_rank(log, sector, &(hdr->tail))) {
+    log->read = hdr->tail;
+  }
+
+  return r;
+}
+
+// Program the records collected since ring_log_append_begin(). They all sit
+// in the head sector, right before the head.
+static bool
+_pending_flush(struct ring_log * log)
+{
+  const struct ring_log_flash * f = &(log->flash);
+  struct ring_log_header * hdr = &(log->hdr);
+  struct ring_log_pos pos = hdr->head;
+  bool r = true;
+
+  if (log->pending_len > 0) {
+    pos.offset -= log->pending_len;
+    r = f->write(f->ctx, _pos_addr(log, &pos), log->pending, log->pending_len);
+    if (!r) {
+      hdr->head = pos;
+      hdr->count -= log->pending_count;
+      hdr->seq -= log->pending_count;
+      _head_close(log);
+    }
+  }
+
+  log->pending_len = 0;
+  log->pending_count = 0;
+
+  return r;
+}
+
+static bool
+_head_advance(struct ring_log * log)
+{
+  const struct ring_log_flash * f = &(log->flash);
+  struct ring_log_header * hdr = &(log->hdr);
+  struct ring_log_pos next = hdr->head;
+  struct ring_log_pos end = hdr->tail;
+  uint32_t dropped = 0;
+  bool r = true;
+
+  _pos_next_sector(log, &next);
+
+  if ((hdr->count > 0) && (hdr->tail.sector == next.sector)) {
+    // Log is full, give up the oldest sector. The header is committed before
+    // the erase so a reset in between can not leave the tail on erased flash.
+    r = _sector_walk(log, &end, UINT32_MAX, &dropped, NULL, NULL);
+    if (r) {
+      r = _tail_advance(log, dropped);
+    }
+    if (r) {
+      r = _header_commit(log);
+    }
+  }
+
+  if (r) {
+    r = f->erase(f->ctx, _pos_addr(log, &next), RING_LOG_SECTOR_SIZE);
+  }
+
+  if (r) {
+    hdr->head = next;
+    if (0 == hdr->count) {
+      hdr->tail = hdr->head;
+    }
+    r = _header_commit(log);
+  }
+
+  return r;
+}
+
+/***** Global Functions *****/
+
+bool
+ring_log_init(struct ring_log * log, const struct ring_log_flash * flash)
+{
+  bool r = true;
+
+  memset(log, 0, sizeof(struct ring_log));
+
+  if (flash->size < _META_SIZE) {
+    r = false;
+  }
+
+  if (r) {
+    log->flash = *flash;
+    log->sectors = (flash->size - _META_SIZE) / RING_LOG_SECTOR_SIZE;
+    if (log->sectors < RING_LOG_DATA_SECTORS_MIN) {
+      r = false;
+    }
+  }
+
+  return r;
+}
+
+bool
+ring_log_mount(struct ring_log * log)
+{
+  struct ring_log_header * hdr = &(log->hdr);
+  bool r = true;
+
+  if (r) {
+    r = _header_load(log);
+  }
+
+  if (r && (_VERSION != hdr->version)) {
+    r = false;
+  }
+
+  if (r &&
+      ((hdr->head.sector >= log->sectors) ||
+       (hdr->tail.sector >= log->sectors) ||
+       (hdr->head.offset > RING_LOG_SECTOR_SIZE) ||
+       (hdr->tail.offset > RING_LOG_SECTOR_SIZE))) {
+    r = false;
+  }
+
+  if (r) {
+    r = _head_scan(log);
+  }
+
+  log->read = log->hdr.tail;
+
+  return r;
+}
+
+bool
+ring_log_format(struct ring_log * log)
+{
+  const struct ring_log_flash * f = &(log->flash);
+  uint32_t n = 0;
+  bool r = true;
+
+  memset(&(log->hdr), 0, sizeof(struct ring_log_header));
+  log->hdr.magic = _MAGIC;
+  log->hdr.version = _VERSION;
+  log->meta_addr = 0;
+  log->read = log->hdr.tail;
+
+  // The first meta sector is erased by the commit below.
+  for (n = 1; r && (n < RING_LOG_META_SECTORS); n++) {
+    r = f->erase(f->ctx, n * RING_LOG_SECTOR_SIZE, RING_LOG_SECTOR_SIZE);
+  }
+
+  if (r) {
+    r = f->erase(f->ctx, _sector_addr(log, 0), RING_LOG_SECTOR_SIZE);
+  }
+
+  if (r) {
+    r = _header_commit(log);
+  }
+
+  return r;
+}
+
+bool
+ring_log_append(struct ring_log * log, const void * record, uint32_t len)
+{
+  const struct ring_log_flash * f = &(log->flash);
+  struct ring_log_header * hdr = &(log->hdr);
+  uint8_t buf[_FRAME_LEN(RING_LOG_RECORD_LEN_MAX)];
+  uint16_t crc = 0;
+  bool r = true;
+
+  if ((0 == len) || (len > RING_LOG_RECORD_LEN_MAX)) {
+    r = false;
+  }
+
+  if (r && ((hdr->head.offset + _FRAME_LEN(len)) > RING_LOG_SECTOR_SIZE)) {
+    r = _pending_flush(log);
+    if (r) {
+      r = _head_advance(log);
+    }
+  }
+
+  if (r && log->is_pending &&
+      ((log->pending_len + _FRAME_LEN(len)) > RING_LOG_PENDING_LEN)) {
+    r = _pending_flush(log);
+  }
+
+  if (r) {
+    buf[0] = (uint8_t) len;
+    buf[1] = (uint8_t) hdr->seq;
+    memcpy(&buf[_FRAME_HDR_LEN], record, len);
+    crc = _crc16(buf, _FRAME_HDR_LEN + len);
+    buf[_FRAME_HDR_LEN + len] = (uint8_t) crc;
+    buf[_FRAME_HDR_LEN + len + 1] = (uint8_t) (crc >> 8);
+  }
+
+  if (r && log->is_pending) {
+    memcpy(&(log->pending[log->pending_len]), buf, _FRAME_LEN(len));
+    log->pending_len += _FRAME_LEN(len);
+    log->pending_count++;
+  }
+  else if (r) {
+    r = f->write(f->ctx, _pos_addr(log, &(hdr->head)), buf, _FRAME_LEN(len));
+    if (!r) {
+      _head_close(log);
+    }
+  }
+
+  if (r) {
+    hdr->head.offset += _FRAME_LEN(len);
+    hdr->count++;
+    hdr->seq++;
+  }
+
+  return r;
+}
+
+void
+ring_log_append_begin(struct ring_log * log)
+{
+  log->is_pending = true;
+}
+
+bool
+ring_log_append_end(struct ring_log * log)
+{
+  log->is_pending = false;
+
+  return _pending_flush(log);
+}
+
+bool
+ring_log_is_sector_start(struct ring_log * log, uint32_t len)
+{
+  const struct ring_log_pos * head = &(log->hdr.head);
+
+  return ((0 == head->offset) ||
+          ((head->offset + _FRAME_LEN(len)) > RING_LOG_SECTOR_SIZE)) ?
+    true :
+    false;
+}
+
+uint32_t
+ring_log_count(struct ring_log * log)
+{
+  return log->hdr.count;
+}
+
+uint32_t
+ring_log_capacity(struct ring_log * log)
+{
+  // One sector is always in the process of being refilled.
+  return (log->sectors - 1) * RING_LOG_SECTOR_SIZE;
+}
+
+uint32_t
+ring_log_used(struct ring_log * log)
+{
+  const struct ring_log_header * hdr = &(log->hdr);
+
+  return _pos_rank(log, hdr->tail.sector, &(hdr->head)) - hdr->tail.offset;
+}
+
+struct ring_log_pos
+ring_log_head(struct ring_log * log)
+{
+  return log->hdr.head;
+}
+
+struct ring_log_pos
+ring_log_tail(struct ring_log * log)
+{
+  return log->hdr.tail;
+}
+
+bool
+ring_log_clear(struct ring_log * log)
+{
+  struct ring_log_header * hdr = &(log->hdr);
+
+  hdr->tail = hdr->head;
+  hdr->count = 0;
+  log->read = log->hdr.tail;
+
+  return _header_commit(log);
+}
+
+bool
+ring_log_discard(struct ring_log * log, uint32_t total)
+{
+  bool r = true;
+
+  if (0 == total) {
+    return true;
+  }
+
+  r = _tail_advance(log, total);
+
+  if (r) {
+    r = _header_commit(log);
+  }
+
+  return r;
+}
+
+void
+ring_log_user_get(struct ring_log * log, uint32_t * user)
+{
+  memcpy(user, log->hdr.user, sizeof(log->hdr.user));
+}
+
+bool
+ring_log_user_set(struct ring_log * log, const uint32_t * user)
+{
+  if (0 == memcmp(user, log->hdr.user, sizeof(log->hdr.user))) {
+    return true;
+  }
+
+  memcpy(log->hdr.user, user, sizeof(log->hdr.user));
+
+  return _header_commit(log);
+}
+
+void
+ring_log_read_rewind(struct ring_log * log)
+{
+  log->read = log->hdr.tail;
+}
+
+void
+ring_log_read_seek(struct ring_log * log, struct ring_log_pos pos)
+{
+  log->read = pos;
+}
+
+uint32_t
+ring_log_sectors_used(struct ring_log * log)
+{
+  const struct ring_log_header * hdr = &(log->hdr);
+  uint32_t total = 0;
+
+  if (hdr->count > 0) {
+    total = (hdr->head.sector + log->sectors - hdr->tail.sector) %
+      log->sectors;
+    // A head at the start of its sector has nothing there yet.
+    total += (hdr->head.offset > 0) ? 1 : 0;
+  }
+
+  return total;
+}
+
+struct ring_log_pos
+ring_log_sector_pos(struct ring_log * log, uint32_t n)
+{
+  struct ring_log_pos pos;
+
+  pos.sector = (log->hdr.tail.sector + n) % log->sectors;
+  pos.offset = 0;
+
+  return pos;
+}
+
+bool
+ring_log_read_next(struct ring_log * log, void * record, uint32_t * len)
+{
+  return ring_log_read_at(log, &(log->read), record, len);
+}
+
+bool
+ring_log_read_frames(struct ring_log * log, uint8_t * dst, uint32_t dst_len,
+  uint32_t max, uint32_t * len, uint32_t * total)
+{
+  const struct ring_log_flash * f = &(log->flash);
+  struct ring_log_pos * pos = &(log->read);
+  uint32_t chunk = 0;
+  uint32_t hops = 0;
+  uint32_t in = 0;
+  uint32_t n = 0;
+  bool is_end = false;
+  bool r = true;
+
+  *len = 0;
+  *total = 0;
+
+  if ((0 == max) || !_pos_is_before_head(log, pos)) {
+    r = false;
+  }
+
+  while (r && (0 == *total)) {
+    chunk = RING_LOG_SECTOR_SIZE - pos->offset;
+    if (chunk > dst_len) {
+      chunk = dst_len;
+    }
+    is_end = ((pos->offset + chunk) == RING_LOG_SECTOR_SIZE) ||
+      (chunk >= _FRAME_LEN(RING_LOG_RECORD_LEN_MAX));
+
+    if (chunk > 0) {
+      r = f->read(f->ctx, _pos_addr(log, pos), dst, chunk);
+    }
+
+    // Strip the framing, records move towards the start of dst.
+    for (in = 0; r && (*total < max); in += _FRAME_LEN(n)) {
+      n = _frame_check(&dst[in], chunk - in);
+      if (0 == n) {
+        break;
+      }
+      dst[*len] = (uint8_t) n;
+      memmove(&dst[*len + 1], &dst[in + _FRAME_HDR_LEN], n);
+      *len += 1 + n;
+      (*total)++;
+    }
+
+    if (r && (0 == *total)) {
+      if (is_end && (0 == hops++) && (pos->sector != log->hdr.head.sector)) {
+        // No more records in this sector, they continue in the next.
+        _pos_next_sector(log, pos);
+      }
+      else {
+        r = false;
+      }
+    }
+    else if (r) {
+      pos->offset += in;
+    }
+  }
+
+  return r;
+}
+
+bool
+ring_log_read_at(struct ring_log * log, struct ring_log_pos * pos,
+  void * record, uint32_t * len)
+{
+  uint8_t buf[_FRAME_LEN(RING_LOG_RECORD_LEN_MAX)];
+  bool r = true;
+
+  *len = 0;
+
+  if (!_pos_is_before_head(log, pos)) {
+    r = false;
+  }
+
+  if (r) {
+    r = _frame_get(log, pos, buf, len);
+  }
+
+  // Records of the head sector end with the head, anything after it is an
+  // interrupted append.
+  if (r && (0 == *len) && (pos->sector != log->hdr.head.sector)) {
+    _pos_next_sector(log, pos);
+    r = _frame_get(log, pos, buf, len);
+  }
+
+  if (r && (0 == *len)) {
+    r = false;
+  }
+
+  if (r) {
+    memcpy(record, &buf[_FRAME_HDR_LEN], *len);
+    pos->offset += _FRAME_LEN(*len);
+  }
+
+  return r;
+}
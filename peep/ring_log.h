@@ -0,0 +1,197 @@
+#ifndef _RING_LOG_H
+#define _RING_LOG_H
+
+/***** Includes *****/
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/***** Defines *****/
+
+// Erase granularity of the SPI flash.
+#define RING_LOG_SECTOR_SIZE (4096)
+// Sectors at the start of the partition that hold copies of the log header.
+// They are used ping-pong style so one always holds a valid copy.
+#define RING_LOG_META_SECTORS (2)
+// Smallest number of data sectors the log can operate with.
+#define RING_LOG_DATA_SECTORS_MIN (3)
+// Largest record the log accepts.
+#define RING_LOG_RECORD_LEN_MAX (64)
+// Flash used per record on top of the record itself: length and sequence
+// number bytes in front, CRC16 behind.
+#define RING_LOG_FRAME_OVERHEAD (4)
+// RAM collecting appended records between ring_log_append_begin() and
+// ring_log_append_end().
+#define RING_LOG_PENDING_LEN (256)
+// Header words left to the owner of the log. Keeps the header at 64 bytes,
+// which divides the sector size so no copy straddles two meta sectors.
+#define RING_LOG_USER_LEN (8)
+
+/***** Structs *****/
+
+/*
+ * Flash access callbacks. Addresses are byte offsets from the start of the
+ * region the log owns. Writes may only clear bits, so a location has to be
+ * erased (set to 0xFF) before it can be written again.
+ */
+struct ring_log_flash {
+  bool (*read)(void * ctx, uint32_t addr, void * dst, uint32_t len);
+  bool (*write)(void * ctx, uint32_t addr, const void * src, uint32_t len);
+  // addr and len are multiples of RING_LOG_SECTOR_SIZE
+  bool (*erase)(void * ctx, uint32_t addr, uint32_t len);
+  void * ctx;
+  uint32_t size;
+};
+
+// Location in the data area. Records never span two sectors.
+struct ring_log_pos {
+  uint16_t sector;
+  uint16_t offset;
+};
+
+/*
+ * Persistent log state. A new copy is appended to the meta sectors each time
+ * it changes; the copy with the highest generation and a good CRC wins. The
+ * head is only committed when it moves into a new sector, records appended
+ * after that are found again by scanning the head sector on mount. Scanning
+ * stops at the first record that is torn, fails its CRC or is out of
+ * sequence, so an interrupted append is simply not there after a reset.
+ */
+struct ring_log_header {
+  uint32_t magic;
+  uint32_t generation;
+  struct ring_log_pos head;
+  struct ring_log_pos tail;
+  uint32_t count;
+  uint32_t version;
+  // sequence number of the record appended next
+  uint32_t seq;
+  uint32_t user[RING_LOG_USER_LEN];
+  uint32_t crc;
+};
+
+struct ring_log {
+  struct ring_log_flash flash;
+  struct ring_log_header hdr;
+  uint32_t sectors;
+  uint32_t meta_addr;
+  struct ring_log_pos read;
+  // appended records not programmed yet, they end at the head
+  uint8_t pending[RING_LOG_PENDING_LEN];
+  uint32_t pending_len;
+  uint32_t pending_count;
+  bool is_pending;
+};
+
+/***** Global Functions *****/
+
+extern bool
+ring_log_init(struct ring_log * log, const struct ring_log_flash * flash);
+
+// Load the newest header and locate the head. Fails if there is no valid
+// header or it was written by an incompatible version of the log. Takes at
+// most one sector worth of reads past the meta sectors, however full the log
+// is.
+extern bool
+ring_log_mount(struct ring_log * log);
+
+extern bool
+ring_log_format(struct ring_log * log);
+
+// Append one record of 1 to RING_LOG_RECORD_LEN_MAX bytes. When the log is
+// full the oldest sector worth of records is dropped to make room.
+extern bool
+ring_log_append(struct ring_log * log, const void * record, uint32_t len);
+
+// Collect the records of the following appends in RAM and program them with
+// as few flash writes as possible, at the latest by ring_log_append_end().
+// Only appends are allowed until then.
+extern void
+ring_log_append_begin(struct ring_log * log);
+
+// Program whatever is left from the appends since ring_log_append_begin().
+// On failure those records are gone from the log.
+extern bool
+ring_log_append_end(struct ring_log * log);
+
+// True if a record of len bytes appended now would be the first one in its
+// sector. Lets delta encoded records start over at every sector.
+extern bool
+ring_log_is_sector_start(struct ring_log * log, uint32_t len);
+
+extern uint32_t
+ring_log_count(struct ring_log * log);
+
+// Bytes of records the log is guaranteed to retain.
+extern uint32_t
+ring_log_capacity(struct ring_log * log);
+
+// Bytes of flash taken up from the tail to the head, to compare against
+// ring_log_capacity().
+extern uint32_t
+ring_log_used(struct ring_log * log);
+
+extern struct ring_log_pos
+ring_log_head(struct ring_log * log);
+
+extern struct ring_log_pos
+ring_log_tail(struct ring_log * log);
+
+extern bool
+ring_log_clear(struct ring_log * log);
+
+// Drop the total oldest records and commit the new tail. Records the read
+// cursor has already passed are dropped without disturbing it, so a reader
+// can acknowledge what it consumed while it keeps going.
+extern bool
+ring_log_discard(struct ring_log * log, uint32_t total);
+
+// Copy the RING_LOG_USER_LEN words kept with the header into user. They are
+// zero after a format.
+extern void
+ring_log_user_get(struct ring_log * log, uint32_t * user);
+
+// Keep the RING_LOG_USER_LEN words of user with the header, committing it
+// unless they are unchanged. Survive clearing the log.
+extern bool
+ring_log_user_set(struct ring_log * log, const uint32_t * user);
+
+// Position the read cursor on the oldest record.
+extern void
+ring_log_read_rewind(struct ring_log * log);
+
+// Read the next record into record, which must hold RING_LOG_RECORD_LEN_MAX
+// bytes.
+extern bool
+ring_log_read_next(struct ring_log * log, void * record, uint32_t * len);
+
+// Position the read cursor on the record at pos, which has to be one of the
+// records in the log or the head.
+extern void
+ring_log_read_seek(struct ring_log * log, struct ring_log_pos pos);
+
+// Number of sectors holding records, from the one of the tail to the one of
+// the head.
+extern uint32_t
+ring_log_sectors_used(struct ring_log * log);
+
+// Start of the n-th sector in use counting from the one of the tail. Records
+// at the start of the tail sector may already be discarded.
+extern struct ring_log_pos
+ring_log_sector_pos(struct ring_log * log, uint32_t n);
+
+// Read as many records following the read cursor as fit in dst, up to max,
+// with a single flash access. Stops early at the end of a sector. Records are
+// returned back to back, each as a length byte followed by that many bytes of
+// record. Fails if no records are left or dst cannot hold the next one.
+extern bool
+ring_log_read_frames(struct ring_log * log, uint8_t * dst, uint32_t dst_len,
+  uint32_t max, uint32_t * len, uint32_t * total);
+
+// Read the record at pos and move pos past it, independent of the read
+// cursor. Fails once pos reaches the head.
+extern bool
+ring_log_read_at(struct ring_log * log, struct ring_log_pos * pos,
+  void * record, uint32_t * len);
+
+#endif
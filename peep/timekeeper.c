@@ -0,0 +1,103 @@
+/***** Includes *****/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "timekeeper.h"
+
+/***** Defines *****/
+
+#define _MAGIC (0x454d4954) // "TIME"
+
+/***** Local Functions *****/
+
+// How well the drift is known, in ppm.
+static double
+_drift_error_ppm(const struct timekeeper * tk)
+{
+  double ppm = TIMEKEEPER_DRIFT_UNKNOWN_PPM;
+
+  // With weights in s^2, the sync error in us over their root is in ppm.
+  if (tk->weight > 0) {
+    ppm = (TIMEKEEPER_SYNC_ERROR_MS * 1000.0) / sqrt(tk->weight);
+    ppm = (ppm < TIMEKEEPER_DRIFT_UNKNOWN_PPM) ? ppm :
+      TIMEKEEPER_DRIFT_UNKNOWN_PPM;
+  }
+
+  return ppm + TIMEKEEPER_DRIFT_WANDER_PPM;
+}
+
+/***** Global Functions *****/
+
+void
+timekeeper_init(struct timekeeper * tk)
+{
+  if ((_MAGIC != tk->magic) || !isfinite(tk->drift_ppm) ||
+      !isfinite(tk->weight) || (tk->weight < 0) ||
+      (fabs(tk->drift_ppm) > TIMEKEEPER_DRIFT_UNKNOWN_PPM)) {
+    memset(tk, 0, sizeof(*tk));
+    tk->magic = _MAGIC;
+  }
+}
+
+bool
+timekeeper_is_set(const struct timekeeper * tk)
+{
+  return (0 < tk->syncs) ? true : false;
+}
+
+int64_t
+timekeeper_now_us(const struct timekeeper * tk, int64_t clock_us)
+{
+  int64_t elapsed_us = clock_us - tk->synced_us;
+
+  if (!timekeeper_is_set(tk)) {
+    return clock_us;
+  }
+
+  return clock_us - (int64_t) (elapsed_us * tk->drift_ppm / 1e6);
+}
+
+uint32_t
+timekeeper_error_ms(const struct timekeeper * tk, int64_t clock_us)
+{
+  double elapsed_sec = fabs((clock_us - tk->synced_us) / 1e6);
+  double ms = 0;
+
+  if (!timekeeper_is_set(tk)) {
+    return UINT32_MAX;
+  }
+
+  ms = TIMEKEEPER_SYNC_ERROR_MS + (_drift_error_ppm(tk) * elapsed_sec / 1e3);
+
+  return (ms < UINT32_MAX) ? (uint32_t) ms : UINT32_MAX;
+}
+
+void
+timekeeper_sync(struct timekeeper * tk, int64_t clock_us, int64_t ref_us)
+{
+  double elapsed_sec = (clock_us - tk->synced_us) / 1e6;
+  double drift_ppm = 0;
+  double weight = 0;
+
+  // The clock ran on its own since the last sync, so the error it built up
+  // over that time is its drift. Spans much shorter than the sync error
+  // would only add noise.
+  if (timekeeper_is_set(tk) &&
+      (elapsed_sec > (10 * TIMEKEEPER_SYNC_ERROR_MS / 1e3))) {
+    drift_ppm = (clock_us - ref_us) / elapsed_sec;
+
+    if (fabs(drift_ppm) <= TIMEKEEPER_DRIFT_UNKNOWN_PPM) {
+      weight = elapsed_sec * elapsed_sec;
+      tk->weight = (llabs(timekeeper_now_us(tk, clock_us) - ref_us) <=
+        (timekeeper_error_ms(tk, clock_us) * 1000LL)) ? (tk->weight / 2) : 0;
+      tk->drift_ppm = ((tk->drift_ppm * tk->weight) + (drift_ppm * weight)) /
+        (tk->weight + weight);
+      tk->weight += weight;
+    }
+  }
+
+  tk->synced_us = ref_us;
+  tk->syncs++;
+}
@@ -0,0 +1,65 @@
+#ifndef _TIMEKEEPER_H
+#define _TIMEKEEPER_H
+
+/***** Includes *****/
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/***** Defines *****/
+
+// Error of a time sync itself, SNTP over a WiFi hop.
+#define TIMEKEEPER_SYNC_ERROR_MS (100)
+// Rate error assumed for the RTC slow clock before any drift is measured.
+#define TIMEKEEPER_DRIFT_UNKNOWN_PPM (5000)
+// Drift wanders with temperature, it is never known better than this.
+#define TIMEKEEPER_DRIFT_WANDER_PPM (50)
+
+/***** Structs *****/
+
+/*
+ * UTC kept by the system clock across deep sleep, corrected for the drift of
+ * the RTC slow clock it runs on in between. The drift is estimated from
+ * successive syncs, weighing each by the square of the time it spans so long
+ * spans count most, and halving the weight of older ones so it follows
+ * temperature. A sync off by more than the predicted error bound means the
+ * drift changed, and the older syncs are dropped. Meant to live in RTC
+ * memory, which holds garbage after a power on; timekeeper_init() detects that
+ * and starts over.
+ *
+ * Times are in microseconds since the Unix epoch. The clock is the system
+ * clock, which is set to the reference time at every sync.
+ */
+struct timekeeper {
+  uint32_t magic;
+  uint32_t syncs;
+  int64_t synced_us;
+  double drift_ppm;
+  double weight;
+};
+
+/***** Global Functions *****/
+
+// Keep the state if tk holds a valid one, otherwise forget all syncs.
+extern void
+timekeeper_init(struct timekeeper * tk);
+
+// Synced at least once since power on.
+extern bool
+timekeeper_is_set(const struct timekeeper * tk);
+
+// UTC at clock_us with the drift since the last sync taken out.
+extern int64_t
+timekeeper_now_us(const struct timekeeper * tk, int64_t clock_us);
+
+// Bound on the error of timekeeper_now_us() at clock_us, UINT32_MAX when not
+// set.
+extern uint32_t
+timekeeper_error_ms(const struct timekeeper * tk, int64_t clock_us);
+
+// The clock read clock_us when the reference time was ref_us. The caller sets
+// the clock to the reference time right after.
+extern void
+timekeeper_sync(struct timekeeper * tk, int64_t clock_us, int64_t ref_us);
+
+#endif
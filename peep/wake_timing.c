@@ -0,0 +1,207 @@
+/***** Includes *****/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "wake_timing.h"
+
+/***** Defines *****/
+
+#define _MAGIC (0x454b4157) // "WAKE"
+
+/***** Structs *****/
+
+struct _wake {
+  uint16_t ms[WAKE_PHASE_TOTAL];
+};
+
+struct _ring {
+  uint32_t magic;
+  uint32_t first;
+  uint32_t total;
+  struct _wake wakes[WAKE_TIMING_LEN];
+};
+
+/***** Local Data *****/
+
+static RTC_DATA_ATTR struct _ring _ring;
+static struct _wake _wake;
+static int64_t _start_us[WAKE_PHASE_TOTAL];
+
+static const char * _names[WAKE_PHASE_TOTAL] = {
+  "boot",
+  "memoryInit",
+  "halInit",
+  "sensorRead",
+  "wifiConnect",
+  "timeSync",
+  "mqttConnect",
+  "tlsHandshake",
+  "shadowGet",
+  "publish",
+  "backlog",
+  "awake",
+};
+
+/***** Local Functions *****/
+
+static void
+_add_ms(enum wake_phase phase, int64_t us)
+{
+  uint32_t ms = (us > 0) ? ((us + 500) / 1000) : 0;
+
+  if (WAKE_TIMING_NONE != _wake.ms[phase]) {
+    ms += _wake.ms[phase];
+  }
+
+  _wake.ms[phase] = (ms < WAKE_TIMING_NONE) ? ms : (WAKE_TIMING_NONE - 1);
+}
+
+static void
+_sort(uint32_t * values, uint32_t total)
+{
+  uint32_t value = 0;
+  uint32_t i = 0;
+  uint32_t j = 0;
+
+  for (i = 1; i < total; i++) {
+    value = values[i];
+    for (j = i; (j > 0) && (values[j - 1] > value); j--) {
+      values[j] = values[j - 1];
+    }
+    values[j] = value;
+  }
+}
+
+/***** Global Functions *****/
+
+void
+wake_timing_init(void)
+{
+  uint32_t n = 0;
+
+  if ((_MAGIC != _ring.magic) || (_ring.first >= WAKE_TIMING_LEN) ||
+      (_ring.total > WAKE_TIMING_LEN)) {
+    wake_timing_clear();
+  }
+
+  for (n = 0; n < WAKE_PHASE_TOTAL; n++) {
+    _wake.ms[n] = WAKE_TIMING_NONE;
+    _start_us[n] = 0;
+  }
+
+  _add_ms(WAKE_PHASE_BOOT, esp_timer_get_time());
+}
+
+void
+wake_timing_begin(enum wake_phase phase)
+{
+  _start_us[phase] = esp_timer_get_time();
+}
+
+void
+wake_timing_end(enum wake_phase phase)
+{
+  _add_ms(phase, esp_timer_get_time() - _start_us[phase]);
+}
+
+void
+wake_timing_commit(void)
+{
+  uint32_t slot = 0;
+
+  _add_ms(WAKE_PHASE_AWAKE, esp_timer_get_time());
+
+  slot = (_ring.first + _ring.total) % WAKE_TIMING_LEN;
+  _ring.wakes[slot] = _wake;
+  if (_ring.total < WAKE_TIMING_LEN) {
+    _ring.total++;
+  }
+  else {
+    _ring.first = (_ring.first + 1) % WAKE_TIMING_LEN;
+  }
+}
+
+uint32_t
+wake_timing_total(void)
+{
+  return _ring.total;
+}
+
+bool
+wake_timing_stats(enum wake_phase phase, struct wake_timing_stats * stats)
+{
+  uint32_t values[WAKE_TIMING_LEN];
+  uint32_t count = 0;
+  uint32_t ms = 0;
+  uint32_t n = 0;
+
+  for (n = 0; n < _ring.total; n++) {
+    ms = _ring.wakes[(_ring.first + n) % WAKE_TIMING_LEN].ms[phase];
+    if (WAKE_TIMING_NONE != ms) {
+      values[count++] = ms;
+    }
+  }
+
+  memset(stats, 0, sizeof(*stats));
+  if (count) {
+    _sort(values, count);
+    stats->count = count;
+    stats->min = values[0];
+    stats->p50 = values[count / 2];
+    stats->p90 = values[(count * 9) / 10];
+    stats->max = values[count - 1];
+  }
+
+  return (count) ? true : false;
+}
+
+bool
+wake_timing_format_json(char * buf, uint32_t buf_len, const char * peep_uuid)
+{
+  struct wake_timing_stats stats;
+  uint32_t len = 0;
+  int32_t bytes = 0;
+  uint32_t n = 0;
+  bool r = true;
+
+  bytes = snprintf(buf, buf_len, "{\"peepUUID\":\"%s\",\"wakes\":%u,"
+    "\"phases\":{", peep_uuid, (unsigned) _ring.total);
+  r = ((bytes > 0) && (bytes < buf_len)) ? true : false;
+  len = (r) ? bytes : 0;
+
+  for (n = 0; r && (n < WAKE_PHASE_TOTAL); n++) {
+    if (!wake_timing_stats(n, &stats)) {
+      continue;
+    }
+
+    bytes = snprintf(&buf[len], buf_len - len,
+      "%s\"%s\":{\"n\":%u,\"min\":%u,\"p50\":%u,\"p90\":%u,\"max\":%u}",
+      ('{' == buf[len - 1]) ? "" : ",", _names[n], (unsigned) stats.count,
+      (unsigned) stats.min, (unsigned) stats.p50, (unsigned) stats.p90,
+      (unsigned) stats.max);
+    r = ((bytes > 0) && (bytes < (buf_len - len))) ? true : false;
+    len += (r) ? bytes : 0;
+  }
+
+  if (r) {
+    r = ((len + 2) < buf_len) ? true : false;
+  }
+
+  if (r) {
+    buf[len++] = '}';
+    buf[len++] = '}';
+    buf[len] = 0;
+  }
+
+  return r;
+}
+
+void
+wake_timing_clear(void)
+{
+  memset(&_ring, 0, sizeof(_ring));
+  _ring.magic = _MAGIC;
+}
@@ -0,0 +1,88 @@
+#ifndef _WAKE_TIMING_H
+#define _WAKE_TIMING_H
+
+/***** Includes *****/
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/***** Defines *****/
+
+// Wakes kept in RTC memory until they are published.
+#define WAKE_TIMING_LEN (32)
+// Phase that did not run on a wake.
+#define WAKE_TIMING_NONE (UINT16_MAX)
+
+/***** Enums *****/
+
+/* The JSON names in wake_timing.c follow this order. */
+enum wake_phase {
+  WAKE_PHASE_BOOT = 0,        // reset until app_main()
+  WAKE_PHASE_MEMORY_INIT,
+  WAKE_PHASE_HAL_INIT,
+  WAKE_PHASE_SENSOR_READ,
+  WAKE_PHASE_WIFI_CONNECT,
+  WAKE_PHASE_TIME_SYNC,
+  WAKE_PHASE_MQTT_CONNECT,    // includes the TLS handshake
+  WAKE_PHASE_TLS_HANDSHAKE,
+  WAKE_PHASE_SHADOW_GET,
+  WAKE_PHASE_PUBLISH,
+  WAKE_PHASE_BACKLOG,
+  WAKE_PHASE_AWAKE,           // reset until deep sleep
+  WAKE_PHASE_TOTAL,
+};
+
+/***** Structs *****/
+
+// Over the wakes a phase ran on, in milliseconds.
+struct wake_timing_stats {
+  uint32_t count;
+  uint32_t min;
+  uint32_t p50;
+  uint32_t p90;
+  uint32_t max;
+};
+
+/***** Global Functions *****/
+
+/*
+ * Phase durations of the wakes since the last publish, kept in RTC memory so
+ * they survive deep sleep. Time comes from esp_timer, which starts at the
+ * application start, so the boot phase leaves out the ROM and second stage
+ * bootloaders.
+ *
+ * wake_timing_init() starts the record of this wake and is meant to be called
+ * first thing in app_main(). wake_timing_commit() ends it and adds it to the
+ * ring, so the published statistics cover earlier wakes.
+ */
+
+extern void
+wake_timing_init(void);
+
+// Phases may run more than once per wake, their times add up.
+extern void
+wake_timing_begin(enum wake_phase phase);
+
+extern void
+wake_timing_end(enum wake_phase phase);
+
+extern void
+wake_timing_commit(void);
+
+// Committed wakes in the ring, the oldest are overwritten once it is full.
+extern uint32_t
+wake_timing_total(void);
+
+// Fails if the phase did not run on any committed wake.
+extern bool
+wake_timing_stats(enum wake_phase phase, struct wake_timing_stats * stats);
+
+// Summary of the committed wakes as a JSON telemetry message.
+extern bool
+wake_timing_format_json(char * buf, uint32_t buf_len, const char * peep_uuid);
+
+// Forget the committed wakes, once they are published.
+extern void
+wake_timing_clear(void);
+
+#endif
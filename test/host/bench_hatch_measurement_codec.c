@@ -0,0 +1,115 @@
+/***** Includes *****/
+
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "hatch_measurement_codec.h"
+#include "ring_log.h"
+
+/***** Defines *****/
+
+#define _RECORDS (100000)
+// Records per key record, roughly one per sector at the coded size.
+#define _KEY_INTERVAL (400)
+// Same size as the "measure" partition.
+#define _FLASH_SIZE (1024 * 1024)
+
+/***** Local Data *****/
+
+static uint8_t _buf[_RECORDS][HATCH_MEASUREMENT_CODEC_LEN_MAX];
+static uint8_t _len[_RECORDS];
+
+/***** Local Functions *****/
+
+static double
+_now_us(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (ts.tv_sec * 1e6) + (ts.tv_nsec / 1e3);
+}
+
+// Incubator readings: slow drift with a little sensor noise.
+static struct hatch_measurement
+_make(uint32_t n)
+{
+  struct hatch_measurement meas;
+  float noise = ((n * 2654435761u) >> 24) / 256.0f - 0.5f;
+
+  meas.unix_timestamp = 1546300800 + (n * 900) + (n % 3);
+  meas.temperature = 37.5f + sinf(n * 0.01f) * 0.8f + noise * 0.05f;
+  meas.humidity = 55.0f + cosf(n * 0.013f) * 6.0f + noise * 0.3f;
+  meas.air_pressure = 101325.0f + sinf(n * 0.002f) * 900.0f + noise * 8.0f;
+  meas.gas_resistance = 120000.0f + sinf(n * 0.05f) * 40000.0f + noise * 500.0f;
+
+  return meas;
+}
+
+/***** Global Functions *****/
+
+int
+main(void)
+{
+  struct hatch_measurement_codec codec;
+  struct hatch_measurement meas;
+  uint32_t sector_records = 0;
+  uint32_t sector_bytes = 0;
+  uint64_t total = 0;
+  double start = 0;
+  double encode_us = 0;
+  double decode_us = 0;
+  double per_record = 0;
+  uint32_t raw_records = 0;
+  uint32_t n = 0;
+
+  hatch_measurement_codec_reset(&codec);
+  start = _now_us();
+  for (n = 0; n < _RECORDS; n++) {
+    meas = _make(n);
+    _len[n] = hatch_measurement_encode(&codec, &meas, _buf[n],
+      (0 == (n % _KEY_INTERVAL)));
+    total += _len[n];
+  }
+  encode_us = _now_us() - start;
+
+  hatch_measurement_codec_reset(&codec);
+  start = _now_us();
+  for (n = 0; n < _RECORDS; n++) {
+    if (!hatch_measurement_decode(&codec, _buf[n], _len[n], &meas)) {
+      printf("decode %u failed\n", n);
+      return 1;
+    }
+  }
+  decode_us = _now_us() - start;
+
+  // The ring log frames every record and never splits one across sectors.
+  per_record = (double) total / _RECORDS + RING_LOG_FRAME_OVERHEAD;
+  for (n = 0; n < _RECORDS; n++) {
+    if ((sector_bytes + _len[n] + RING_LOG_FRAME_OVERHEAD) >
+        RING_LOG_SECTOR_SIZE) {
+      break;
+    }
+    sector_bytes += _len[n] + RING_LOG_FRAME_OVERHEAD;
+    sector_records++;
+  }
+  raw_records = RING_LOG_SECTOR_SIZE /
+    (sizeof(struct hatch_measurement) + RING_LOG_FRAME_OVERHEAD);
+
+  printf("hatch_measurement_codec: %u records\n", _RECORDS);
+  printf("  size:   %.2f bytes/record coded, %u bytes/record raw\n",
+    (double) total / _RECORDS,
+    (unsigned) sizeof(struct hatch_measurement));
+  printf("  encode: %.3f us/record\n", encode_us / _RECORDS);
+  printf("  decode: %.3f us/record\n", decode_us / _RECORDS);
+  printf("  sector: %u records coded, %u records raw\n",
+    sector_records, raw_records);
+  printf("  1 MB:   %u records coded, %u records raw\n",
+    (uint32_t) ((_FLASH_SIZE - (RING_LOG_META_SECTORS + 1) * RING_LOG_SECTOR_SIZE)
+      / per_record),
+    (_FLASH_SIZE / RING_LOG_SECTOR_SIZE - RING_LOG_META_SECTORS - 1) * raw_records);
+
+  return 0;
+}
@@ -0,0 +1,234 @@
+/***** Includes *****/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "hatch_measurement_json.h"
+
+/***** Defines *****/
+
+#define _RECORDS (200000)
+#define _ROUNDS (50)
+// Payload room aws_mqtt_publish_begin() leaves in a 1024 byte MQTT TX buffer
+// for the batch topic.
+#define _BATCH_LEN (1024 - (1 + 2 + 2 + strlen("hatchtrack/data/batch/put")))
+// Stack below the caller painted before each measured call.
+#define _PAINT_LEN (16 * 1024)
+#define _PAINT (0xa5)
+#define _PEEP_UUID "0e4c4f26-1cae-4d3f-8e44-5a4c6d14e1a9"
+#define _HATCH_UUID "5f1b2a9e-7c3d-4e8f-9a0b-1c2d3e4f5a6b"
+
+/***** Structs *****/
+
+struct _path {
+  const char * name;
+  bool (*format)(char * buf, uint32_t buf_len,
+    const struct hatch_measurement * meas, const char * peep_uuid,
+    const char * hatch_uuid);
+  bool (*format_batch)(char * buf, uint32_t buf_len,
+    const struct hatch_measurement * meas, uint32_t total,
+    const char * peep_uuid, const char * hatch_uuid, uint32_t * count);
+};
+
+/***** Local Data *****/
+
+static struct hatch_measurement _meas[_ROUNDS];
+static char _buf[1024];
+static uintptr_t _painted = 0;
+static const struct _path * _path = NULL;
+static uint32_t _count = 0;
+
+/***** Local Functions *****/
+
+static double
+_now_us(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (ts.tv_sec * 1e6) + (ts.tv_nsec / 1e3);
+}
+
+// The formatter before the fixed point one, kept to compare against.
+static bool
+_snprintf_format(char * buf, uint32_t buf_len,
+  const struct hatch_measurement * meas, const char * peep_uuid,
+  const char * hatch_uuid)
+{
+  int32_t bytes = 0;
+
+  bytes = snprintf(
+    buf,
+    buf_len,
+    "{\n"
+    "\"unixTime\": %d,\n"
+    "\"peepUUID\": \"%s\",\n"
+    "\"hatchUUID\": \"%s\",\n"
+    "\"temperature\": %f,\n"
+    "\"humidity\": %f,\n"
+    "\"pressure\": %f,\n"
+    "\"gasResistance\": %f\n"
+    "}",
+    meas->unix_timestamp,
+    peep_uuid,
+    hatch_uuid,
+    meas->temperature,
+    meas->humidity,
+    meas->air_pressure,
+    meas->gas_resistance);
+
+  return ((bytes > 0) && (bytes < buf_len)) ? true : false;
+}
+
+static bool
+_snprintf_format_batch(char * buf, uint32_t buf_len,
+  const struct hatch_measurement * meas, uint32_t total,
+  const char * peep_uuid, const char * hatch_uuid, uint32_t * count)
+{
+  const uint32_t tail = 2;
+  int32_t bytes = 0;
+  uint32_t len = 0;
+  uint32_t i = 0;
+
+  *count = 0;
+
+  bytes = snprintf(buf, buf_len - tail,
+    "{\"peepUUID\":\"%s\",\"hatchUUID\":\"%s\",\"measurements\":[",
+    peep_uuid, hatch_uuid);
+  len = ((bytes > 0) && (bytes < (buf_len - tail))) ? bytes : 0;
+
+  for (i = 0; (len > 0) && (i < total); i++) {
+    bytes = snprintf(&buf[len], buf_len - tail - len,
+      "%s{\"unixTime\":%d,\"temperature\":%f,\"humidity\":%f,"
+      "\"pressure\":%f,\"gasResistance\":%f}",
+      (i > 0) ? "," : "",
+      meas[i].unix_timestamp,
+      meas[i].temperature,
+      meas[i].humidity,
+      meas[i].air_pressure,
+      meas[i].gas_resistance);
+    if ((bytes <= 0) || (bytes >= (buf_len - tail - len))) {
+      break;
+    }
+    len += bytes;
+    *count = i + 1;
+  }
+
+  if (*count > 0) {
+    buf[len++] = ']';
+    buf[len++] = '}';
+    buf[len] = 0;
+  }
+
+  return (*count > 0) ? true : false;
+}
+
+static const struct _path _paths[] = {
+  {"snprintf:", _snprintf_format, _snprintf_format_batch},
+  {"fixed:", hatch_measurement_json_format,
+    hatch_measurement_json_format_batch},
+};
+
+static void __attribute__((noinline))
+_paint(void)
+{
+  uint8_t area[_PAINT_LEN];
+
+  memset(area, _PAINT, sizeof(area));
+  _painted = (uintptr_t) area;
+  __asm__ volatile("" : : "r"(area) : "memory");
+}
+
+// Bytes of the painted area that were written since _paint(), counted from
+// the far end as the stack grows down.
+static uint32_t __attribute__((noinline))
+_unpainted(void)
+{
+  const volatile uint8_t * area = (const volatile uint8_t *) _painted;
+  uint32_t n = 0;
+
+  while ((n < _PAINT_LEN) && (_PAINT == area[n])) {
+    n++;
+  }
+
+  return _PAINT_LEN - n;
+}
+
+static bool __attribute__((noinline))
+_format(void)
+{
+  return _path->format(_buf, sizeof(_buf), &_meas[0], _PEEP_UUID, _HATCH_UUID);
+}
+
+static bool __attribute__((noinline))
+_format_batch(void)
+{
+  return _path->format_batch(_buf, _BATCH_LEN, _meas, _ROUNDS, _PEEP_UUID,
+    _HATCH_UUID, &_count);
+}
+
+// Called from the same frame as _paint() so both start at the same depth.
+static uint32_t __attribute__((noinline))
+_stack_use(bool (*format)(void))
+{
+  _paint();
+  format();
+
+  return _unpainted();
+}
+
+/***** Global Functions *****/
+
+int
+main(void)
+{
+  uint32_t records = 0;
+  uint32_t bytes = 0;
+  uint32_t n = 0;
+  double start = 0;
+  double us = 0;
+  uint32_t p = 0;
+  bool r = true;
+
+  for (n = 0; n < _ROUNDS; n++) {
+    _meas[n].unix_timestamp = 1546300800 + (n * 900);
+    _meas[n].temperature = 37.5f + (n % 50) * 0.01f;
+    _meas[n].humidity = 55.0f - (n % 30) * 0.02f;
+    _meas[n].air_pressure = 101325.0f + (n % 20);
+    _meas[n].gas_resistance = 120000.0f + (n % 40) * 100.0f;
+  }
+
+  printf("hatch_measurement_json: %d records, %u byte batches\n", _RECORDS,
+    (unsigned) _BATCH_LEN);
+  for (p = 0; r && (p < (sizeof(_paths) / sizeof(_paths[0]))); p++) {
+    _path = &_paths[p];
+
+    start = _now_us();
+    for (n = 0; r && (n < _RECORDS); n++) {
+      _meas[0].unix_timestamp++;
+      r = _format();
+    }
+    us = _now_us() - start;
+    printf("  %-9s single %.0f records/s, %u bytes, %u bytes of stack\n",
+      _path->name, _RECORDS / (us / 1e6), (unsigned) strlen(_buf),
+      _stack_use(_format));
+
+    records = 0;
+    bytes = 0;
+    start = _now_us();
+    while (r && (records < _RECORDS)) {
+      r = _format_batch();
+      records += _count;
+      bytes += strlen(_buf);
+    }
+    us = _now_us() - start;
+    printf("  %-9s batch  %.0f records/s, %u records, %.1f bytes/record, "
+      "%u bytes of stack\n",
+      _path->name, records / (us / 1e6), _count, (double) bytes / records,
+      _stack_use(_format_batch));
+  }
+
+  return r ? 0 : 1;
+}
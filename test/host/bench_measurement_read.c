@@ -0,0 +1,139 @@
+/***** Includes *****/
+
+#include <stdio.h>
+#include <time.h>
+
+#include "flash_file.h"
+#include "hatch_measurement_codec.h"
+#include "ring_log.h"
+
+/***** Defines *****/
+
+#define _FILE "build/bench_measurement_read.bin"
+// Same size as the "measure" partition.
+#define _FLASH_SIZE (1024 * 1024)
+#define _RECORDS (20000)
+// Matches the batch buffer and upload batch of the firmware.
+#define _BATCH_BUF_LEN (512)
+#define _BATCH_LEN (16)
+
+/***** Local Data *****/
+
+static struct flash_file _ff;
+static struct ring_log _log;
+
+/***** Local Functions *****/
+
+static double
+_now_us(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (ts.tv_sec * 1e6) + (ts.tv_nsec / 1e3);
+}
+
+static void
+_report(const char * name, uint32_t total, double us)
+{
+  printf("  %-7s %u records, %.0f records/s, %u read ops, %u bytes read\n",
+    name, total, (total * 1e6) / us, _ff.read_ops, _ff.read_bytes);
+}
+
+static uint32_t
+_read_single(void)
+{
+  struct hatch_measurement_codec codec;
+  struct hatch_measurement meas;
+  uint8_t buf[RING_LOG_RECORD_LEN_MAX];
+  uint32_t total = 0;
+  uint32_t len = 0;
+
+  hatch_measurement_codec_reset(&codec);
+  ring_log_read_rewind(&_log);
+  while (ring_log_read_next(&_log, buf, &len)) {
+    if (hatch_measurement_decode(&codec, buf, len, &meas)) {
+      total++;
+    }
+  }
+
+  return total;
+}
+
+static uint32_t
+_read_batch(void)
+{
+  struct hatch_measurement_codec codec;
+  struct hatch_measurement meas[_BATCH_LEN];
+  uint8_t buf[_BATCH_BUF_LEN];
+  uint32_t total = 0;
+  uint32_t len = 0;
+  uint32_t n = 0;
+  uint32_t i = 0;
+  uint32_t k = 0;
+
+  hatch_measurement_codec_reset(&codec);
+  ring_log_read_rewind(&_log);
+  while (ring_log_read_frames(&_log, buf, sizeof(buf), _BATCH_LEN, &len, &n)) {
+    for (i = 0, k = 0; i < len; i += buf[i] + 1, k++) {
+      if (hatch_measurement_decode(&codec, &buf[i + 1], buf[i], &meas[k])) {
+        total++;
+      }
+    }
+  }
+
+  return total;
+}
+
+/***** Global Functions *****/
+
+int
+main(void)
+{
+  struct hatch_measurement_codec codec;
+  struct hatch_measurement meas = {0};
+  struct ring_log_flash flash;
+  uint8_t buf[HATCH_MEASUREMENT_CODEC_LEN_MAX];
+  uint32_t total = 0;
+  uint32_t len = 0;
+  double start = 0;
+  uint32_t n = 0;
+
+  remove(_FILE);
+  if (!flash_file_open(&_ff, _FILE, _FLASH_SIZE)) {
+    printf("failed to open %s\n", _FILE);
+    return 1;
+  }
+  flash_file_get(&_ff, &flash);
+  ring_log_init(&_log, &flash);
+  ring_log_format(&_log);
+
+  hatch_measurement_codec_reset(&codec);
+  for (n = 0; n < _RECORDS; n++) {
+    meas.unix_timestamp = 1546300800 + (n * 900);
+    meas.temperature = 37.5f + (n % 50) * 0.01f;
+    meas.humidity = 55.0f - (n % 30) * 0.02f;
+    meas.air_pressure = 101325.0f + (n % 20);
+    meas.gas_resistance = 120000.0f + (n % 40) * 100.0f;
+    len = hatch_measurement_encode(&codec, &meas, buf,
+      ring_log_is_sector_start(&_log, HATCH_MEASUREMENT_CODEC_LEN_MAX));
+    ring_log_append(&_log, buf, len);
+  }
+
+  printf("measurement read: %u records\n", _RECORDS);
+
+  flash_file_reset_stats(&_ff);
+  start = _now_us();
+  total = _read_single();
+  _report("single:", total, _now_us() - start);
+
+  flash_file_reset_stats(&_ff);
+  start = _now_us();
+  total = _read_batch();
+  _report("batch:", total, _now_us() - start);
+
+  flash_file_close(&_ff);
+
+  return 0;
+}
@@ -0,0 +1,236 @@
+/***** Includes *****/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "esp_spiffs.h"
+#include "hatch_config.h"
+#include "memory.h"
+#include "state.h"
+#include "wifi.h"
+
+/***** Defines *****/
+
+#define _DIR "build/bench_memory.spiffs"
+#define _WAKES (1000)
+#define _SETS (1000)
+#define _LEGACY_FILE "/p/settings"
+
+/***** Local Functions *****/
+
+static double
+_now_us(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (ts.tv_sec * 1e6) + (ts.tv_nsec / 1e3);
+}
+
+// The settings traffic of one wake in the measure state: mount at boot, the
+// state, the WiFi credentials, then the hatch configuration saved after the
+// shadow update.
+static bool
+_wake(struct hatch_configuration * config)
+{
+  enum peep_state state = PEEP_STATE_UNKNOWN;
+  char ssid[WIFI_SSID_LEN_MAX];
+  char pass[WIFI_PASSWORD_LEN_MAX];
+  static uint32_t wakes = 0;
+  bool r = true;
+
+  // Power cycled now and then, the rest are timer wakes from deep sleep.
+  if (0 == (wakes++ % 100)) {
+    memory_deinit();
+  }
+  else {
+    esp_vfs_spiffs_unregister(NULL);
+  }
+  r = memory_init();
+  r = r && peep_get_state(&state);
+  r = r && (memory_get_item(MEMORY_ITEM_WIFI_SSID, (uint8_t *) ssid,
+    sizeof(ssid)) > 0);
+  r = r && (memory_get_item(MEMORY_ITEM_WIFI_PASS, (uint8_t *) pass,
+    sizeof(pass)) > 0);
+  r = r && (sizeof(*config) == memory_set_item(MEMORY_ITEM_HATCH_CONFIG,
+    (uint8_t *) config, sizeof(*config)));
+
+  return r;
+}
+
+// Rewrite one settings file in place, the way memory_set_item() used to.
+static bool
+_truncating_write(const uint8_t * src, uint32_t len)
+{
+  FILE * fp = fopen(_LEGACY_FILE, "w");
+  bool r = (NULL != fp);
+
+  if (r) {
+    r = (len == fwrite(src, 1, len, fp));
+  }
+  if (fp) {
+    fclose(fp);
+  }
+
+  return r;
+}
+
+static bool
+_is_legacy_intact(const uint8_t * src, uint32_t len)
+{
+  uint8_t buf[512];
+  FILE * fp = fopen(_LEGACY_FILE, "r");
+  uint32_t total = 0;
+
+  if (fp) {
+    total = fread(buf, 1, sizeof(buf), fp);
+    fclose(fp);
+  }
+
+  return ((total == len) && (0 == memcmp(buf, src, len))) ? true : false;
+}
+
+static bool
+_set_pass(uint32_t n)
+{
+  const char * pass = (n & 1) ? "palmerho" : "ohremlap";
+
+  return (9 == memory_set_item(MEMORY_ITEM_WIFI_PASS, (uint8_t *) pass, 9));
+}
+
+static bool
+_is_pass_intact(void)
+{
+  char pass[WIFI_PASSWORD_LEN_MAX] = {0};
+
+  memory_deinit();
+  memory_init();
+
+  return (9 == memory_get_item(MEMORY_ITEM_WIFI_PASS, (uint8_t *) pass,
+      sizeof(pass))) &&
+    ((0 == strcmp(pass, "palmerho")) || (0 == strcmp(pass, "ohremlap")));
+}
+
+// Cost of a settings write and how often a power cut during it loses the
+// settings, for the old truncating write and for memory_set_item().
+static bool
+_bench_sets(void)
+{
+  struct esp_spiffs_host_stats * stats = esp_spiffs_host_stats();
+  uint8_t blob[512];
+  uint32_t lost = 0;
+  uint32_t len = 0;
+  uint32_t cut = 0;
+  uint32_t pages = 0;
+  uint32_t n = 0;
+  double start = 0;
+  double us = 0;
+  FILE * fp = NULL;
+  bool r = true;
+
+  // Same bytes as a settings file written by memory_set_item().
+  r = _set_pass(0);
+  fp = fopen("/p/settings0", "r");
+  if (r && fp) {
+    len = fread(blob, 1, sizeof(blob), fp);
+  }
+  if (fp) {
+    fclose(fp);
+  }
+  r = r && (len > 0);
+
+  printf("memory_set_item: %d sets of a %d byte settings file\n", _SETS, len);
+
+  esp_spiffs_host_reset_stats();
+  start = _now_us();
+  for (n = 0; r && (n < _SETS); n++) {
+    r = _truncating_write(blob, len);
+  }
+  us = _now_us() - start;
+  pages = stats->page_writes;
+  for (cut = 0; r && (cut < len); cut++) {
+    esp_spiffs_host_set_write_budget(cut);
+    _truncating_write(blob, len);
+    esp_spiffs_host_set_write_budget(UINT32_MAX);
+    lost += _is_legacy_intact(blob, len) ? 0 : 1;
+    r = _truncating_write(blob, len);
+  }
+  printf("  truncate:   %.2f us/set, %.1f SPIFFS pages written/set, "
+    "lost by %d of %d power cuts\n",
+    us / _SETS, (double) pages / _SETS, lost, len);
+  remove(_LEGACY_FILE);
+
+  lost = 0;
+  esp_spiffs_host_reset_stats();
+  start = _now_us();
+  for (n = 0; r && (n < _SETS); n++) {
+    r = _set_pass(n);
+  }
+  us = _now_us() - start;
+  pages = stats->page_writes;
+  for (cut = 0; r && (cut < len); cut++) {
+    esp_spiffs_host_set_write_budget(cut);
+    _set_pass(cut + 1);
+    esp_spiffs_host_set_write_budget(UINT32_MAX);
+    lost += _is_pass_intact() ? 0 : 1;
+  }
+  printf("  two copies: %.2f us/set, %.1f SPIFFS pages written/set, "
+    "lost by %d of %d power cuts\n",
+    us / _SETS, (double) pages / _SETS, lost, len);
+
+  return r;
+}
+
+/***** Global Functions *****/
+
+int
+main(void)
+{
+  struct hatch_configuration config = {
+    .uuid = "0e4c4f26-1cae-4d3f-8e44-5a4c6d14e1a9",
+    .end_unix_timestamp = 1735084800,
+    .measure_interval_sec = 900,
+  };
+  struct esp_spiffs_host_stats * stats = esp_spiffs_host_stats();
+  double start = 0;
+  double us = 0;
+  uint32_t n = 0;
+  bool r = true;
+
+  mkdir(_DIR, 0755);
+  esp_spiffs_host_dir(_DIR);
+  esp_spiffs_host_format();
+  r = memory_init() && peep_set_state(PEEP_STATE_MEASURE);
+  r = r && (memory_set_item(MEMORY_ITEM_WIFI_SSID, (uint8_t *) "thesignal",
+    10) > 0);
+  r = r && (memory_set_item(MEMORY_ITEM_WIFI_PASS, (uint8_t *) "palmerho",
+    9) > 0);
+  if (!r) {
+    printf("failed to set up %s\n", _DIR);
+    return 1;
+  }
+
+  esp_spiffs_host_reset_stats();
+  start = _now_us();
+  for (n = 0; r && (n < _WAKES); n++) {
+    r = _wake(&config);
+  }
+  us = _now_us() - start;
+
+  printf("memory: %d wakes in the measure state\n", _WAKES);
+  printf("  time:  %.2f us/wake\n", us / _WAKES);
+  printf("  mount: %.2f mounts/wake\n", (double) stats->mounts / _WAKES);
+  printf("  files: %.1f opens/wake, %.1f reads/wake, %.1f writes/wake\n",
+    (double) stats->opens / _WAKES, (double) stats->read_ops / _WAKES,
+    (double) stats->write_ops / _WAKES);
+  printf("  flash: %.0f bytes written/wake, %.1f SPIFFS pages written/wake\n",
+    (double) stats->write_bytes / _WAKES,
+    (double) stats->page_writes / _WAKES);
+
+  r = r && _bench_sets();
+
+  return r ? 0 : 1;
+}
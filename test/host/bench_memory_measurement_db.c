@@ -0,0 +1,119 @@
+/***** Includes *****/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "esp_partition.h"
+#include "memory_measurement_db.h"
+
+/***** Defines *****/
+
+#define _LABEL "measure"
+#define _FILE "build/bench_memory_measurement_db.bin"
+// Same size as the "measure" partition.
+#define _FLASH_SIZE (1024 * 1024)
+#define _RECORDS (50000)
+#define _SEEKS (200)
+#define _START (1546300800)
+#define _INTERVAL (900)
+
+/***** Local Functions *****/
+
+static double
+_now_us(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (ts.tv_sec * 1e6) + (ts.tv_nsec / 1e3);
+}
+
+// Find the measurement by reading from the start, the only way before.
+static bool
+_scan_time(uint32_t unix_timestamp)
+{
+  struct hatch_measurement meas;
+  bool r = true;
+
+  memory_measurement_db_read_close();
+  r = memory_measurement_db_read_open();
+  while (r) {
+    r = memory_measurement_db_read_entry(&meas);
+    if (r && (meas.unix_timestamp >= unix_timestamp)) {
+      break;
+    }
+  }
+
+  return r;
+}
+
+static void
+_report(const char * name, struct flash_file * ff, double us)
+{
+  printf("  %-5s %.1f us/seek, %.1f read ops/seek, %.0f bytes read/seek\n",
+    name, us / _SEEKS, (double) ff->read_ops / _SEEKS,
+    (double) ff->read_bytes / _SEEKS);
+}
+
+/***** Global Functions *****/
+
+int
+main(void)
+{
+  struct hatch_measurement meas = {0};
+  struct flash_file * ff = NULL;
+  uint32_t target = 0;
+  double start = 0;
+  uint32_t n = 0;
+
+  remove(_FILE);
+  if (!esp_partition_host_add(_LABEL, _FILE, _FLASH_SIZE) ||
+      !memory_measurement_db_init()) {
+    printf("failed to set up %s\n", _FILE);
+    return 1;
+  }
+  ff = esp_partition_host_flash(_LABEL);
+
+  for (n = 0; n < _RECORDS; n++) {
+    meas.unix_timestamp = _START + (n * _INTERVAL);
+    meas.temperature = 37.5f + (n % 50) * 0.01f;
+    meas.humidity = 55.0f - (n % 30) * 0.02f;
+    meas.air_pressure = 101325.0f + (n % 20);
+    meas.gas_resistance = 120000.0f + (n % 40) * 100.0f;
+    memory_measurement_db_add(&meas);
+  }
+  memory_measurement_db_read_open();
+
+  printf("memory_measurement_db: %u records, %u seeks to random times\n",
+    memory_measurement_db_total(), _SEEKS);
+
+  srand(1);
+  flash_file_reset_stats(ff);
+  start = _now_us();
+  for (n = 0; n < _SEEKS; n++) {
+    target = _START + (rand() % _RECORDS) * _INTERVAL;
+    memory_measurement_db_seek_time(target);
+    memory_measurement_db_read_entry(&meas);
+    if (meas.unix_timestamp != target) {
+      printf("seek to %u found %u\n", target, meas.unix_timestamp);
+      return 1;
+    }
+  }
+  _report("seek:", ff, _now_us() - start);
+
+  srand(1);
+  flash_file_reset_stats(ff);
+  start = _now_us();
+  for (n = 0; n < _SEEKS; n++) {
+    target = _START + (rand() % _RECORDS) * _INTERVAL;
+    _scan_time(target);
+  }
+  _report("scan:", ff, _now_us() - start);
+
+  memory_measurement_db_read_close();
+  esp_partition_host_remove_all();
+
+  return 0;
+}
@@ -0,0 +1,123 @@
+/***** Includes *****/
+
+#include <stdio.h>
+
+#include "flash_file.h"
+#include "hatch_measurement_codec.h"
+#include "memory_measurement_stage.h"
+#include "ring_log.h"
+
+/***** Defines *****/
+
+#define _FILE "build/bench_memory_measurement_stage.bin"
+// Same size as the "measure" partition.
+#define _FLASH_SIZE (1024 * 1024)
+// Two weeks of offline wakes, one every 15 minutes.
+#define _WAKES (14 * 24 * 4)
+
+/***** Local Data *****/
+
+static struct flash_file _ff;
+static struct ring_log _log;
+static struct hatch_measurement_codec _codec;
+
+/***** Local Functions *****/
+
+static struct hatch_measurement
+_make(uint32_t n)
+{
+  struct hatch_measurement meas;
+
+  meas.unix_timestamp = 1546300800 + (n * 900);
+  meas.temperature = 37.5f + (n % 50) * 0.01f;
+  meas.humidity = 55.0f - (n % 30) * 0.02f;
+  meas.air_pressure = 101325.0f + (n % 20);
+  meas.gas_resistance = 120000.0f + (n % 40) * 100.0f;
+
+  return meas;
+}
+
+static void
+_append(const struct hatch_measurement * meas)
+{
+  struct hatch_measurement_codec codec = _codec;
+  uint8_t buf[HATCH_MEASUREMENT_CODEC_LEN_MAX];
+  uint32_t len = 0;
+
+  len = hatch_measurement_encode(&codec, meas, buf, false);
+  if (ring_log_is_sector_start(&_log, len)) {
+    len = hatch_measurement_encode(&codec, meas, buf, true);
+  }
+  if (ring_log_append(&_log, buf, len)) {
+    _codec = codec;
+  }
+}
+
+static void
+_setup(void)
+{
+  struct ring_log_flash flash;
+
+  flash_file_get(&_ff, &flash);
+  ring_log_init(&_log, &flash);
+  ring_log_format(&_log);
+  hatch_measurement_codec_reset(&_codec);
+  flash_file_reset_stats(&_ff);
+}
+
+static void
+_report(const char * name)
+{
+  printf("  %-7s %u write ops, %u bytes written, %u erases, "
+    "%.3f write ops/sample\n",
+    name, _ff.write_ops, _ff.write_bytes, _ff.erase_ops,
+    (double) _ff.write_ops / _WAKES);
+}
+
+/***** Global Functions *****/
+
+int
+main(void)
+{
+  struct memory_measurement_stage stage;
+  struct hatch_measurement meas;
+  uint32_t total = 0;
+  uint32_t n = 0;
+  uint32_t k = 0;
+
+  remove(_FILE);
+  if (!flash_file_open(&_ff, _FILE, _FLASH_SIZE)) {
+    printf("failed to open %s\n", _FILE);
+    return 1;
+  }
+
+  printf("memory_measurement_stage: %u offline samples\n", _WAKES);
+
+  _setup();
+  for (n = 0; n < _WAKES; n++) {
+    meas = _make(n);
+    _append(&meas);
+  }
+  _report("direct:");
+
+  _setup();
+  memory_measurement_stage_init(&stage);
+  for (n = 0; n < _WAKES; n++) {
+    meas = _make(n);
+    memory_measurement_stage_add(&stage, &meas);
+    if (memory_measurement_stage_is_full(&stage)) {
+      total = memory_measurement_stage_total(&stage);
+      ring_log_append_begin(&_log);
+      for (k = 0; k < total; k++) {
+        _append(memory_measurement_stage_get(&stage, k));
+      }
+      ring_log_append_end(&_log);
+      memory_measurement_stage_clear(&stage);
+    }
+  }
+  _report("staged:");
+
+  flash_file_close(&_ff);
+
+  return 0;
+}
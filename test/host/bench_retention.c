@@ -0,0 +1,114 @@
+/***** Includes *****/
+
+#include <math.h>
+#include <stdio.h>
+
+#include "esp_partition.h"
+#include "memory_measurement_db.h"
+
+/***** Defines *****/
+
+#define _LABEL "measure"
+#define _FILE "build/bench_retention.bin"
+#define _DAYS (21)
+#define _START (1546300800)
+
+/***** Local Functions *****/
+
+// Incubator readings over the course of a hatch, with a daily cycle.
+static struct hatch_measurement
+_make(uint32_t sec)
+{
+  struct hatch_measurement meas;
+  float day = sec / 86400.0f;
+
+  meas.unix_timestamp = _START + sec;
+  meas.temperature = 37.6f + 0.3f * sinf(day * 6.283f);
+  meas.humidity = (day < 18.0f) ? 50.0f : 68.0f;
+  meas.humidity += 2.0f * cosf(day * 6.283f);
+  meas.air_pressure = 101325.0f + 600.0f * sinf(day * 0.9f);
+  meas.gas_resistance = 150000.0f - 2000.0f * day;
+
+  return meas;
+}
+
+static void
+_simulate(uint32_t size, uint32_t interval)
+{
+  struct hatch_measurement_rollup rollup[16];
+  struct hatch_measurement meas;
+  struct flash_file * ff = NULL;
+  uint32_t samples = _DAYS * 86400 / interval;
+  uint32_t rollups = 0;
+  uint32_t rolled = 0;
+  uint32_t first = 0;
+  uint32_t total = 0;
+  uint32_t ops = 0;
+  uint32_t ops_max = 0;
+  uint32_t n = 0;
+
+  remove(_FILE);
+  esp_partition_host_add(_LABEL, _FILE, size);
+  memory_measurement_db_init();
+  memory_measurement_db_delete_all();
+  ff = esp_partition_host_flash(_LABEL);
+  flash_file_reset_stats(ff);
+
+  // One wake per sample, none of them online.
+  for (n = 0; n < samples; n++) {
+    ops = ff->read_ops + ff->write_ops + ff->erase_ops;
+    meas = _make(n * interval);
+    memory_measurement_db_add(&meas);
+    ops = ff->read_ops + ff->write_ops + ff->erase_ops - ops;
+    ops_max = (ops > ops_max) ? ops : ops_max;
+  }
+
+  printf("  %u KB partition, sample every %u s, %u samples\n",
+    size / 1024, interval, samples);
+  printf("    flash: %u reads, %u writes, %u erases, at most %u ops per wake\n",
+    ff->read_ops, ff->write_ops, ff->erase_ops, ops_max);
+
+  rollups = memory_measurement_db_rollup_total();
+  if (memory_measurement_db_rollup_read(rollup, 1, &total)) {
+    first = rollup[0].unix_timestamp;
+  }
+  while (memory_measurement_db_rollup_read(rollup, 16, &total)) {
+    for (n = 0; n < total; n++) {
+      rolled += rollup[n].samples;
+    }
+    memory_measurement_db_rollup_delete_oldest(total);
+  }
+
+  memory_measurement_db_read_open();
+  memory_measurement_db_read_entry(&meas);
+  memory_measurement_db_read_close();
+  if (0 == rollups) {
+    first = meas.unix_timestamp;
+  }
+
+  printf("    raw: %u samples kept, from day %.2f\n",
+    memory_measurement_db_total(),
+    (meas.unix_timestamp - _START) / 86400.0f);
+  printf("    rollups: %u hours holding %u samples, from day %.2f\n",
+    rollups, rolled, (first - _START) / 86400.0f);
+  printf("    lost: %u samples\n",
+    samples - rolled - memory_measurement_db_total());
+
+  esp_partition_host_remove_all();
+}
+
+/***** Global Functions *****/
+
+int
+main(void)
+{
+  printf("retention: %u days offline\n", _DAYS);
+
+  // The "measure" partition at the default measure interval, and a smaller
+  // one sampled more often to make the rollups kick in.
+  _simulate(1024 * 1024, 5 * 60);
+  _simulate(256 * 1024, 60);
+  _simulate(128 * 1024, 60);
+
+  return 0;
+}
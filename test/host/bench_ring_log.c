@@ -0,0 +1,93 @@
+/***** Includes *****/
+
+#include <stdio.h>
+#include <time.h>
+
+#include "flash_file.h"
+#include "hatch_measurement.h"
+#include "ring_log.h"
+
+/***** Defines *****/
+
+#define _FILE "build/bench_ring_log.bin"
+// Same size as the "measure" partition.
+#define _FLASH_SIZE (1024 * 1024)
+#define _RECORDS (100000)
+
+/***** Local Functions *****/
+
+static double
+_now_us(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (ts.tv_sec * 1e6) + (ts.tv_nsec / 1e3);
+}
+
+/***** Global Functions *****/
+
+int
+main(void)
+{
+  struct hatch_measurement meas = {0};
+  struct ring_log_flash flash;
+  struct flash_file ff;
+  struct ring_log log;
+  volatile uint32_t count = 0;
+  double start = 0;
+  double append_us = 0;
+  double count_us = 0;
+  double mount_us = 0;
+  uint32_t n = 0;
+
+  remove(_FILE);
+  if (!flash_file_open(&ff, _FILE, _FLASH_SIZE)) {
+    printf("failed to open %s\n", _FILE);
+    return 1;
+  }
+  flash_file_get(&ff, &flash);
+  ring_log_init(&log, &flash);
+  ring_log_format(&log);
+  flash_file_reset_stats(&ff);
+
+  start = _now_us();
+  for (n = 0; n < _RECORDS; n++) {
+    meas.unix_timestamp = 1546300800 + (n * 900);
+    if (!ring_log_append(&log, &meas, sizeof(meas))) {
+      printf("append %u failed\n", n);
+      return 1;
+    }
+  }
+  append_us = _now_us() - start;
+
+  start = _now_us();
+  for (n = 0; n < _RECORDS; n++) {
+    count = ring_log_count(&log);
+  }
+  count_us = _now_us() - start;
+
+  printf("ring_log: %u raw records appended, %u retained, capacity %u bytes\n",
+    _RECORDS, count, ring_log_capacity(&log));
+  printf("  append: %.3f us/record\n", append_us / _RECORDS);
+  printf("  count:  %.4f us/call\n", count_us / _RECORDS);
+  printf("  flash:  %.2f bytes written/record, %.2f write ops/record\n",
+    (double) ff.write_bytes / _RECORDS,
+    (double) ff.write_ops / _RECORDS);
+  printf("  erase:  %u sectors total, %.2f per 1000 records\n",
+    ff.erase_ops,
+    (ff.erase_ops * 1000.0) / _RECORDS);
+
+  flash_file_reset_stats(&ff);
+  start = _now_us();
+  ring_log_init(&log, &flash);
+  ring_log_mount(&log);
+  mount_us = _now_us() - start;
+  printf("  mount:  %.1f us, %u read ops, %u bytes read\n",
+    mount_us, ff.read_ops, ff.read_bytes);
+
+  flash_file_close(&ff);
+
+  return 0;
+}
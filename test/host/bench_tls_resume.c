@@ -0,0 +1,467 @@
+/***** Includes *****/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include <openssl/err.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+#include "aws_mqtt_tls.h"
+
+/***** Defines *****/
+
+// Wakes per scenario, each a cold connect as after deep sleep.
+#define _WAKES (20)
+#define _PEM_LEN (4096)
+#define _CLIENT_ID "0e4c4f26-1cae-4d3f-8e44-5a4c6d14e1a9"
+// The broker certificate is issued for this name, which the device checks.
+#define _BROKER_HOST "localhost"
+#define _TIMEOUT_MS (5000)
+
+/***** Typedefs *****/
+
+typedef bool
+(*_read_fn)(void * ctx, uint8_t * buf, uint32_t len);
+
+/***** Structs *****/
+
+// Local stand-in for the AWS IoT broker: TLS 1.2 with client certificates,
+// answers an MQTT CONNECT with a CONNACK and waits for the DISCONNECT. It
+// resumes sessions by id from its cache. Its tickets would carry the device
+// certificate and not fit the ticket buffer of aws_mqtt_tls.c, unlike the
+// ones of AWS IoT, so it issues none.
+struct _broker {
+  SSL_CTX * ctx;
+  int fd;
+  uint16_t port;
+  uint32_t wakes;
+  uint32_t handshakes;
+  uint32_t resumed;
+  pthread_t thread;
+};
+
+struct _pem {
+  char cert[_PEM_LEN];
+  char key[_PEM_LEN];
+};
+
+struct _result {
+  uint32_t full;
+  uint32_t resumed;
+  double full_ms;
+  double resumed_ms;
+};
+
+/***** Local Data *****/
+
+static struct _pem _broker_pem;
+static struct _pem _device_pem;
+
+/***** Local Functions *****/
+
+static double
+_now_us(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (ts.tv_sec * 1e6) + (ts.tv_nsec / 1e3);
+}
+
+// Self signed RSA 2048 certificate, like the device certificates AWS IoT
+// issues.
+static bool
+_pem_create(struct _pem * pem, const char * cn)
+{
+  EVP_PKEY * key = EVP_RSA_gen(2048);
+  X509 * x509 = X509_new();
+  X509_NAME * name = NULL;
+  BIO * bio = NULL;
+  int len = 0;
+  bool r = (NULL != key) && (NULL != x509);
+
+  if (r) {
+    ASN1_INTEGER_set(X509_get_serialNumber(x509), 1);
+    X509_gmtime_adj(X509_getm_notBefore(x509), 0);
+    X509_gmtime_adj(X509_getm_notAfter(x509), 24 * 3600);
+    X509_set_pubkey(x509, key);
+    name = X509_get_subject_name(x509);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+      (const unsigned char *) cn, -1, -1, 0);
+    X509_set_issuer_name(x509, name);
+    r = (0 < X509_sign(x509, key, EVP_sha256()));
+  }
+
+  if (r) {
+    bio = BIO_new(BIO_s_mem());
+    PEM_write_bio_X509(bio, x509);
+    len = BIO_read(bio, pem->cert, sizeof(pem->cert) - 1);
+    pem->cert[(len > 0) ? len : 0] = 0;
+    PEM_write_bio_PrivateKey(bio, key, NULL, NULL, 0, NULL, NULL);
+    len = BIO_read(bio, pem->key, sizeof(pem->key) - 1);
+    pem->key[(len > 0) ? len : 0] = 0;
+    BIO_free(bio);
+  }
+
+  X509_free(x509);
+  EVP_PKEY_free(key);
+
+  return r;
+}
+
+// Broker credentials, trusting the device certificate.
+static bool
+_ctx_credentials(SSL_CTX * ctx, struct _pem * own, struct _pem * peer)
+{
+  BIO * bio = NULL;
+  X509 * x509 = NULL;
+  EVP_PKEY * key = NULL;
+  bool r = true;
+
+  bio = BIO_new_mem_buf(own->cert, -1);
+  x509 = PEM_read_bio_X509(bio, NULL, NULL, NULL);
+  BIO_free(bio);
+  bio = BIO_new_mem_buf(own->key, -1);
+  key = PEM_read_bio_PrivateKey(bio, NULL, NULL, NULL);
+  BIO_free(bio);
+  r = (1 == SSL_CTX_use_certificate(ctx, x509)) &&
+    (1 == SSL_CTX_use_PrivateKey(ctx, key));
+  X509_free(x509);
+  EVP_PKEY_free(key);
+
+  if (r) {
+    bio = BIO_new_mem_buf(peer->cert, -1);
+    x509 = PEM_read_bio_X509(bio, NULL, NULL, NULL);
+    BIO_free(bio);
+    r = (1 == X509_STORE_add_cert(SSL_CTX_get_cert_store(ctx), x509));
+    X509_free(x509);
+  }
+
+  if (r) {
+    SSL_CTX_set_verify(ctx,
+      SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT, NULL);
+    // mbedTLS 2.x on the device speaks TLS 1.2 at most.
+    SSL_CTX_set_max_proto_version(ctx, TLS1_2_VERSION);
+  }
+
+  return r;
+}
+
+static bool
+_broker_read(void * ctx, uint8_t * buf, uint32_t len)
+{
+  SSL * ssl = ctx;
+  uint32_t n = 0;
+  int ret = 0;
+
+  while (n < len) {
+    ret = SSL_read(ssl, &buf[n], len - n);
+    if (ret <= 0) {
+      break;
+    }
+    n += ret;
+  }
+
+  return (n == len) ? true : false;
+}
+
+// Once connected aws_mqtt_tls.c leaves short read timeouts for the SDK to
+// poll with, reads are retried until _TIMEOUT_MS passed.
+static bool
+_device_read(void * ctx, uint8_t * buf, uint32_t len)
+{
+  mbedtls_ssl_context * ssl = ctx;
+  double start = _now_us();
+  uint32_t n = 0;
+  int ret = 0;
+
+  while ((n < len) && ((_now_us() - start) < (_TIMEOUT_MS * 1e3))) {
+    ret = mbedtls_ssl_read(ssl, &buf[n], len - n);
+    if (ret > 0) {
+      n += ret;
+    }
+    else if ((MBEDTLS_ERR_SSL_TIMEOUT != ret) &&
+             (MBEDTLS_ERR_SSL_WANT_READ != ret) &&
+             (MBEDTLS_ERR_SSL_WANT_WRITE != ret)) {
+      break;
+    }
+  }
+
+  return (n == len) ? true : false;
+}
+
+static bool
+_device_write(mbedtls_ssl_context * ssl, const uint8_t * buf, uint32_t len)
+{
+  uint32_t n = 0;
+  int ret = 0;
+
+  while (n < len) {
+    ret = mbedtls_ssl_write(ssl, &buf[n], len - n);
+    if (ret > 0) {
+      n += ret;
+    }
+    else if ((MBEDTLS_ERR_SSL_WANT_READ != ret) &&
+             (MBEDTLS_ERR_SSL_WANT_WRITE != ret)) {
+      break;
+    }
+  }
+
+  return (n == len) ? true : false;
+}
+
+// Read one MQTT packet, returns its type nibble or 0.
+static uint8_t
+_mqtt_read(_read_fn read, void * ctx, uint8_t * buf, uint32_t buf_len)
+{
+  uint32_t remaining = 0;
+  uint32_t shift = 0;
+  uint8_t type = 0;
+  uint8_t b = 0;
+  bool r = read(ctx, &type, 1);
+
+  do {
+    r = r && read(ctx, &b, 1);
+    remaining |= (b & 0x7f) << shift;
+    shift += 7;
+  } while (r && (b & 0x80) && (shift < 28));
+
+  r = r && (remaining <= buf_len) && read(ctx, buf, remaining);
+
+  return (r) ? (type & 0xf0) : 0;
+}
+
+static void *
+_broker_run(void * arg)
+{
+  const uint8_t connack[] = {0x20, 0x02, 0x00, 0x00};
+  struct _broker * broker = arg;
+  uint8_t buf[256];
+  SSL * ssl = NULL;
+  uint32_t n = 0;
+  int fd = 0;
+
+  for (n = 0; n < broker->wakes; n++) {
+    fd = accept(broker->fd, NULL, NULL);
+    ssl = SSL_new(broker->ctx);
+    SSL_set_fd(ssl, fd);
+
+    if ((1 == SSL_accept(ssl)) &&
+        (0x10 == _mqtt_read(_broker_read, ssl, buf, sizeof(buf)))) {
+      broker->handshakes++;
+      broker->resumed += SSL_session_reused(ssl) ? 1 : 0;
+      SSL_write(ssl, connack, sizeof(connack));
+      _mqtt_read(_broker_read, ssl, buf, sizeof(buf));
+    }
+
+    SSL_shutdown(ssl);
+    SSL_free(ssl);
+    close(fd);
+  }
+
+  return NULL;
+}
+
+// A fresh broker has a new ticket key and an empty session cache, so it
+// knows none of the sessions a device may offer.
+static bool
+_broker_start(struct _broker * broker, uint32_t wakes)
+{
+  struct sockaddr_in addr;
+  socklen_t addr_len = sizeof(addr);
+  bool r = true;
+
+  memset(broker, 0, sizeof(*broker));
+  broker->wakes = wakes;
+  broker->ctx = SSL_CTX_new(TLS_server_method());
+  r = _ctx_credentials(broker->ctx, &_broker_pem, &_device_pem);
+
+  if (r) {
+    SSL_CTX_set_session_id_context(broker->ctx,
+      (const unsigned char *) "broker", 6);
+    SSL_CTX_set_options(broker->ctx, SSL_OP_NO_TICKET);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    broker->fd = socket(AF_INET, SOCK_STREAM, 0);
+    r = (0 == bind(broker->fd, (struct sockaddr *) &addr, sizeof(addr))) &&
+      (0 == listen(broker->fd, 1)) &&
+      (0 == getsockname(broker->fd, (struct sockaddr *) &addr, &addr_len));
+    broker->port = ntohs(addr.sin_port);
+  }
+
+  if (r) {
+    r = (0 == pthread_create(&broker->thread, NULL, _broker_run, broker));
+  }
+
+  return r;
+}
+
+static void
+_broker_stop(struct _broker * broker)
+{
+  pthread_join(broker->thread, NULL);
+  close(broker->fd);
+  SSL_CTX_free(broker->ctx);
+}
+
+// Same as iot_tls_destroy() of the SDK.
+static IoT_Error_t
+_destroy(Network * network)
+{
+  TLSDataParams * tls = &(network->tlsDataParams);
+
+  mbedtls_net_free(&(tls->server_fd));
+  mbedtls_x509_crt_free(&(tls->clicert));
+  mbedtls_x509_crt_free(&(tls->cacert));
+  mbedtls_pk_free(&(tls->pkey));
+  mbedtls_ssl_free(&(tls->ssl));
+  mbedtls_ssl_config_free(&(tls->conf));
+  mbedtls_ctr_drbg_free(&(tls->ctr_drbg));
+  mbedtls_entropy_free(&(tls->entropy));
+
+  return SUCCESS;
+}
+
+// One wake of the device: aws_mqtt_tls_connect() parses the credentials,
+// connects and offers the session it cached on the wake before, then CONNECT
+// until the CONNACK and DISCONNECT. RTC memory is plain memory on the host,
+// so the cached session lasts as long as the process.
+static bool
+_wake(struct _broker * broker, struct _result * result)
+{
+  const uint8_t disconnect[] = {0xe0, 0x00};
+  mbedtls_ssl_context * ssl = NULL;
+  TLSConnectParams params;
+  Network network;
+  uint32_t resumed = broker->resumed;
+  uint8_t buf[256];
+  uint32_t len = 0;
+  double start = _now_us();
+  double ms = 0;
+  bool r = true;
+
+  memset(&network, 0, sizeof(network));
+  memset(&params, 0, sizeof(params));
+  network.destroy = _destroy;
+  params.pRootCALocation = _broker_pem.cert;
+  params.pDeviceCertLocation = _device_pem.cert;
+  params.pDevicePrivateKeyLocation = _device_pem.key;
+  params.pDestinationURL = _BROKER_HOST;
+  params.DestinationPort = broker->port;
+  params.timeout_ms = _TIMEOUT_MS;
+  params.ServerVerificationFlag = true;
+  ssl = &(network.tlsDataParams.ssl);
+
+  r = (SUCCESS == aws_mqtt_tls_connect(&network, &params));
+
+  if (r) {
+    len = 2 + 4 + 1 + 1 + 2 + 2 + strlen(_CLIENT_ID);
+    buf[0] = 0x10;
+    buf[1] = len;
+    memcpy(&buf[2], "\x00\x04MQTT\x04\x02\x00\x0a", 10);
+    buf[12] = 0;
+    buf[13] = strlen(_CLIENT_ID);
+    memcpy(&buf[14], _CLIENT_ID, strlen(_CLIENT_ID));
+    r = _device_write(ssl, buf, 2 + len) &&
+      (0x20 == _mqtt_read(_device_read, ssl, buf, sizeof(buf)));
+  }
+
+  if (r) {
+    ms = (_now_us() - start) / 1e3;
+    if (broker->resumed > resumed) {
+      result->resumed++;
+      result->resumed_ms += ms;
+    }
+    else {
+      result->full++;
+      result->full_ms += ms;
+    }
+
+    _device_write(ssl, disconnect, sizeof(disconnect));
+    mbedtls_ssl_close_notify(ssl);
+  }
+
+  _destroy(&network);
+
+  return r;
+}
+
+// Run _WAKES wakes against a fresh broker and check that expected of them
+// resumed the session.
+static bool
+_scenario(const char * name, bool is_cache, bool is_cache_kept,
+  uint32_t expected)
+{
+  struct _broker broker;
+  struct _result result;
+  uint32_t n = 0;
+  bool r = true;
+
+  memset(&result, 0, sizeof(result));
+  if (!is_cache_kept) {
+    aws_mqtt_tls_forget();
+  }
+
+  r = _broker_start(&broker, _WAKES);
+  for (n = 0; r && (n < _WAKES); n++) {
+    if (!is_cache) {
+      aws_mqtt_tls_forget();
+    }
+    r = _wake(&broker, &result);
+  }
+  if (r) {
+    _broker_stop(&broker);
+  }
+
+  if (r) {
+    printf("  %-9s %u handshakes, %u full %.2f ms, %u resumed %.2f ms, "
+      "%.2f ms/wake\n",
+      name, broker.handshakes, result.full,
+      (result.full) ? result.full_ms / result.full : 0, result.resumed,
+      (result.resumed) ? result.resumed_ms / result.resumed : 0,
+      (result.full_ms + result.resumed_ms) / _WAKES);
+    r = (expected == result.resumed);
+  }
+
+  return r;
+}
+
+/***** Global Functions *****/
+
+int
+main(void)
+{
+  bool r = true;
+
+  r = _pem_create(&_broker_pem, _BROKER_HOST) &&
+    _pem_create(&_device_pem, _CLIENT_ID);
+
+  printf("tls_resume: %d wakes of aws_mqtt_tls_connect(), TLS 1.2 with RSA "
+    "2048 client certificate, connect until CONNACK\n", _WAKES);
+  // No cache, every wake does a full handshake.
+  r = r && _scenario("none:", false, false, 0);
+  // The first wake does a full handshake, the others resume it.
+  r = r && _scenario("cached:", true, false, _WAKES - 1);
+  // The broker lost the session, the first wake offers it and gets a full
+  // handshake instead.
+  r = r && _scenario("rejected:", true, true, _WAKES - 1);
+
+  if (!r) {
+    ERR_print_errors_fp(stderr);
+  }
+
+  return r ? 0 : 1;
+}
@@ -0,0 +1,187 @@
+/***** Includes *****/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "aws_mqtt_window.h"
+#include "hatch_measurement_json.h"
+#include "hatch_measurement_pb.h"
+
+/***** Defines *****/
+
+#define _BACKLOG (2000)
+// Same as CONFIG_AWS_IOT_MQTT_TX_BUF_LEN and task_measure.c.
+#define _TX_BUF_LEN (1024)
+#define _COMMIT_LEN (_TX_BUF_LEN / 16)
+#define _TOPIC_DATA "hatchtrack/data/put"
+#define _TOPIC_DATA_BATCH "hatchtrack/data/batch/put"
+#define _TOPIC_DATA_PB "hatchtrack/data/pb/put"
+// Payload room aws_mqtt_publish_begin() leaves in the TX buffer: the fixed
+// header with a 2 byte remaining length, the topic length and the topic.
+#define _BATCH_LEN (_TX_BUF_LEN - (1 + 2 + 2 + strlen(_TOPIC_DATA_BATCH)))
+// TLS 1.2 record with AES-GCM: 5 byte header, 8 byte nonce, 16 byte tag.
+#define _TLS_RECORD_LEN_MAX (16384)
+#define _TLS_RECORD_OVERHEAD (5 + 8 + 16)
+// TCP/IPv4 headers without options, per segment.
+#define _TCP_MSS (1460)
+#define _TCP_IP_OVERHEAD (40)
+// Link the delivery times are modelled on.
+#define _LINK_BPS (1e6)
+#define _LINK_RTT_SEC (0.15)
+// Same as task_measure.c.
+#define _WINDOW_LEN (16)
+#define _PEEP_UUID "0e4c4f26-1cae-4d3f-8e44-5a4c6d14e1a9"
+#define _HATCH_UUID "5f1b2a9e-7c3d-4e8f-9a0b-1c2d3e4f5a6b"
+
+/***** Structs *****/
+
+struct _uplink {
+  uint32_t messages;
+  uint32_t payload_bytes;
+  uint32_t wire_bytes;
+  uint32_t message_bytes[_BACKLOG];
+};
+
+/***** Local Data *****/
+
+static struct hatch_measurement _backlog[_BACKLOG];
+static char _buf[2048];
+static uint32_t _len = 0;
+
+/***** Local Functions *****/
+
+static double
+_now_us(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (ts.tv_sec * 1e6) + (ts.tv_nsec / 1e3);
+}
+
+// Count a QoS 0 publish of the _len bytes of payload in _buf, with the MQTT,
+// TLS and TCP/IP framing it goes out with.
+static void
+_publish(struct _uplink * up, const char * topic)
+{
+  uint32_t len = _len;
+  uint32_t remaining = 2 + strlen(topic) + len;
+  uint32_t bytes = 0;
+
+  bytes = 1 + ((remaining < 128) ? 1 : (remaining < 16384) ? 2 : 3) +
+    remaining;
+  bytes += ((bytes + _TLS_RECORD_LEN_MAX - 1) / _TLS_RECORD_LEN_MAX) *
+    _TLS_RECORD_OVERHEAD;
+  bytes += ((bytes + _TCP_MSS - 1) / _TCP_MSS) * _TCP_IP_OVERHEAD;
+
+  up->message_bytes[up->messages] = bytes;
+  up->messages++;
+  up->payload_bytes += len;
+  up->wire_bytes += bytes;
+}
+
+static void
+_report(const char * name, struct _uplink * up, double us)
+{
+  printf("  %-7s %u messages, %u payload bytes, %u bytes on the wire, "
+    "%.1f bytes/measurement, %.2f us/measurement\n",
+    name, up->messages, up->payload_bytes, up->wire_bytes,
+    (double) up->wire_bytes / _BACKLOG, us / _BACKLOG);
+}
+
+// Seconds until the last of the messages is delivered when up to window_len
+// of them wait for their PUBACK, each one arriving a round trip after the
+// message went out. A window_len of 0 is QoS 0, nothing waits.
+static double
+_deliver(struct _uplink * up, uint32_t window_len)
+{
+  static double acked_at[_BACKLOG];
+  struct aws_mqtt_window window;
+  uint32_t oldest = 0;
+  uint32_t n = 0;
+  double t = 0;
+
+  aws_mqtt_window_init(&window, window_len);
+  for (n = 0; n < up->messages; n++) {
+    if (window_len && aws_mqtt_window_is_full(&window)) {
+      t = (acked_at[oldest] > t) ? acked_at[oldest] : t;
+      aws_mqtt_window_ack(&window, oldest++);
+    }
+    t += (up->message_bytes[n] * 8) / _LINK_BPS;
+    acked_at[n] = t + _LINK_RTT_SEC;
+    aws_mqtt_window_add(&window, n, 1);
+  }
+
+  if (window_len && up->messages) {
+    t = acked_at[up->messages - 1];
+  }
+
+  return t;
+}
+
+/***** Global Functions *****/
+
+int
+main(void)
+{
+  static struct _uplink single;
+  static struct _uplink batch;
+  static struct _uplink pb;
+  uint32_t count = 0;
+  uint32_t total = 0;
+  uint32_t n = 0;
+  double start = 0;
+  bool r = true;
+
+  for (n = 0; n < _BACKLOG; n++) {
+    _backlog[n].unix_timestamp = 1546300800 + (n * 900);
+    _backlog[n].temperature = 37.5f + (n % 50) * 0.01f;
+    _backlog[n].humidity = 55.0f - (n % 30) * 0.02f;
+    _backlog[n].air_pressure = 101325.0f + (n % 20);
+    _backlog[n].gas_resistance = 120000.0f + (n % 40) * 100.0f;
+  }
+
+  printf("uplink: %d stored measurements, %d byte MQTT TX buffer\n",
+    _BACKLOG, _TX_BUF_LEN);
+
+  start = _now_us();
+  for (n = 0; r && (n < _BACKLOG); n++) {
+    r = hatch_measurement_json_format(_buf, sizeof(_buf), &_backlog[n],
+      _PEEP_UUID, _HATCH_UUID);
+    _len = strlen(_buf);
+    _publish(&single, _TOPIC_DATA);
+  }
+  _report("single:", &single, _now_us() - start);
+
+  // The firmware carries unsent measurements over into its next read, so
+  // each message sees up to a full buffer of them.
+  start = _now_us();
+  for (n = 0; r && (n < _BACKLOG); n += count) {
+    total = ((n + _COMMIT_LEN) < _BACKLOG) ? _COMMIT_LEN : (_BACKLOG - n);
+    r = hatch_measurement_json_format_batch(_buf, _BATCH_LEN, &_backlog[n],
+      total, _PEEP_UUID, _HATCH_UUID, &count);
+    _len = strlen(_buf);
+    _publish(&batch, _TOPIC_DATA_BATCH);
+  }
+  _report("batch:", &batch, _now_us() - start);
+
+  start = _now_us();
+  for (n = 0; r && (n < _BACKLOG); n += count) {
+    total = ((n + _COMMIT_LEN) < _BACKLOG) ? _COMMIT_LEN : (_BACKLOG - n);
+    r = hatch_measurement_pb_encode_batch((uint8_t *) _buf, _BATCH_LEN,
+      &_backlog[n], total, _PEEP_UUID, _HATCH_UUID, &count, &_len);
+    _publish(&pb, _TOPIC_DATA_PB);
+  }
+  _report("pb:", &pb, _now_us() - start);
+
+  printf("  delivery of the batches over %.0f kbit/s with %.0f ms round trip:\n",
+    _LINK_BPS / 1e3, _LINK_RTT_SEC * 1e3);
+  printf("    QoS 0:           %.2f s, unconfirmed\n", _deliver(&batch, 0));
+  printf("    QoS 1, 1 by 1:   %.2f s\n", _deliver(&batch, 1));
+  printf("    QoS 1, window %d: %.2f s\n", _WINDOW_LEN,
+    _deliver(&batch, _WINDOW_LEN));
+
+  return r ? 0 : 1;
+}
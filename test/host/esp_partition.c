@@ -0,0 +1,135 @@
+/***** Includes *****/
+
+#include <string.h>
+
+#include "esp_partition.h"
+
+/***** Defines *****/
+
+#define _PARTITIONS_MAX (4)
+
+/***** Structs *****/
+
+struct _host_partition {
+  esp_partition_t part;
+  struct flash_file ff;
+  struct ring_log_flash flash;
+};
+
+/***** Local Data *****/
+
+static struct _host_partition _table[_PARTITIONS_MAX];
+static uint32_t _total = 0;
+
+/***** Local Functions *****/
+
+static struct _host_partition *
+_find(const char * label)
+{
+  uint32_t n = 0;
+
+  for (n = 0; n < _total; n++) {
+    if ((NULL == label) || (0 == strcmp(label, _table[n].part.label))) {
+      return &_table[n];
+    }
+  }
+
+  return NULL;
+}
+
+static struct _host_partition *
+_get(const esp_partition_t * part)
+{
+  return (struct _host_partition *) part;
+}
+
+/***** Global Functions *****/
+
+const esp_partition_t *
+esp_partition_find_first(esp_partition_type_t type,
+  esp_partition_subtype_t subtype, const char * label)
+{
+  struct _host_partition * p = _find(label);
+
+  if ((NULL == p) || (type != p->part.type) ||
+      ((ESP_PARTITION_SUBTYPE_ANY != subtype) &&
+       (subtype != p->part.subtype))) {
+    return NULL;
+  }
+
+  return &(p->part);
+}
+
+esp_err_t
+esp_partition_read(const esp_partition_t * part, size_t src_offset,
+  void * dst, size_t size)
+{
+  struct _host_partition * p = _get(part);
+
+  return p->flash.read(p->flash.ctx, src_offset, dst, size) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t
+esp_partition_write(const esp_partition_t * part, size_t dst_offset,
+  const void * src, size_t size)
+{
+  struct _host_partition * p = _get(part);
+
+  return p->flash.write(p->flash.ctx, dst_offset, src, size) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t
+esp_partition_erase_range(const esp_partition_t * part, size_t start_addr,
+  size_t size)
+{
+  struct _host_partition * p = _get(part);
+
+  return p->flash.erase(p->flash.ctx, start_addr, size) ? ESP_OK : ESP_FAIL;
+}
+
+bool
+esp_partition_host_add(const char * label, const char * path, uint32_t size)
+{
+  struct _host_partition * p = NULL;
+  bool r = true;
+
+  if (_total >= _PARTITIONS_MAX) {
+    r = false;
+  }
+
+  if (r) {
+    p = &_table[_total];
+    memset(p, 0, sizeof(struct _host_partition));
+    r = flash_file_open(&(p->ff), path, size);
+  }
+
+  if (r) {
+    p->part.type = ESP_PARTITION_TYPE_DATA;
+    p->part.subtype = ESP_PARTITION_SUBTYPE_ANY;
+    p->part.size = size;
+    strncpy(p->part.label, label, sizeof(p->part.label) - 1);
+    flash_file_get(&(p->ff), &(p->flash));
+    _total++;
+  }
+
+  return r;
+}
+
+struct flash_file *
+esp_partition_host_flash(const char * label)
+{
+  struct _host_partition * p = _find(label);
+
+  return (p) ? &(p->ff) : NULL;
+}
+
+void
+esp_partition_host_remove_all(void)
+{
+  uint32_t n = 0;
+
+  for (n = 0; n < _total; n++) {
+    flash_file_close(&(_table[n].ff));
+  }
+  _total = 0;
+}
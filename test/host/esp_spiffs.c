@@ -0,0 +1,294 @@
+/***** Includes *****/
+
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#define _ESP_SPIFFS_HOST_IMPL
+#include "esp_spiffs.h"
+
+/***** Defines *****/
+
+#define _PATH_LEN_MAX (256)
+#define _FILES_MAX (8)
+// Same as the storage partition in partitions.csv.
+#define _SIZE (1024 * 1024)
+// SPIFFS pages are 256 bytes, 5 of them taken by the page header.
+#define _PAGE_DATA_LEN (256 - 5)
+#define _PAGES(bytes) (1 + (((bytes) + _PAGE_DATA_LEN - 1) / _PAGE_DATA_LEN))
+
+/***** Structs *****/
+
+struct _host_file {
+  FILE * fp;
+  uint32_t written;
+  bool is_write;
+};
+
+/***** Local Data *****/
+
+static char _dir[_PATH_LEN_MAX] = ".";
+static char _base[_PATH_LEN_MAX];
+static bool _is_registered = false;
+static uint32_t _files_max = 0;
+static struct _host_file _files[_FILES_MAX];
+static struct esp_spiffs_host_stats _stats;
+static uint32_t _write_budget = UINT32_MAX;
+static bool _is_cut = false;
+
+/***** Local Functions *****/
+
+// Map a path under the base path to one in the host directory.
+static bool
+_host_path(const char * path, char * dst)
+{
+  uint32_t len = strlen(_base);
+  int n = 0;
+
+  if (!_is_registered || (0 != strncmp(path, _base, len)) ||
+      ('/' != path[len])) {
+    return false;
+  }
+
+  n = snprintf(dst, _PATH_LEN_MAX, "%s%s", _dir, &path[len]);
+
+  return ((n > 0) && (n < _PATH_LEN_MAX)) ? true : false;
+}
+
+static uint32_t
+_file_size(const char * host_path)
+{
+  struct stat st;
+
+  return (0 == stat(host_path, &st)) ? st.st_size : 0;
+}
+
+static struct _host_file *
+_find(FILE * fp)
+{
+  uint32_t n = 0;
+
+  for (n = 0; n < _FILES_MAX; n++) {
+    if (fp == _files[n].fp) {
+      return &_files[n];
+    }
+  }
+
+  return NULL;
+}
+
+/***** Global Functions *****/
+
+esp_err_t
+esp_vfs_spiffs_register(const esp_vfs_spiffs_conf_t * conf)
+{
+  if (_is_registered) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  snprintf(_base, sizeof(_base), "%s", conf->base_path);
+  _files_max = (conf->max_files < _FILES_MAX) ? conf->max_files : _FILES_MAX;
+  memset(_files, 0, sizeof(_files));
+  _is_registered = true;
+  _stats.mounts++;
+
+  return ESP_OK;
+}
+
+esp_err_t
+esp_vfs_spiffs_unregister(const char * partition_label)
+{
+  if (!_is_registered) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  _is_registered = false;
+
+  return ESP_OK;
+}
+
+esp_err_t
+esp_spiffs_info(const char * partition_label, size_t * total_bytes,
+  size_t * used_bytes)
+{
+  char path[2 * _PATH_LEN_MAX];
+  struct dirent * entry = NULL;
+  DIR * dir = NULL;
+
+  if (!_is_registered) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  *total_bytes = _SIZE;
+  *used_bytes = 0;
+
+  dir = opendir(_dir);
+  while (dir && (entry = readdir(dir))) {
+    if ('.' != entry->d_name[0]) {
+      snprintf(path, sizeof(path), "%s/%s", _dir, entry->d_name);
+      *used_bytes += _PAGES(_file_size(path)) * 256;
+    }
+  }
+
+  if (dir) {
+    closedir(dir);
+  }
+
+  return ESP_OK;
+}
+
+void
+esp_spiffs_host_dir(const char * dir)
+{
+  snprintf(_dir, sizeof(_dir), "%s", dir);
+}
+
+void
+esp_spiffs_host_set_write_budget(uint32_t bytes)
+{
+  _write_budget = bytes;
+  _is_cut = false;
+}
+
+void
+esp_spiffs_host_format(void)
+{
+  char path[2 * _PATH_LEN_MAX];
+  struct dirent * entry = NULL;
+  DIR * dir = NULL;
+
+  dir = opendir(_dir);
+  while (dir && (entry = readdir(dir))) {
+    if ('.' != entry->d_name[0]) {
+      snprintf(path, sizeof(path), "%s/%s", _dir, entry->d_name);
+      remove(path);
+    }
+  }
+
+  if (dir) {
+    closedir(dir);
+  }
+}
+
+struct esp_spiffs_host_stats *
+esp_spiffs_host_stats(void)
+{
+  return &_stats;
+}
+
+void
+esp_spiffs_host_reset_stats(void)
+{
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+FILE *
+esp_spiffs_host_fopen(const char * path, const char * mode)
+{
+  char host_path[_PATH_LEN_MAX];
+  struct _host_file * f = NULL;
+  uint32_t size = 0;
+  uint32_t n = 0;
+
+  // Only max_files can be open at once, same as the VFS.
+  for (n = 0; (NULL == f) && (n < _files_max); n++) {
+    if (NULL == _files[n].fp) {
+      f = &_files[n];
+    }
+  }
+
+  if (_is_cut || (NULL == f) || !_host_path(path, host_path)) {
+    return NULL;
+  }
+
+  f->is_write = ('r' != mode[0]) || (NULL != strchr(mode, '+'));
+  f->written = 0;
+
+  if ('w' == mode[0]) {
+    size = _file_size(host_path);
+    _stats.page_writes += (size > 0) ? _PAGES(size) : 0;
+  }
+
+  f->fp = fopen(host_path, mode);
+  if (f->fp) {
+    _stats.opens++;
+  }
+
+  return f->fp;
+}
+
+size_t
+esp_spiffs_host_fread(void * dst, size_t size, size_t n, FILE * fp)
+{
+  size_t total = fread(dst, size, n, fp);
+
+  _stats.read_ops++;
+  _stats.read_bytes += total * size;
+
+  return total;
+}
+
+size_t
+esp_spiffs_host_fwrite(const void * src, size_t size, size_t n, FILE * fp)
+{
+  struct _host_file * f = _find(fp);
+  size_t total = 0;
+
+  if (_is_cut) {
+    return 0;
+  }
+
+  if ((size * n) > _write_budget) {
+    n = _write_budget / size;
+    _is_cut = true;
+  }
+  total = fwrite(src, size, n, fp);
+  if (UINT32_MAX != _write_budget) {
+    _write_budget -= total * size;
+  }
+
+  _stats.write_ops++;
+  _stats.write_bytes += total * size;
+  if (f) {
+    f->written += total * size;
+  }
+
+  return total;
+}
+
+int
+esp_spiffs_host_fclose(FILE * fp)
+{
+  struct _host_file * f = _find(fp);
+
+  if (f) {
+    // New data pages, the index page, then the index page again with the
+    // final size.
+    if (f->is_write && (f->written > 0)) {
+      _stats.page_writes += _PAGES(f->written) + 1;
+    }
+    f->fp = NULL;
+  }
+
+  return fclose(fp);
+}
+
+int
+esp_spiffs_host_remove(const char * path)
+{
+  char host_path[_PATH_LEN_MAX];
+  uint32_t size = 0;
+  int r = -1;
+
+  if (!_is_cut && _host_path(path, host_path)) {
+    size = _file_size(host_path);
+    r = remove(host_path);
+  }
+
+  if (0 == r) {
+    _stats.removes++;
+    _stats.page_writes += _PAGES(size);
+  }
+
+  return r;
+}
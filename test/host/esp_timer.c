@@ -0,0 +1,27 @@
+/***** Includes *****/
+
+#include "esp_timer.h"
+
+/***** Local Data *****/
+
+static int64_t _now_us = 0;
+
+/***** Global Functions *****/
+
+int64_t
+esp_timer_get_time(void)
+{
+  return _now_us;
+}
+
+void
+esp_timer_host_set(int64_t us)
+{
+  _now_us = us;
+}
+
+void
+esp_timer_host_advance(int64_t us)
+{
+  _now_us += us;
+}
@@ -0,0 +1,179 @@
+/***** Includes *****/
+
+#include <string.h>
+
+#include "flash_file.h"
+
+/***** Defines *****/
+
+#define _CHUNK_LEN (256)
+
+/***** Local Functions *****/
+
+static bool
+_read(void * ctx, uint32_t addr, void * dst, uint32_t len)
+{
+  struct flash_file * ff = (struct flash_file *) ctx;
+
+  if ((addr + len) > ff->size) {
+    return false;
+  }
+
+  ff->read_ops++;
+  ff->read_bytes += len;
+
+  if (0 != fseek(ff->fp, addr, SEEK_SET)) {
+    return false;
+  }
+
+  return (len == fread(dst, 1, len, ff->fp)) ? true : false;
+}
+
+static bool
+_write(void * ctx, uint32_t addr, const void * src, uint32_t len)
+{
+  struct flash_file * ff = (struct flash_file *) ctx;
+  const uint8_t * p = (const uint8_t *) src;
+  uint8_t buf[_CHUNK_LEN];
+  uint32_t chunk = 0;
+  uint32_t n = 0;
+  bool is_cut = false;
+  bool r = true;
+
+  if ((addr + len) > ff->size) {
+    return false;
+  }
+
+  ff->write_ops++;
+  ff->write_bytes += len;
+
+  if (len > ff->write_budget) {
+    len = ff->write_budget;
+    is_cut = true;
+  }
+  ff->write_budget -= len;
+
+  while (r && len) {
+    chunk = (len < _CHUNK_LEN) ? len : _CHUNK_LEN;
+
+    r = (0 == fseek(ff->fp, addr, SEEK_SET)) ? true : false;
+    if (r) {
+      r = (chunk == fread(buf, 1, chunk, ff->fp)) ? true : false;
+    }
+
+    if (r) {
+      // Programming can only pull bits low.
+      for (n = 0; n < chunk; n++) {
+        buf[n] &= p[n];
+      }
+      r = (0 == fseek(ff->fp, addr, SEEK_SET)) ? true : false;
+    }
+
+    if (r) {
+      r = (chunk == fwrite(buf, 1, chunk, ff->fp)) ? true : false;
+    }
+
+    addr += chunk;
+    p += chunk;
+    len -= chunk;
+  }
+
+  return (r && !is_cut) ? true : false;
+}
+
+static bool
+_erase(void * ctx, uint32_t addr, uint32_t len)
+{
+  struct flash_file * ff = (struct flash_file *) ctx;
+  uint8_t buf[_CHUNK_LEN];
+  uint32_t chunk = 0;
+  bool r = true;
+
+  if (((addr % RING_LOG_SECTOR_SIZE) != 0) ||
+      ((len % RING_LOG_SECTOR_SIZE) != 0) ||
+      ((addr + len) > ff->size) ||
+      (0 == ff->write_budget)) {
+    return false;
+  }
+
+  ff->erase_ops += len / RING_LOG_SECTOR_SIZE;
+
+  memset(buf, 0xFF, sizeof(buf));
+  r = (0 == fseek(ff->fp, addr, SEEK_SET)) ? true : false;
+  while (r && len) {
+    chunk = (len < _CHUNK_LEN) ? len : _CHUNK_LEN;
+    r = (chunk == fwrite(buf, 1, chunk, ff->fp)) ? true : false;
+    len -= chunk;
+  }
+
+  return r;
+}
+
+/***** Global Functions *****/
+
+bool
+flash_file_open(struct flash_file * ff, const char * path, uint32_t size)
+{
+  uint8_t buf[_CHUNK_LEN];
+  long len = 0;
+  bool r = true;
+
+  memset(ff, 0, sizeof(struct flash_file));
+  ff->size = size;
+  ff->write_budget = UINT32_MAX;
+
+  ff->fp = fopen(path, "r+b");
+  if (NULL == ff->fp) {
+    ff->fp = fopen(path, "w+b");
+  }
+
+  if (NULL == ff->fp) {
+    r = false;
+  }
+
+  if (r) {
+    r = (0 == fseek(ff->fp, 0L, SEEK_END)) ? true : false;
+    len = ftell(ff->fp);
+  }
+
+  if (r && (len < size)) {
+    // Anything past the current end of file reads back as erased flash.
+    memset(buf, 0xFF, sizeof(buf));
+    while (r && (len < size)) {
+      uint32_t chunk = ((size - len) < _CHUNK_LEN) ? (size - len) : _CHUNK_LEN;
+      r = (chunk == fwrite(buf, 1, chunk, ff->fp)) ? true : false;
+      len += chunk;
+    }
+  }
+
+  return r;
+}
+
+void
+flash_file_close(struct flash_file * ff)
+{
+  if (ff->fp) {
+    fclose(ff->fp);
+    ff->fp = NULL;
+  }
+}
+
+void
+flash_file_get(struct flash_file * ff, struct ring_log_flash * flash)
+{
+  flash->read = _read;
+  flash->write = _write;
+  flash->erase = _erase;
+  flash->ctx = ff;
+  flash->size = ff->size;
+}
+
+void
+flash_file_reset_stats(struct flash_file * ff)
+{
+  ff->read_ops = 0;
+  ff->read_bytes = 0;
+  ff->write_ops = 0;
+  ff->write_bytes = 0;
+  ff->erase_ops = 0;
+}
@@ -0,0 +1,50 @@
+#ifndef _FLASH_FILE_H
+#define _FLASH_FILE_H
+
+/***** Includes *****/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ring_log.h"
+
+/***** Structs *****/
+
+/*
+ * NOR flash emulated on top of a plain file. Writes can only clear bits and
+ * erase sets whole sectors back to 0xFF, same as the SPI flash on the ESP32.
+ *
+ * write_budget simulates a power cut: it is the number of bytes that can
+ * still be programmed. A write that goes past it programs only the bytes up
+ * to the cut and fails, and every write or erase after that fails without
+ * touching the flash.
+ */
+struct flash_file {
+  FILE * fp;
+  uint32_t size;
+  uint32_t write_budget;
+  uint32_t read_ops;
+  uint32_t read_bytes;
+  uint32_t write_ops;
+  uint32_t write_bytes;
+  uint32_t erase_ops;
+};
+
+/***** Global Functions *****/
+
+// Open the file at path, creating or growing it as erased flash of size bytes.
+extern bool
+flash_file_open(struct flash_file * ff, const char * path, uint32_t size);
+
+extern void
+flash_file_close(struct flash_file * ff);
+
+// Fill in ring_log callbacks that operate on ff.
+extern void
+flash_file_get(struct flash_file * ff, struct ring_log_flash * flash);
+
+extern void
+flash_file_reset_stats(struct flash_file * ff);
+
+#endif
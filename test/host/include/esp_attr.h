@@ -0,0 +1,8 @@
+#ifndef _ESP_ATTR_H
+#define _ESP_ATTR_H
+
+// Plain statics on the host keep their value across re-initialization of a
+// module, same as RTC memory across deep sleep.
+#define RTC_DATA_ATTR
+
+#endif
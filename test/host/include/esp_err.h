@@ -0,0 +1,19 @@
+#ifndef _ESP_ERR_H
+#define _ESP_ERR_H
+
+/***** Includes *****/
+
+#include <stdint.h>
+
+/***** Defines *****/
+
+#define ESP_OK (0)
+#define ESP_FAIL (-1)
+#define ESP_ERR_INVALID_STATE (0x103)
+#define ESP_ERR_NOT_FOUND (0x105)
+
+/***** Typedefs *****/
+
+typedef int32_t esp_err_t;
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef _ESP_PARTITION_H
+#define _ESP_PARTITION_H
+
+/*
+ * Host version of the ESP-IDF partition API. Partitions are emulated NOR
+ * flash files registered with esp_partition_host_add().
+ */
+
+/***** Includes *****/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "flash_file.h"
+
+/***** Enums *****/
+
+typedef enum {
+  ESP_PARTITION_TYPE_APP = 0x00,
+  ESP_PARTITION_TYPE_DATA = 0x01,
+} esp_partition_type_t;
+
+typedef enum {
+  ESP_PARTITION_SUBTYPE_DATA_SPIFFS = 0x82,
+  ESP_PARTITION_SUBTYPE_ANY = 0xff,
+} esp_partition_subtype_t;
+
+/***** Structs *****/
+
+typedef struct {
+  esp_partition_type_t type;
+  esp_partition_subtype_t subtype;
+  uint32_t address;
+  uint32_t size;
+  char label[17];
+  bool encrypted;
+} esp_partition_t;
+
+/***** Global Functions *****/
+
+extern const esp_partition_t *
+esp_partition_find_first(esp_partition_type_t type,
+  esp_partition_subtype_t subtype, const char * label);
+
+extern esp_err_t
+esp_partition_read(const esp_partition_t * part, size_t src_offset,
+  void * dst, size_t size);
+
+extern esp_err_t
+esp_partition_write(const esp_partition_t * part, size_t dst_offset,
+  const void * src, size_t size);
+
+extern esp_err_t
+esp_partition_erase_range(const esp_partition_t * part, size_t start_addr,
+  size_t size);
+
+/***** Host Functions *****/
+
+// Back the data partition label with an emulated flash file at path.
+extern bool
+esp_partition_host_add(const char * label, const char * path, uint32_t size);
+
+// Flash emulation of the partition, for fault injection and statistics.
+extern struct flash_file *
+esp_partition_host_flash(const char * label);
+
+// Close all partitions.
+extern void
+esp_partition_host_remove_all(void);
+
+#endif
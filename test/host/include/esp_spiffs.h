@@ -0,0 +1,105 @@
+#ifndef _ESP_SPIFFS_H
+#define _ESP_SPIFFS_H
+
+/*
+ * Host version of the ESP-IDF SPIFFS API. Files under the registered base
+ * path are kept in a plain directory set with esp_spiffs_host_dir(), and the
+ * stdio calls of any file including this header are routed through the shim
+ * so file traffic can be counted.
+ */
+
+/***** Includes *****/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+
+/***** Structs *****/
+
+typedef struct {
+  const char * base_path;
+  const char * partition_label;
+  size_t max_files;
+  bool format_if_mount_failed;
+} esp_vfs_spiffs_conf_t;
+
+/*
+ * File traffic since the last esp_spiffs_host_reset_stats(). page_writes is
+ * an estimate of the 256 byte SPIFFS pages programmed: every page of a file
+ * written, plus its index page, plus one page header write for each page
+ * made obsolete by truncating or removing a file.
+ */
+struct esp_spiffs_host_stats {
+  uint32_t mounts;
+  uint32_t opens;
+  uint32_t read_ops;
+  uint32_t read_bytes;
+  uint32_t write_ops;
+  uint32_t write_bytes;
+  uint32_t removes;
+  uint32_t page_writes;
+};
+
+/***** Global Functions *****/
+
+extern esp_err_t
+esp_vfs_spiffs_register(const esp_vfs_spiffs_conf_t * conf);
+
+extern esp_err_t
+esp_vfs_spiffs_unregister(const char * partition_label);
+
+extern esp_err_t
+esp_spiffs_info(const char * partition_label, size_t * total_bytes,
+  size_t * used_bytes);
+
+/***** Host Functions *****/
+
+// Keep the files in dir, which has to exist. Call before registering.
+extern void
+esp_spiffs_host_dir(const char * dir);
+
+// Simulate a power cut once bytes more bytes have been written: the write
+// that goes past it only writes up to the cut and every file operation after
+// it fails. Setting a new budget ends the cut, UINT32_MAX turns it off.
+extern void
+esp_spiffs_host_set_write_budget(uint32_t bytes);
+
+// Remove every file, as if the partition had been formatted.
+extern void
+esp_spiffs_host_format(void);
+
+extern struct esp_spiffs_host_stats *
+esp_spiffs_host_stats(void);
+
+extern void
+esp_spiffs_host_reset_stats(void);
+
+extern FILE *
+esp_spiffs_host_fopen(const char * path, const char * mode);
+
+extern size_t
+esp_spiffs_host_fread(void * dst, size_t size, size_t n, FILE * fp);
+
+extern size_t
+esp_spiffs_host_fwrite(const void * src, size_t size, size_t n, FILE * fp);
+
+extern int
+esp_spiffs_host_fclose(FILE * fp);
+
+extern int
+esp_spiffs_host_remove(const char * path);
+
+/***** Macros *****/
+
+#ifndef _ESP_SPIFFS_HOST_IMPL
+  #define fopen esp_spiffs_host_fopen
+  #define fread esp_spiffs_host_fread
+  #define fwrite esp_spiffs_host_fwrite
+  #define fclose esp_spiffs_host_fclose
+  #define remove esp_spiffs_host_remove
+#endif
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef _ESP_TIMER_H
+#define _ESP_TIMER_H
+
+/*
+ * Host version of esp_timer_get_time(), a clock the tests move by hand.
+ */
+
+/***** Includes *****/
+
+#include <stdint.h>
+
+/***** Global Functions *****/
+
+// Microseconds since the application started.
+extern int64_t
+esp_timer_get_time(void);
+
+extern void
+esp_timer_host_set(int64_t us);
+
+extern void
+esp_timer_host_advance(int64_t us);
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef _FREERTOS_H
+#define _FREERTOS_H
+
+/*
+ * Just enough of FreeRTOS for the single threaded host build.
+ */
+
+/***** Includes *****/
+
+#include <stdint.h>
+
+/***** Defines *****/
+
+#define pdTRUE (1)
+#define pdFALSE (0)
+#define portMAX_DELAY (0xFFFFFFFF)
+#define portTICK_PERIOD_MS (1)
+
+/***** Typedefs *****/
+
+typedef int BaseType_t;
+typedef uint32_t TickType_t;
+
+#endif
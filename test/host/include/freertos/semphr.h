@@ -0,0 +1,37 @@
+#ifndef _SEMPHR_H
+#define _SEMPHR_H
+
+/***** Includes *****/
+
+#include <stddef.h>
+
+#include "freertos/FreeRTOS.h"
+
+/***** Typedefs *****/
+
+typedef void * SemaphoreHandle_t;
+
+/***** Global Functions *****/
+
+// Nothing runs concurrently on the host, any non NULL handle will do.
+static inline SemaphoreHandle_t
+xSemaphoreCreateMutex(void)
+{
+  static int mutex;
+
+  return &mutex;
+}
+
+static inline BaseType_t
+xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+  return (NULL != sem) ? pdTRUE : pdFALSE;
+}
+
+static inline BaseType_t
+xSemaphoreGive(SemaphoreHandle_t sem)
+{
+  return (NULL != sem) ? pdTRUE : pdFALSE;
+}
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef _TASK_H
+#define _TASK_H
+
+/***** Includes *****/
+
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+
+/***** Global Functions *****/
+
+// Ticks of portTICK_PERIOD_MS from the monotonic clock.
+static inline TickType_t
+xTaskGetTickCount(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (TickType_t) ((ts.tv_sec * 1000) + (ts.tv_nsec / 1000000));
+}
+
+#endif
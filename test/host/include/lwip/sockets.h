@@ -0,0 +1,14 @@
+#ifndef _LWIP_SOCKETS_H
+#define _LWIP_SOCKETS_H
+
+/*
+ * The host socket API stands in for lwIP's.
+ */
+
+/***** Includes *****/
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef _MBEDTLS_CTR_DRBG_H
+#define _MBEDTLS_CTR_DRBG_H
+
+/*
+ * Host copy of the mbedTLS 2.28 CTR_DRBG calls aws_mqtt_tls.c uses. The
+ * context is opaque, sized for the libmbedcrypto 2.28 of the development
+ * machine.
+ */
+
+/***** Includes *****/
+
+#include <stddef.h>
+
+/***** Defines *****/
+
+#define MBEDTLS_ERR_CTR_DRBG_ENTROPY_SOURCE_FAILED (-0x0034)
+
+/***** Structs *****/
+
+typedef struct {
+  _Alignas(8) unsigned char opaque[392];
+} mbedtls_ctr_drbg_context;
+
+/***** Global Functions *****/
+
+extern void
+mbedtls_ctr_drbg_init(mbedtls_ctr_drbg_context * ctx);
+
+extern void
+mbedtls_ctr_drbg_free(mbedtls_ctr_drbg_context * ctx);
+
+extern int
+mbedtls_ctr_drbg_seed(mbedtls_ctr_drbg_context * ctx,
+  int (* f_entropy)(void *, unsigned char *, size_t), void * p_entropy,
+  const unsigned char * custom, size_t len);
+
+extern int
+mbedtls_ctr_drbg_random(void * p_rng, unsigned char * output,
+  size_t output_len);
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef _MBEDTLS_ENTROPY_H
+#define _MBEDTLS_ENTROPY_H
+
+/*
+ * Host copy of the mbedTLS 2.28 entropy calls aws_mqtt_tls.c uses. The
+ * context is opaque and a little larger than the one of the libmbedcrypto
+ * 2.28 of the development machine.
+ */
+
+/***** Includes *****/
+
+#include <stddef.h>
+
+/***** Structs *****/
+
+typedef struct {
+  _Alignas(8) unsigned char opaque[38016];
+} mbedtls_entropy_context;
+
+/***** Global Functions *****/
+
+extern void
+mbedtls_entropy_init(mbedtls_entropy_context * ctx);
+
+extern void
+mbedtls_entropy_free(mbedtls_entropy_context * ctx);
+
+extern int
+mbedtls_entropy_func(void * data, unsigned char * output, size_t len);
+
+#endif
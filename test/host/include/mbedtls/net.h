@@ -0,0 +1,51 @@
+#ifndef _MBEDTLS_NET_H
+#define _MBEDTLS_NET_H
+
+/*
+ * Host copy of the mbedTLS 2.28 socket calls aws_mqtt_tls.c uses, with the
+ * layout and error values of libmbedtls 2.28.
+ */
+
+/***** Includes *****/
+
+#include <stddef.h>
+#include <stdint.h>
+
+/***** Defines *****/
+
+#define MBEDTLS_ERR_NET_RECV_FAILED (-0x004C)
+#define MBEDTLS_ERR_NET_SEND_FAILED (-0x004E)
+#define MBEDTLS_ERR_NET_CONN_RESET (-0x0050)
+#define MBEDTLS_ERR_NET_UNKNOWN_HOST (-0x0052)
+
+#define MBEDTLS_NET_PROTO_TCP (0)
+
+/***** Structs *****/
+
+typedef struct {
+  int fd;
+} mbedtls_net_context;
+
+/***** Global Functions *****/
+
+extern void
+mbedtls_net_init(mbedtls_net_context * ctx);
+
+extern void
+mbedtls_net_free(mbedtls_net_context * ctx);
+
+extern int
+mbedtls_net_connect(mbedtls_net_context * ctx, const char * host,
+  const char * port, int proto);
+
+extern int
+mbedtls_net_set_block(mbedtls_net_context * ctx);
+
+extern int
+mbedtls_net_send(void * ctx, const unsigned char * buf, size_t len);
+
+extern int
+mbedtls_net_recv_timeout(void * ctx, unsigned char * buf, size_t len,
+  uint32_t timeout);
+
+#endif
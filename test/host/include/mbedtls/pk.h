@@ -0,0 +1,32 @@
+#ifndef _MBEDTLS_PK_H
+#define _MBEDTLS_PK_H
+
+/*
+ * Host copy of the mbedTLS 2.28 public key calls aws_mqtt_tls.c uses. The
+ * context is opaque, sized for the libmbedcrypto 2.28 of the development
+ * machine.
+ */
+
+/***** Includes *****/
+
+#include <stddef.h>
+
+/***** Structs *****/
+
+typedef struct {
+  _Alignas(8) unsigned char opaque[16];
+} mbedtls_pk_context;
+
+/***** Global Functions *****/
+
+extern void
+mbedtls_pk_init(mbedtls_pk_context * ctx);
+
+extern void
+mbedtls_pk_free(mbedtls_pk_context * ctx);
+
+extern int
+mbedtls_pk_parse_key(mbedtls_pk_context * ctx, const unsigned char * key,
+  size_t keylen, const unsigned char * pwd, size_t pwdlen);
+
+#endif
@@ -0,0 +1,181 @@
+#ifndef _MBEDTLS_SSL_H
+#define _MBEDTLS_SSL_H
+
+/*
+ * Host copy of the mbedTLS 2.28 SSL calls aws_mqtt_tls.c uses. The session
+ * and the head of the context up to session have the layout of libmbedtls
+ * 2.28 on x86-64, as aws_mqtt_tls.c reads them, the rest is opaque. Built
+ * with session tickets, like the ESP-IDF one.
+ */
+
+/***** Includes *****/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mbedtls/x509_crt.h"
+#include "mbedtls/pk.h"
+
+/***** Defines *****/
+
+#define MBEDTLS_SSL_SESSION_TICKETS
+
+#define MBEDTLS_ERR_SSL_TIMEOUT (-0x6800)
+#define MBEDTLS_ERR_SSL_WANT_WRITE (-0x6880)
+#define MBEDTLS_ERR_SSL_WANT_READ (-0x6900)
+
+#define MBEDTLS_SSL_IS_CLIENT (0)
+#define MBEDTLS_SSL_TRANSPORT_STREAM (0)
+#define MBEDTLS_SSL_PRESET_DEFAULT (0)
+
+#define MBEDTLS_SSL_VERIFY_NONE (0)
+#define MBEDTLS_SSL_VERIFY_OPTIONAL (1)
+#define MBEDTLS_SSL_VERIFY_REQUIRED (2)
+
+#define MBEDTLS_SSL_SESSION_TICKETS_DISABLED (0)
+#define MBEDTLS_SSL_SESSION_TICKETS_ENABLED (1)
+
+/***** Typedefs *****/
+
+typedef int
+(*mbedtls_ssl_send_t)(void * ctx, const unsigned char * buf, size_t len);
+
+typedef int
+(*mbedtls_ssl_recv_t)(void * ctx, unsigned char * buf, size_t len);
+
+typedef int
+(*mbedtls_ssl_recv_timeout_t)(void * ctx, unsigned char * buf, size_t len,
+  uint32_t timeout);
+
+typedef struct mbedtls_x509_crl mbedtls_x509_crl;
+
+/***** Structs *****/
+
+typedef struct {
+  _Alignas(8) unsigned char opaque[416];
+} mbedtls_ssl_config;
+
+typedef struct {
+  _Alignas(8) unsigned char reserved[8];
+  int64_t start;
+  int ciphersuite;
+  int compression;
+  size_t id_len;
+  unsigned char id[32];
+  unsigned char master[48];
+  mbedtls_x509_crt * peer_cert;
+  uint32_t verify_result;
+  unsigned char * ticket;
+  size_t ticket_len;
+  uint32_t ticket_lifetime;
+  unsigned char mfl_code;
+  int trunc_hmac;
+  int encrypt_then_mac;
+} mbedtls_ssl_session;
+
+typedef struct {
+  const mbedtls_ssl_config * conf;
+  int state;
+  int renego_status;
+  int renego_records_seen;
+  int major_ver;
+  int minor_ver;
+  unsigned badmac_seen;
+  void * f_vrfy;
+  void * p_vrfy;
+  mbedtls_ssl_send_t f_send;
+  mbedtls_ssl_recv_t f_recv;
+  mbedtls_ssl_recv_timeout_t f_recv_timeout;
+  void * p_bio;
+  mbedtls_ssl_session * session_in;
+  mbedtls_ssl_session * session_out;
+  mbedtls_ssl_session * session;
+  mbedtls_ssl_session * session_negotiate;
+  unsigned char opaque[624];
+} mbedtls_ssl_context;
+
+_Static_assert(160 == sizeof(mbedtls_ssl_session), "mbedTLS 2.28 session");
+_Static_assert(736 == sizeof(mbedtls_ssl_context), "mbedTLS 2.28 context");
+
+/***** Global Functions *****/
+
+extern void
+mbedtls_ssl_init(mbedtls_ssl_context * ssl);
+
+extern void
+mbedtls_ssl_free(mbedtls_ssl_context * ssl);
+
+extern int
+mbedtls_ssl_setup(mbedtls_ssl_context * ssl, const mbedtls_ssl_config * conf);
+
+extern int
+mbedtls_ssl_set_hostname(mbedtls_ssl_context * ssl, const char * hostname);
+
+extern void
+mbedtls_ssl_set_bio(mbedtls_ssl_context * ssl, void * p_bio,
+  mbedtls_ssl_send_t f_send, mbedtls_ssl_recv_t f_recv,
+  mbedtls_ssl_recv_timeout_t f_recv_timeout);
+
+extern int
+mbedtls_ssl_set_session(mbedtls_ssl_context * ssl,
+  const mbedtls_ssl_session * session);
+
+extern int
+mbedtls_ssl_get_session(const mbedtls_ssl_context * ssl,
+  mbedtls_ssl_session * session);
+
+extern int
+mbedtls_ssl_handshake(mbedtls_ssl_context * ssl);
+
+extern uint32_t
+mbedtls_ssl_get_verify_result(const mbedtls_ssl_context * ssl);
+
+extern int
+mbedtls_ssl_read(mbedtls_ssl_context * ssl, unsigned char * buf, size_t len);
+
+extern int
+mbedtls_ssl_write(mbedtls_ssl_context * ssl, const unsigned char * buf,
+  size_t len);
+
+extern int
+mbedtls_ssl_close_notify(mbedtls_ssl_context * ssl);
+
+extern void
+mbedtls_ssl_config_init(mbedtls_ssl_config * conf);
+
+extern void
+mbedtls_ssl_config_free(mbedtls_ssl_config * conf);
+
+extern int
+mbedtls_ssl_config_defaults(mbedtls_ssl_config * conf, int endpoint,
+  int transport, int preset);
+
+extern void
+mbedtls_ssl_conf_authmode(mbedtls_ssl_config * conf, int authmode);
+
+extern void
+mbedtls_ssl_conf_ca_chain(mbedtls_ssl_config * conf,
+  mbedtls_x509_crt * ca_chain, mbedtls_x509_crl * ca_crl);
+
+extern int
+mbedtls_ssl_conf_own_cert(mbedtls_ssl_config * conf,
+  mbedtls_x509_crt * own_cert, mbedtls_pk_context * pk_key);
+
+extern void
+mbedtls_ssl_conf_rng(mbedtls_ssl_config * conf,
+  int (* f_rng)(void *, unsigned char *, size_t), void * p_rng);
+
+extern void
+mbedtls_ssl_conf_read_timeout(mbedtls_ssl_config * conf, uint32_t timeout);
+
+extern void
+mbedtls_ssl_conf_session_tickets(mbedtls_ssl_config * conf,
+  int use_tickets);
+
+extern void
+mbedtls_ssl_session_init(mbedtls_ssl_session * session);
+
+extern void
+mbedtls_ssl_session_free(mbedtls_ssl_session * session);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef _MBEDTLS_X509_CRT_H
+#define _MBEDTLS_X509_CRT_H
+
+/*
+ * Host copy of the mbedTLS 2.28 certificate calls aws_mqtt_tls.c uses. The
+ * certificate is opaque, sized for the libmbedx509 2.28 of the development
+ * machine.
+ */
+
+/***** Includes *****/
+
+#include <stddef.h>
+
+/***** Structs *****/
+
+typedef struct {
+  _Alignas(8) unsigned char opaque[616];
+} mbedtls_x509_crt;
+
+/***** Global Functions *****/
+
+extern void
+mbedtls_x509_crt_init(mbedtls_x509_crt * crt);
+
+extern void
+mbedtls_x509_crt_free(mbedtls_x509_crt * crt);
+
+// buf is PEM with its terminating NUL counted in buflen, or DER.
+extern int
+mbedtls_x509_crt_parse(mbedtls_x509_crt * chain, const unsigned char * buf,
+  size_t buflen);
+
+#endif
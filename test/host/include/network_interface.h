@@ -0,0 +1,69 @@
+#ifndef _NETWORK_INTERFACE_H
+#define _NETWORK_INTERFACE_H
+
+/*
+ * Host stand-in for the network interface of the AWS IoT SDK and the mbedTLS
+ * platform of its ESP-IDF port, just what aws_mqtt_tls.c uses. Error values
+ * match iot_error.h of the SDK.
+ */
+
+/***** Includes *****/
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "mbedtls/net.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/ctr_drbg.h"
+
+/***** Enums *****/
+
+typedef enum {
+  SUCCESS = 0,
+  FAILURE = -1,
+  NULL_VALUE_ERROR = -2,
+  SSL_CONNECTION_ERROR = -4,
+  NETWORK_SSL_CONNECT_TIMEOUT_ERROR = -6,
+  NETWORK_MBEDTLS_ERR_CTR_DRBG_ENTROPY_SOURCE_FAILED = -16,
+  NETWORK_X509_ROOT_CRT_PARSE_ERROR = -19,
+  NETWORK_X509_DEVICE_CRT_PARSE_ERROR = -20,
+  NETWORK_PK_PRIVATE_KEY_PARSE_ERROR = -21,
+  NETWORK_ERR_NET_UNKNOWN_HOST = -23,
+  NETWORK_ERR_NET_CONNECT_FAILED = -24,
+} IoT_Error_t;
+
+/***** Structs *****/
+
+typedef struct {
+  const char * pRootCALocation;
+  const char * pDeviceCertLocation;
+  const char * pDevicePrivateKeyLocation;
+  const char * pDestinationURL;
+  uint16_t DestinationPort;
+  uint32_t timeout_ms;
+  bool ServerVerificationFlag;
+} TLSConnectParams;
+
+typedef struct {
+  mbedtls_entropy_context entropy;
+  mbedtls_ctr_drbg_context ctr_drbg;
+  mbedtls_ssl_context ssl;
+  mbedtls_ssl_config conf;
+  uint32_t flags;
+  mbedtls_x509_crt cacert;
+  mbedtls_x509_crt clicert;
+  mbedtls_pk_context pkey;
+  mbedtls_net_context server_fd;
+} TLSDataParams;
+
+typedef struct Network Network;
+
+struct Network {
+  IoT_Error_t (* connect)(Network *, TLSConnectParams *);
+  IoT_Error_t (* destroy)(Network *);
+  TLSConnectParams tlsConnectParams;
+  TLSDataParams tlsDataParams;
+};
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef _SYSTEM_H
+#define _SYSTEM_H
+
+/*
+ * Host stand-in for main/system.h. Errors and warnings go to stderr, info and
+ * debug messages only with PEEP_HOST_LOG_VERBOSE defined.
+ */
+
+/***** Includes *****/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+/***** Macros *****/
+
+#define _HOST_LOG(level, format, ...) \
+  fprintf(stderr, level " (%s) " format "\n", __func__, ##__VA_ARGS__)
+
+#define LOGE(format, ...) _HOST_LOG("E", format, ##__VA_ARGS__)
+#define LOGW(format, ...) _HOST_LOG("W", format, ##__VA_ARGS__)
+
+#ifdef PEEP_HOST_LOG_VERBOSE
+  #define LOGI(format, ...) _HOST_LOG("I", format, ##__VA_ARGS__)
+  #define LOGD(format, ...) _HOST_LOG("D", format, ##__VA_ARGS__)
+#else
+  // Still compiled, so arguments used only for logging are not unused.
+  #define LOGI(format, ...) \
+    do { if (0) { _HOST_LOG("I", format, ##__VA_ARGS__); } } while (0)
+  #define LOGD(format, ...) \
+    do { if (0) { _HOST_LOG("D", format, ##__VA_ARGS__); } } while (0)
+#endif
+
+#endif
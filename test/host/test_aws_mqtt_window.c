@@ -0,0 +1,93 @@
+/***** Includes *****/
+
+#include "unity.h"
+#include "aws_mqtt_window.h"
+
+/***** Unit Tests *****/
+
+static void
+test_in_order(void)
+{
+  struct aws_mqtt_window window;
+  uint16_t id = 0;
+
+  aws_mqtt_window_init(&window, 4);
+  for (id = 1; id <= 4; id++) {
+    TEST_ASSERT_TRUE(aws_mqtt_window_add(&window, id, 10 * id));
+  }
+  TEST_ASSERT_TRUE(aws_mqtt_window_is_full(&window));
+  TEST_ASSERT_FALSE(aws_mqtt_window_add(&window, 5, 1));
+
+  TEST_ASSERT_EQUAL_UINT32(10, aws_mqtt_window_ack(&window, 1));
+  TEST_ASSERT_FALSE(aws_mqtt_window_is_full(&window));
+  TEST_ASSERT_TRUE(aws_mqtt_window_add(&window, 5, 50));
+  TEST_ASSERT_EQUAL_UINT32(20, aws_mqtt_window_ack(&window, 2));
+  TEST_ASSERT_EQUAL_UINT32(30, aws_mqtt_window_ack(&window, 3));
+  TEST_ASSERT_EQUAL_UINT32(40, aws_mqtt_window_ack(&window, 4));
+  TEST_ASSERT_EQUAL_UINT32(50, aws_mqtt_window_ack(&window, 5));
+  TEST_ASSERT_EQUAL_UINT32(0, aws_mqtt_window_total(&window));
+}
+
+static void
+test_out_of_order(void)
+{
+  struct aws_mqtt_window window;
+
+  aws_mqtt_window_init(&window, 3);
+  TEST_ASSERT_TRUE(aws_mqtt_window_add(&window, 65535, 8));
+  TEST_ASSERT_TRUE(aws_mqtt_window_add(&window, 1, 8));
+  TEST_ASSERT_TRUE(aws_mqtt_window_add(&window, 2, 5));
+
+  // Nothing counts as delivered while the oldest message is waiting.
+  TEST_ASSERT_EQUAL_UINT32(0, aws_mqtt_window_ack(&window, 2));
+  TEST_ASSERT_EQUAL_UINT32(0, aws_mqtt_window_ack(&window, 1));
+  TEST_ASSERT_EQUAL_UINT32(3, aws_mqtt_window_total(&window));
+  TEST_ASSERT_EQUAL_UINT32(21, aws_mqtt_window_ack(&window, 65535));
+  TEST_ASSERT_EQUAL_UINT32(0, aws_mqtt_window_total(&window));
+}
+
+static void
+test_unknown_ack(void)
+{
+  struct aws_mqtt_window window;
+
+  aws_mqtt_window_init(&window, 2);
+  TEST_ASSERT_EQUAL_UINT32(0, aws_mqtt_window_ack(&window, 7));
+  TEST_ASSERT_TRUE(aws_mqtt_window_add(&window, 7, 3));
+  TEST_ASSERT_EQUAL_UINT32(0, aws_mqtt_window_ack(&window, 8));
+  TEST_ASSERT_EQUAL_UINT32(3, aws_mqtt_window_ack(&window, 7));
+  TEST_ASSERT_EQUAL_UINT32(0, aws_mqtt_window_ack(&window, 7));
+}
+
+static void
+test_len_limited(void)
+{
+  struct aws_mqtt_window window;
+  uint16_t id = 0;
+
+  aws_mqtt_window_init(&window, 100);
+  for (id = 0; id < AWS_MQTT_WINDOW_LEN_MAX; id++) {
+    TEST_ASSERT_TRUE(aws_mqtt_window_add(&window, id, 1));
+  }
+  TEST_ASSERT_FALSE(aws_mqtt_window_add(&window, id, 1));
+
+  // A window of one is stop and wait.
+  aws_mqtt_window_init(&window, 1);
+  TEST_ASSERT_TRUE(aws_mqtt_window_add(&window, 1, 1));
+  TEST_ASSERT_TRUE(aws_mqtt_window_is_full(&window));
+}
+
+/***** Global Functions *****/
+
+int
+main(void)
+{
+  UNITY_BEGIN();
+
+  RUN_TEST(test_in_order);
+  RUN_TEST(test_out_of_order);
+  RUN_TEST(test_unknown_ack);
+  RUN_TEST(test_len_limited);
+
+  return UNITY_END();
+}
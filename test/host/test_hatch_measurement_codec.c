@@ -0,0 +1,165 @@
+/***** Includes *****/
+
+#include <math.h>
+#include <string.h>
+
+#include "unity.h"
+#include "hatch_measurement_codec.h"
+
+/***** Local Functions *****/
+
+static struct hatch_measurement
+_make(uint32_t n)
+{
+  struct hatch_measurement meas;
+
+  meas.unix_timestamp = 1546300800 + (n * 900) + (n % 3);
+  meas.temperature = 37.5f + sinf(n * 0.01f) * 0.8f;
+  meas.humidity = 55.0f + cosf(n * 0.013f) * 6.0f;
+  meas.air_pressure = 101325.0f + sinf(n * 0.002f) * 900.0f;
+  meas.gas_resistance = 120000.0f + sinf(n * 0.05f) * 40000.0f;
+
+  return meas;
+}
+
+static void
+_expect_close(const struct hatch_measurement * expect,
+  const struct hatch_measurement * meas)
+{
+  TEST_ASSERT_EQUAL_UINT32(expect->unix_timestamp, meas->unix_timestamp);
+  TEST_ASSERT_FLOAT_WITHIN(0.0051f, expect->temperature, meas->temperature);
+  TEST_ASSERT_FLOAT_WITHIN(0.0051f, expect->humidity, meas->humidity);
+  TEST_ASSERT_FLOAT_WITHIN(0.51f, expect->air_pressure, meas->air_pressure);
+  TEST_ASSERT_FLOAT_WITHIN(expect->gas_resistance * 0.0005f,
+    expect->gas_resistance, meas->gas_resistance);
+}
+
+/***** Unit Tests *****/
+
+static void
+test_round_trip(void)
+{
+  struct hatch_measurement_codec enc;
+  struct hatch_measurement_codec dec;
+  struct hatch_measurement expect;
+  struct hatch_measurement meas;
+  uint8_t buf[HATCH_MEASUREMENT_CODEC_LEN_MAX];
+  uint32_t total = 0;
+  uint32_t len = 0;
+  uint32_t n = 0;
+
+  hatch_measurement_codec_reset(&enc);
+  hatch_measurement_codec_reset(&dec);
+
+  for (n = 0; n < 5000; n++) {
+    expect = _make(n);
+    len = hatch_measurement_encode(&enc, &expect, buf, (0 == (n % 400)));
+    TEST_ASSERT_TRUE(len <= HATCH_MEASUREMENT_CODEC_LEN_MAX);
+    TEST_ASSERT_TRUE(hatch_measurement_decode(&dec, buf, len, &meas));
+    _expect_close(&expect, &meas);
+    total += len;
+  }
+
+  // Slowly changing readings should code to well under half the raw size.
+  TEST_ASSERT_TRUE(total < (n * sizeof(struct hatch_measurement) / 2));
+}
+
+static void
+test_key_record_resyncs(void)
+{
+  struct hatch_measurement_codec enc;
+  struct hatch_measurement_codec dec;
+  struct hatch_measurement expect = _make(7);
+  struct hatch_measurement meas;
+  uint8_t buf[HATCH_MEASUREMENT_CODEC_LEN_MAX];
+  uint32_t len = 0;
+
+  // A decoder with unrelated state still gets a key record right.
+  hatch_measurement_codec_reset(&enc);
+  hatch_measurement_codec_reset(&dec);
+  len = hatch_measurement_encode(&enc, &expect, buf, false);
+  len = hatch_measurement_encode(&enc, &expect, buf, true);
+  dec.unix_timestamp = 12345;
+  dec.temperature = -400;
+  TEST_ASSERT_TRUE(hatch_measurement_decode(&dec, buf, len, &meas));
+  _expect_close(&expect, &meas);
+  TEST_ASSERT_EQUAL_MEMORY(&enc, &dec, sizeof(enc));
+}
+
+static void
+test_extremes(void)
+{
+  struct hatch_measurement_codec enc;
+  struct hatch_measurement_codec dec;
+  struct hatch_measurement expect;
+  struct hatch_measurement meas;
+  uint8_t buf[HATCH_MEASUREMENT_CODEC_LEN_MAX];
+  uint32_t len = 0;
+
+  hatch_measurement_codec_reset(&enc);
+  hatch_measurement_codec_reset(&dec);
+
+  expect.unix_timestamp = 0xFFFFFFF0;
+  expect.temperature = -40.0f;
+  expect.humidity = 0.0f;
+  expect.air_pressure = 30000.0f;
+  expect.gas_resistance = 0.0f;
+  len = hatch_measurement_encode(&enc, &expect, buf, true);
+  TEST_ASSERT_TRUE(hatch_measurement_decode(&dec, buf, len, &meas));
+  _expect_close(&expect, &meas);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, meas.gas_resistance);
+
+  // Swing to the other end in a single delta record.
+  expect.unix_timestamp = 10;
+  expect.temperature = 85.0f;
+  expect.humidity = 100.0f;
+  expect.air_pressure = 110000.0f;
+  expect.gas_resistance = 2000000.0f;
+  len = hatch_measurement_encode(&enc, &expect, buf, false);
+  TEST_ASSERT_TRUE(hatch_measurement_decode(&dec, buf, len, &meas));
+  _expect_close(&expect, &meas);
+}
+
+static void
+test_rejects_bad_input(void)
+{
+  struct hatch_measurement_codec enc;
+  struct hatch_measurement_codec dec;
+  struct hatch_measurement_codec before;
+  struct hatch_measurement expect = _make(1);
+  struct hatch_measurement meas;
+  uint8_t buf[HATCH_MEASUREMENT_CODEC_LEN_MAX];
+  uint32_t len = 0;
+  uint32_t n = 0;
+
+  hatch_measurement_codec_reset(&enc);
+  hatch_measurement_codec_reset(&dec);
+  len = hatch_measurement_encode(&enc, &expect, buf, true);
+  dec.unix_timestamp = 12345;
+  dec.temperature = -400;
+  before = dec;
+
+  // Truncated records fail without touching the codec state.
+  for (n = 0; n < len; n++) {
+    TEST_ASSERT_FALSE(hatch_measurement_decode(&dec, buf, n, &meas));
+    TEST_ASSERT_EQUAL_MEMORY(&before, &dec, sizeof(dec));
+  }
+
+  buf[0] = 0xF1;
+  TEST_ASSERT_FALSE(hatch_measurement_decode(&dec, buf, len, &meas));
+}
+
+/***** Global Functions *****/
+
+int
+main(void)
+{
+  UNITY_BEGIN();
+
+  RUN_TEST(test_round_trip);
+  RUN_TEST(test_key_record_resyncs);
+  RUN_TEST(test_extremes);
+  RUN_TEST(test_rejects_bad_input);
+
+  return UNITY_END();
+}
@@ -0,0 +1,165 @@
+/***** Includes *****/
+
+#include <string.h>
+
+#include "unity.h"
+#include "hatch_measurement_json.h"
+
+/***** Defines *****/
+
+#define _START (1546300800)
+#define _PEEP_UUID "0e4c4f26-1cae-4d3f-8e44-5a4c6d14e1a9"
+#define _HATCH_UUID "5f1b2a9e-7c3d-4e8f-9a0b-1c2d3e4f5a6b"
+
+/***** Local Functions *****/
+
+static struct hatch_measurement
+_make(uint32_t n)
+{
+  struct hatch_measurement meas;
+
+  meas.unix_timestamp = _START + (n * 900);
+  meas.temperature = 37.5f + n;
+  meas.humidity = 55.25f;
+  meas.air_pressure = 101325.0f;
+  meas.gas_resistance = 120000.0f;
+
+  return meas;
+}
+
+static uint32_t
+_occurrences(const char * s, const char * key)
+{
+  uint32_t total = 0;
+
+  while ((s = strstr(s, key))) {
+    total++;
+    s++;
+  }
+
+  return total;
+}
+
+/***** Unit Tests *****/
+
+static void
+test_format(void)
+{
+  struct hatch_measurement meas = _make(0);
+  char buf[512];
+
+  TEST_ASSERT_TRUE(hatch_measurement_json_format(buf, sizeof(buf), &meas,
+    _PEEP_UUID, _HATCH_UUID));
+  TEST_ASSERT_NOT_NULL(strstr(buf, "\"unixTime\": 1546300800,"));
+  TEST_ASSERT_NOT_NULL(strstr(buf, "\"peepUUID\": \"" _PEEP_UUID "\""));
+  TEST_ASSERT_NOT_NULL(strstr(buf, "\"temperature\": 37.50,"));
+  TEST_ASSERT_NOT_NULL(strstr(buf, "\"gasResistance\": 120000\n}"));
+
+  TEST_ASSERT_TRUE(hatch_measurement_json_format(buf, strlen(buf) + 1, &meas,
+    _PEEP_UUID, _HATCH_UUID));
+  TEST_ASSERT_FALSE(hatch_measurement_json_format(buf, strlen(buf), &meas,
+    _PEEP_UUID, _HATCH_UUID));
+}
+
+static void
+test_format_numbers(void)
+{
+  struct hatch_measurement meas = _make(0);
+  char buf[512];
+
+  meas.unix_timestamp = 0;
+  meas.temperature = -5.126f;
+  meas.humidity = 0.004f;
+  meas.air_pressure = 99999.5f;
+  meas.gas_resistance = -0.2f;
+  TEST_ASSERT_TRUE(hatch_measurement_json_format(buf, sizeof(buf), &meas,
+    _PEEP_UUID, _HATCH_UUID));
+  TEST_ASSERT_NOT_NULL(strstr(buf, "\"unixTime\": 0,"));
+  TEST_ASSERT_NOT_NULL(strstr(buf, "\"temperature\": -5.13,"));
+  TEST_ASSERT_NOT_NULL(strstr(buf, "\"humidity\": 0.00,"));
+  TEST_ASSERT_NOT_NULL(strstr(buf, "\"pressure\": 100000,"));
+  TEST_ASSERT_NOT_NULL(strstr(buf, "\"gasResistance\": 0\n}"));
+
+  meas.unix_timestamp = 4294967295u;
+  meas.temperature = 1e30f;
+  TEST_ASSERT_TRUE(hatch_measurement_json_format(buf, sizeof(buf), &meas,
+    _PEEP_UUID, _HATCH_UUID));
+  TEST_ASSERT_NOT_NULL(strstr(buf, "\"unixTime\": 4294967295,"));
+  TEST_ASSERT_NOT_NULL(strstr(buf, "\"temperature\": 42949672.95,"));
+}
+
+static void
+test_format_batch(void)
+{
+  struct hatch_measurement meas[16];
+  uint32_t count = 0;
+  uint32_t done = 0;
+  char buf[1000];
+  uint32_t n = 0;
+
+  for (n = 0; n < 16; n++) {
+    meas[n] = _make(n);
+  }
+
+  while (done < 16) {
+    TEST_ASSERT_TRUE(hatch_measurement_json_format_batch(buf, sizeof(buf),
+      &meas[done], 16 - done, _PEEP_UUID, _HATCH_UUID, &count));
+    TEST_ASSERT_TRUE(count > 1);
+    TEST_ASSERT_TRUE(strlen(buf) < sizeof(buf));
+    TEST_ASSERT_EQUAL_UINT32(count, _occurrences(buf, "\"unixTime\""));
+    TEST_ASSERT_EQUAL_UINT32(1, _occurrences(buf, _PEEP_UUID));
+    TEST_ASSERT_EQUAL_UINT32(0, strncmp(buf,
+      "{\"peepUUID\":\"" _PEEP_UUID "\",\"hatchUUID\":\"" _HATCH_UUID
+      "\",\"measurements\":[{\"unixTime\":", 112));
+    TEST_ASSERT_EQUAL_STRING("}]}", &buf[strlen(buf) - 3]);
+    done += count;
+  }
+
+  TEST_ASSERT_EQUAL_UINT32(16, done);
+}
+
+static void
+test_format_batch_too_small(void)
+{
+  struct hatch_measurement meas = _make(0);
+  uint32_t count = 1;
+  char buf[128];
+
+  TEST_ASSERT_FALSE(hatch_measurement_json_format_batch(buf, sizeof(buf),
+    &meas, 1, _PEEP_UUID, _HATCH_UUID, &count));
+  TEST_ASSERT_EQUAL_UINT32(0, count);
+  TEST_ASSERT_FALSE(hatch_measurement_json_format_batch(buf, sizeof(buf),
+    &meas, 0, _PEEP_UUID, _HATCH_UUID, &count));
+}
+
+static void
+test_format_rollup(void)
+{
+  struct hatch_measurement_rollup rollup;
+  struct hatch_measurement meas = _make(0);
+  char buf[1024];
+
+  hatch_measurement_rollup_init(&rollup, meas.unix_timestamp, 3600);
+  TEST_ASSERT_TRUE(hatch_measurement_rollup_add(&rollup, &meas));
+  TEST_ASSERT_TRUE(hatch_measurement_json_format_rollup(buf, sizeof(buf),
+    &rollup, _PEEP_UUID, _HATCH_UUID));
+  TEST_ASSERT_NOT_NULL(strstr(buf, "\"periodSec\": 3600,"));
+  TEST_ASSERT_NOT_NULL(strstr(buf, "\"samples\": 1,"));
+  TEST_ASSERT_NOT_NULL(strstr(buf, "\"temperatureMax\": 37.50,"));
+}
+
+/***** Global Functions *****/
+
+int
+main(void)
+{
+  UNITY_BEGIN();
+
+  RUN_TEST(test_format);
+  RUN_TEST(test_format_numbers);
+  RUN_TEST(test_format_batch);
+  RUN_TEST(test_format_batch_too_small);
+  RUN_TEST(test_format_rollup);
+
+  return UNITY_END();
+}
@@ -0,0 +1,189 @@
+/***** Includes *****/
+
+#include <string.h>
+
+#include "unity.h"
+#include "hatch_measurement_pb.h"
+
+/***** Defines *****/
+
+#define _START (1546300800)
+#define _PEEP_UUID "0e4c4f26-1cae-4d3f-8e44-5a4c6d14e1a9"
+#define _HATCH_UUID "5f1b2a9e-7c3d-4e8f-9a0b-1c2d3e4f5a6b"
+
+/***** Local Functions *****/
+
+static struct hatch_measurement
+_make(uint32_t n)
+{
+  struct hatch_measurement meas;
+
+  meas.unix_timestamp = _START + (n * 900);
+  meas.temperature = 37.5f - (n * 4.01f);
+  meas.humidity = 55.25f + n;
+  meas.air_pressure = 101325.0f + n;
+  meas.gas_resistance = 120000.0f + (n * 100);
+
+  return meas;
+}
+
+static void
+_assert_equal(const struct hatch_measurement * a,
+  const struct hatch_measurement * b)
+{
+  TEST_ASSERT_EQUAL_UINT32(a->unix_timestamp, b->unix_timestamp);
+  TEST_ASSERT_FLOAT_WITHIN(0.005f, a->temperature, b->temperature);
+  TEST_ASSERT_FLOAT_WITHIN(0.005f, a->humidity, b->humidity);
+  TEST_ASSERT_FLOAT_WITHIN(0.5f, a->air_pressure, b->air_pressure);
+  TEST_ASSERT_FLOAT_WITHIN(0.5f, a->gas_resistance, b->gas_resistance);
+}
+
+/***** Unit Tests *****/
+
+static void
+test_round_trip(void)
+{
+  struct hatch_measurement meas[16];
+  struct hatch_measurement out[16];
+  char peep_uuid[UUID_BUF_LEN];
+  char hatch_uuid[UUID_BUF_LEN];
+  uint8_t buf[1024];
+  uint32_t count = 0;
+  uint32_t total = 0;
+  uint32_t len = 0;
+  uint32_t n = 0;
+
+  for (n = 0; n < 16; n++) {
+    meas[n] = _make(n);
+  }
+
+  TEST_ASSERT_TRUE(hatch_measurement_pb_encode_batch(buf, sizeof(buf), meas,
+    16, _PEEP_UUID, _HATCH_UUID, &count, &len));
+  TEST_ASSERT_EQUAL_UINT32(16, count);
+  TEST_ASSERT_TRUE(len < (76 + (16 * 24)));
+
+  TEST_ASSERT_TRUE(hatch_measurement_pb_decode_batch(buf, len, peep_uuid,
+    hatch_uuid, out, 16, &total));
+  TEST_ASSERT_EQUAL_UINT32(16, total);
+  TEST_ASSERT_EQUAL_STRING(_PEEP_UUID, peep_uuid);
+  TEST_ASSERT_EQUAL_STRING(_HATCH_UUID, hatch_uuid);
+  for (n = 0; n < 16; n++) {
+    _assert_equal(&meas[n], &out[n]);
+  }
+
+  // Not enough room for the decoded measurements.
+  TEST_ASSERT_FALSE(hatch_measurement_pb_decode_batch(buf, len, peep_uuid,
+    hatch_uuid, out, 15, &total));
+}
+
+static void
+test_fill_buffer(void)
+{
+  struct hatch_measurement meas[16];
+  struct hatch_measurement out[16];
+  char peep_uuid[UUID_BUF_LEN];
+  char hatch_uuid[UUID_BUF_LEN];
+  uint8_t buf[200];
+  uint32_t count = 0;
+  uint32_t total = 0;
+  uint32_t len = 0;
+  uint32_t n = 0;
+
+  for (n = 0; n < 16; n++) {
+    meas[n] = _make(n);
+  }
+
+  TEST_ASSERT_TRUE(hatch_measurement_pb_encode_batch(buf, sizeof(buf), meas,
+    16, _PEEP_UUID, _HATCH_UUID, &count, &len));
+  TEST_ASSERT_TRUE((count > 1) && (count < 16));
+  TEST_ASSERT_TRUE(len <= sizeof(buf));
+  TEST_ASSERT_TRUE(hatch_measurement_pb_decode_batch(buf, len, peep_uuid,
+    hatch_uuid, out, 16, &total));
+  TEST_ASSERT_EQUAL_UINT32(count, total);
+
+  TEST_ASSERT_FALSE(hatch_measurement_pb_encode_batch(buf, 90, meas, 16,
+    _PEEP_UUID, _HATCH_UUID, &count, &len));
+  TEST_ASSERT_EQUAL_UINT32(0, count);
+}
+
+static void
+test_zero_and_unknown_fields(void)
+{
+  struct hatch_measurement meas = {0};
+  struct hatch_measurement out;
+  char peep_uuid[UUID_BUF_LEN];
+  char hatch_uuid[UUID_BUF_LEN];
+  uint8_t buf[128];
+  uint32_t count = 0;
+  uint32_t total = 0;
+  uint32_t len = 0;
+
+  // All zero measurement is an empty Measurement.
+  TEST_ASSERT_TRUE(hatch_measurement_pb_encode_batch(buf, sizeof(buf), &meas,
+    1, "p", "h", &count, &len));
+  TEST_ASSERT_EQUAL_UINT32(8, len);
+  TEST_ASSERT_EQUAL_HEX8(0x1A, buf[6]);
+  TEST_ASSERT_EQUAL_HEX8(0x00, buf[7]);
+
+  // Fields from a newer version are skipped: varint 4, fixed32 5, bytes 6.
+  buf[len++] = 0x20;
+  buf[len++] = 0x96;
+  buf[len++] = 0x01;
+  buf[len++] = 0x2D;
+  len += 4;
+  buf[len++] = 0x32;
+  buf[len++] = 0x01;
+  buf[len++] = 0xFF;
+  TEST_ASSERT_TRUE(hatch_measurement_pb_decode_batch(buf, len, peep_uuid,
+    hatch_uuid, &out, 1, &total));
+  TEST_ASSERT_EQUAL_UINT32(1, total);
+  TEST_ASSERT_EQUAL_STRING("p", peep_uuid);
+  _assert_equal(&meas, &out);
+}
+
+static void
+test_malformed(void)
+{
+  struct hatch_measurement meas = _make(1);
+  struct hatch_measurement out;
+  char peep_uuid[UUID_BUF_LEN];
+  char hatch_uuid[UUID_BUF_LEN];
+  uint8_t buf[128];
+  uint32_t count = 0;
+  uint32_t total = 0;
+  uint32_t len = 0;
+  uint32_t n = 0;
+
+  TEST_ASSERT_TRUE(hatch_measurement_pb_encode_batch(buf, sizeof(buf), &meas,
+    1, _PEEP_UUID, _HATCH_UUID, &count, &len));
+
+  // Every truncation of the message either decodes nothing of the
+  // measurement or fails.
+  for (n = 0; n < len; n++) {
+    total = 0;
+    if (hatch_measurement_pb_decode_batch(buf, n, peep_uuid, hatch_uuid, &out,
+        1, &total)) {
+      TEST_ASSERT_EQUAL_UINT32(0, total);
+    }
+  }
+
+  // Wire type 3 is not valid.
+  buf[0] = 0x0B;
+  TEST_ASSERT_FALSE(hatch_measurement_pb_decode_batch(buf, len, peep_uuid,
+    hatch_uuid, &out, 1, &total));
+}
+
+/***** Global Functions *****/
+
+int
+main(void)
+{
+  UNITY_BEGIN();
+
+  RUN_TEST(test_round_trip);
+  RUN_TEST(test_fill_buffer);
+  RUN_TEST(test_zero_and_unknown_fields);
+  RUN_TEST(test_malformed);
+
+  return UNITY_END();
+}
@@ -0,0 +1,92 @@
+/***** Includes *****/
+
+#include "unity.h"
+#include "hatch_measurement_rollup.h"
+
+/***** Defines *****/
+
+#define _HOUR (60 * 60)
+#define _START (1546300800)
+
+/***** Local Functions *****/
+
+static struct hatch_measurement
+_make(uint32_t unix_timestamp, float value)
+{
+  struct hatch_measurement meas;
+
+  meas.unix_timestamp = unix_timestamp;
+  meas.temperature = value;
+  meas.humidity = 50.0f + value;
+  meas.air_pressure = 101000.0f + value;
+  meas.gas_resistance = 100000.0f + value;
+
+  return meas;
+}
+
+/***** Unit Tests *****/
+
+static void
+test_aligned_period(void)
+{
+  struct hatch_measurement_rollup rollup;
+
+  hatch_measurement_rollup_init(&rollup, _START + 1234, _HOUR);
+  TEST_ASSERT_EQUAL_UINT32(_START, rollup.unix_timestamp);
+  TEST_ASSERT_EQUAL_UINT32(_HOUR, rollup.period_sec);
+  TEST_ASSERT_EQUAL_UINT32(0, rollup.samples);
+}
+
+static void
+test_min_max_mean(void)
+{
+  struct hatch_measurement_rollup rollup;
+  struct hatch_measurement meas;
+  uint32_t n = 0;
+
+  hatch_measurement_rollup_init(&rollup, _START, _HOUR);
+  for (n = 0; n < 12; n++) {
+    meas = _make(_START + (n * 300), 30.0f + n);
+    TEST_ASSERT_TRUE(hatch_measurement_rollup_add(&rollup, &meas));
+  }
+
+  TEST_ASSERT_EQUAL_UINT32(12, rollup.samples);
+  TEST_ASSERT_EQUAL_FLOAT(30.0f, rollup.temperature.min);
+  TEST_ASSERT_EQUAL_FLOAT(41.0f, rollup.temperature.max);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 35.5f, rollup.temperature.mean);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 85.5f, rollup.humidity.mean);
+  TEST_ASSERT_EQUAL_FLOAT(101030.0f, rollup.air_pressure.min);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 101035.5f, rollup.air_pressure.mean);
+  TEST_ASSERT_EQUAL_FLOAT(100041.0f, rollup.gas_resistance.max);
+}
+
+static void
+test_outside_period(void)
+{
+  struct hatch_measurement_rollup rollup;
+  struct hatch_measurement meas;
+
+  hatch_measurement_rollup_init(&rollup, _START + _HOUR, _HOUR);
+
+  meas = _make(_START + _HOUR - 1, 1.0f);
+  TEST_ASSERT_FALSE(hatch_measurement_rollup_add(&rollup, &meas));
+  meas = _make(_START + (2 * _HOUR), 1.0f);
+  TEST_ASSERT_FALSE(hatch_measurement_rollup_add(&rollup, &meas));
+  meas = _make(_START + (2 * _HOUR) - 1, 1.0f);
+  TEST_ASSERT_TRUE(hatch_measurement_rollup_add(&rollup, &meas));
+  TEST_ASSERT_EQUAL_UINT32(1, rollup.samples);
+}
+
+/***** Global Functions *****/
+
+int
+main(void)
+{
+  UNITY_BEGIN();
+
+  RUN_TEST(test_aligned_period);
+  RUN_TEST(test_min_max_mean);
+  RUN_TEST(test_outside_period);
+
+  return UNITY_END();
+}
@@ -0,0 +1,382 @@
+/***** Includes *****/
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "unity.h"
+#include "esp_spiffs.h"
+#include "hatch_config.h"
+#include "memory.h"
+#include "state.h"
+
+/***** Defines *****/
+
+#define _DIR "build/test_memory.spiffs"
+
+/***** Local Functions *****/
+
+// Start over after deep sleep, only RTC memory is left.
+static void
+_wake(void)
+{
+  esp_vfs_spiffs_unregister(NULL);
+  TEST_ASSERT_TRUE(memory_init());
+}
+
+static void
+_power_cycle(void)
+{
+  memory_deinit();
+  TEST_ASSERT_TRUE(memory_init());
+}
+
+static uint32_t
+_crc32(const uint8_t * p, uint32_t len)
+{
+  uint32_t crc = 0xFFFFFFFF;
+  uint32_t n = 0;
+
+  while (len--) {
+    crc ^= *p++;
+    for (n = 0; n < 8; n++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+
+  return ~crc;
+}
+
+/***** Unit Tests *****/
+
+void
+setUp(void)
+{
+  mkdir(_DIR, 0755);
+  esp_spiffs_host_dir(_DIR);
+  esp_spiffs_host_format();
+  TEST_ASSERT_TRUE(memory_init());
+  esp_spiffs_host_reset_stats();
+}
+
+void
+tearDown(void)
+{
+  memory_deinit();
+}
+
+static void
+test_set_and_get(void)
+{
+  char src[] = "hello peep";
+  char dst[32] = {0};
+
+  TEST_ASSERT_EQUAL_INT32(sizeof(src),
+    memory_set_item(MEMORY_ITEM_TEST, (uint8_t *) src, sizeof(src)));
+  TEST_ASSERT_EQUAL_INT32(sizeof(src),
+    memory_get_item(MEMORY_ITEM_TEST, (uint8_t *) dst, sizeof(dst)));
+  TEST_ASSERT_EQUAL_STRING(src, dst);
+
+  // A shorter value replaces the old one completely.
+  TEST_ASSERT_EQUAL_INT32(3,
+    memory_set_item(MEMORY_ITEM_TEST, (uint8_t *) "hi", 3));
+  TEST_ASSERT_EQUAL_INT32(3,
+    memory_get_item(MEMORY_ITEM_TEST, (uint8_t *) dst, sizeof(dst)));
+  TEST_ASSERT_EQUAL_STRING("hi", dst);
+}
+
+static void
+test_missing_and_invalid(void)
+{
+  uint8_t buf[8];
+
+  TEST_ASSERT_EQUAL_INT32(-1,
+    memory_get_item(MEMORY_ITEM_TEST, buf, sizeof(buf)));
+  TEST_ASSERT_EQUAL_INT32(-1,
+    memory_get_item(MEMORY_ITEM_INVALID, buf, sizeof(buf)));
+  TEST_ASSERT_EQUAL_INT32(-1,
+    memory_set_item(MEMORY_ITEM_INVALID, buf, sizeof(buf)));
+  TEST_ASSERT_FALSE(memory_delete_item(MEMORY_ITEM_TEST));
+}
+
+static void
+test_delete(void)
+{
+  uint8_t buf[8] = {0};
+
+  TEST_ASSERT_EQUAL_INT32(sizeof(buf),
+    memory_set_item(MEMORY_ITEM_TEST, buf, sizeof(buf)));
+  TEST_ASSERT_TRUE(memory_delete_item(MEMORY_ITEM_TEST));
+  TEST_ASSERT_EQUAL_INT32(-1,
+    memory_get_item(MEMORY_ITEM_TEST, buf, sizeof(buf)));
+  _power_cycle();
+  TEST_ASSERT_EQUAL_INT32(-1,
+    memory_get_item(MEMORY_ITEM_TEST, buf, sizeof(buf)));
+}
+
+static void
+test_state(void)
+{
+  enum peep_state state = PEEP_STATE_UNKNOWN;
+
+  TEST_ASSERT_FALSE(peep_get_state(&state));
+  TEST_ASSERT_TRUE(peep_set_state(PEEP_STATE_MEASURE));
+  TEST_ASSERT_TRUE(peep_get_state(&state));
+  TEST_ASSERT_EQUAL_INT(PEEP_STATE_MEASURE, state);
+}
+
+static void
+test_no_mount_after_deep_sleep(void)
+{
+  enum peep_state state = PEEP_STATE_UNKNOWN;
+
+  TEST_ASSERT_TRUE(peep_set_state(PEEP_STATE_MEASURE));
+
+  _wake();
+  TEST_ASSERT_EQUAL_INT32(ESP_ERR_INVALID_STATE,
+    esp_vfs_spiffs_unregister(NULL));
+  TEST_ASSERT_TRUE(peep_get_state(&state));
+  TEST_ASSERT_EQUAL_INT(PEEP_STATE_MEASURE, state);
+
+  // Mounted for the first write.
+  TEST_ASSERT_TRUE(peep_set_state(PEEP_STATE_MEASURE_CONFIG));
+  _power_cycle();
+  TEST_ASSERT_TRUE(peep_get_state(&state));
+  TEST_ASSERT_EQUAL_INT(PEEP_STATE_MEASURE_CONFIG, state);
+}
+
+static void
+test_loaded_once(void)
+{
+  char ssid[] = "thesignal";
+  char pass[] = "palmerho";
+  char dst[32] = {0};
+  enum peep_state state = PEEP_STATE_UNKNOWN;
+
+  TEST_ASSERT_TRUE(peep_set_state(PEEP_STATE_MEASURE));
+  TEST_ASSERT_EQUAL_INT32(sizeof(ssid),
+    memory_set_item(MEMORY_ITEM_WIFI_SSID, (uint8_t *) ssid, sizeof(ssid)));
+  TEST_ASSERT_EQUAL_INT32(sizeof(pass),
+    memory_set_item(MEMORY_ITEM_WIFI_PASS, (uint8_t *) pass, sizeof(pass)));
+
+  esp_spiffs_host_reset_stats();
+  // Both copies are read after a power cycle, nothing after deep sleep.
+  _power_cycle();
+  TEST_ASSERT_EQUAL_UINT32(2, esp_spiffs_host_stats()->opens);
+  _wake();
+  TEST_ASSERT_EQUAL_UINT32(2, esp_spiffs_host_stats()->opens);
+
+  esp_spiffs_host_reset_stats();
+  TEST_ASSERT_TRUE(peep_get_state(&state));
+  TEST_ASSERT_EQUAL_INT(PEEP_STATE_MEASURE, state);
+  TEST_ASSERT_EQUAL_INT32(sizeof(ssid),
+    memory_get_item(MEMORY_ITEM_WIFI_SSID, (uint8_t *) dst, sizeof(dst)));
+  TEST_ASSERT_EQUAL_STRING(ssid, dst);
+  TEST_ASSERT_EQUAL_INT32(sizeof(pass),
+    memory_get_item(MEMORY_ITEM_WIFI_PASS, (uint8_t *) dst, sizeof(dst)));
+  TEST_ASSERT_EQUAL_STRING(pass, dst);
+
+  // Same value again, nothing to write.
+  TEST_ASSERT_TRUE(peep_set_state(PEEP_STATE_MEASURE));
+  TEST_ASSERT_EQUAL_UINT32(0, esp_spiffs_host_stats()->opens);
+
+  TEST_ASSERT_TRUE(peep_set_state(PEEP_STATE_MEASURE_CONFIG));
+  TEST_ASSERT_EQUAL_UINT32(1, esp_spiffs_host_stats()->opens);
+}
+
+static void
+test_too_long(void)
+{
+  uint8_t buf[MEMORY_ITEM_LEN_MAX + 1] = {0};
+
+  TEST_ASSERT_TRUE(sizeof(struct hatch_configuration) <= MEMORY_ITEM_LEN_MAX);
+  TEST_ASSERT_EQUAL_INT32(-1,
+    memory_set_item(MEMORY_ITEM_TEST, buf, sizeof(buf)));
+  TEST_ASSERT_EQUAL_INT32(sizeof(buf) - 1,
+    memory_set_item(MEMORY_ITEM_TEST, buf, sizeof(buf) - 1));
+}
+
+static void
+test_migrate(void)
+{
+  enum peep_state state = PEEP_STATE_BLE_CONFIG;
+  char ssid[32] = "thesignal";
+  char dst[32] = {0};
+  FILE * fp = NULL;
+
+  // Files as left behind by older firmware.
+  fp = fopen("/p/state", "w");
+  TEST_ASSERT_NOT_NULL(fp);
+  fwrite(&state, sizeof(state), 1, fp);
+  fclose(fp);
+  fp = fopen("/p/ssid", "w");
+  TEST_ASSERT_NOT_NULL(fp);
+  fwrite(ssid, sizeof(ssid), 1, fp);
+  fclose(fp);
+
+  _power_cycle();
+  state = PEEP_STATE_UNKNOWN;
+  TEST_ASSERT_TRUE(peep_get_state(&state));
+  TEST_ASSERT_EQUAL_INT(PEEP_STATE_BLE_CONFIG, state);
+  TEST_ASSERT_EQUAL_INT32(sizeof(ssid),
+    memory_get_item(MEMORY_ITEM_WIFI_SSID, (uint8_t *) dst, sizeof(dst)));
+  TEST_ASSERT_EQUAL_STRING(ssid, dst);
+  TEST_ASSERT_NULL(fopen("/p/state", "r"));
+
+  // Nothing left to move the next time, only the one settings copy is read.
+  esp_spiffs_host_reset_stats();
+  _power_cycle();
+  TEST_ASSERT_EQUAL_UINT32(1, esp_spiffs_host_stats()->opens);
+  TEST_ASSERT_TRUE(peep_get_state(&state));
+}
+
+static void
+test_corrupt(void)
+{
+  enum peep_state state = PEEP_STATE_UNKNOWN;
+  uint8_t buf[256];
+  uint32_t len = 0;
+  FILE * fp = NULL;
+
+  // The first write goes to the second copy.
+  TEST_ASSERT_TRUE(peep_set_state(PEEP_STATE_MEASURE));
+
+  fp = fopen("/p/settings1", "r");
+  TEST_ASSERT_NOT_NULL(fp);
+  len = fread(buf, 1, sizeof(buf), fp);
+  fclose(fp);
+  buf[len - 5] ^= 0x01;
+  fp = fopen("/p/settings1", "w");
+  TEST_ASSERT_NOT_NULL(fp);
+  fwrite(buf, 1, len, fp);
+  fclose(fp);
+
+  _power_cycle();
+  TEST_ASSERT_FALSE(peep_get_state(&state));
+  TEST_ASSERT_TRUE(peep_set_state(PEEP_STATE_MEASURE));
+  _power_cycle();
+  TEST_ASSERT_TRUE(peep_get_state(&state));
+  TEST_ASSERT_EQUAL_INT(PEEP_STATE_MEASURE, state);
+}
+
+static void
+test_newest_copy_wins(void)
+{
+  enum peep_state state = PEEP_STATE_UNKNOWN;
+
+  TEST_ASSERT_TRUE(peep_set_state(PEEP_STATE_BLE_CONFIG));
+  TEST_ASSERT_TRUE(peep_set_state(PEEP_STATE_MEASURE_CONFIG));
+  TEST_ASSERT_TRUE(peep_set_state(PEEP_STATE_MEASURE));
+
+  _power_cycle();
+  TEST_ASSERT_TRUE(peep_get_state(&state));
+  TEST_ASSERT_EQUAL_INT(PEEP_STATE_MEASURE, state);
+
+  // Keeps alternating after the power cycle.
+  TEST_ASSERT_TRUE(peep_set_state(PEEP_STATE_DEEP_SLEEP));
+  _power_cycle();
+  TEST_ASSERT_TRUE(peep_get_state(&state));
+  TEST_ASSERT_EQUAL_INT(PEEP_STATE_DEEP_SLEEP, state);
+}
+
+static void
+test_malformed_copy(void)
+{
+  enum peep_state state = PEEP_STATE_UNKNOWN;
+  uint8_t buf[256];
+  uint32_t crc = 0;
+  uint32_t len = 0;
+  FILE * fp = NULL;
+
+  TEST_ASSERT_TRUE(peep_set_state(PEEP_STATE_MEASURE));
+  TEST_ASSERT_TRUE(peep_set_state(PEEP_STATE_DEEP_SLEEP));
+  TEST_ASSERT_TRUE(peep_set_state(PEEP_STATE_BLE_CONFIG));
+
+  // The newest copy claims more items than it holds, under a good CRC.
+  fp = fopen("/p/settings1", "r");
+  TEST_ASSERT_NOT_NULL(fp);
+  len = fread(buf, 1, sizeof(buf), fp);
+  fclose(fp);
+  buf[10] += 1;
+  crc = _crc32(buf, len - 4);
+  memcpy(&buf[len - 4], &crc, sizeof(crc));
+  fp = fopen("/p/settings1", "w");
+  TEST_ASSERT_NOT_NULL(fp);
+  fwrite(buf, 1, len, fp);
+  fclose(fp);
+
+  _power_cycle();
+  TEST_ASSERT_TRUE(peep_get_state(&state));
+  TEST_ASSERT_EQUAL_INT(PEEP_STATE_DEEP_SLEEP, state);
+}
+
+static void
+test_power_loss(void)
+{
+  enum peep_state state = PEEP_STATE_UNKNOWN;
+  char ssid[] = "thesignal";
+  char old[] = "palmerho";
+  char new[] = "a much longer password";
+  char dst[64] = {0};
+  uint32_t is_new = 0;
+  uint32_t cut = 0;
+  int32_t len = 0;
+
+  for (cut = 0; cut < 160; cut++) {
+    memory_deinit();
+    esp_spiffs_host_format();
+    TEST_ASSERT_TRUE(memory_init());
+    TEST_ASSERT_TRUE(peep_set_state(PEEP_STATE_MEASURE));
+    TEST_ASSERT_EQUAL_INT32(sizeof(ssid),
+      memory_set_item(MEMORY_ITEM_WIFI_SSID, (uint8_t *) ssid, sizeof(ssid)));
+    TEST_ASSERT_EQUAL_INT32(sizeof(old),
+      memory_set_item(MEMORY_ITEM_WIFI_PASS, (uint8_t *) old, sizeof(old)));
+
+    esp_spiffs_host_set_write_budget(cut);
+    memory_set_item(MEMORY_ITEM_WIFI_PASS, (uint8_t *) new, sizeof(new));
+    esp_spiffs_host_set_write_budget(UINT32_MAX);
+
+    _power_cycle();
+    TEST_ASSERT_TRUE(peep_get_state(&state));
+    TEST_ASSERT_EQUAL_INT(PEEP_STATE_MEASURE, state);
+    TEST_ASSERT_EQUAL_INT32(sizeof(ssid),
+      memory_get_item(MEMORY_ITEM_WIFI_SSID, (uint8_t *) dst, sizeof(dst)));
+    TEST_ASSERT_EQUAL_STRING(ssid, dst);
+    len = memory_get_item(MEMORY_ITEM_WIFI_PASS, (uint8_t *) dst, sizeof(dst));
+    if (sizeof(new) == len) {
+      TEST_ASSERT_EQUAL_STRING(new, dst);
+      is_new++;
+    }
+    else {
+      TEST_ASSERT_EQUAL_INT32(sizeof(old), len);
+      TEST_ASSERT_EQUAL_STRING(old, dst);
+    }
+  }
+
+  // Cuts past the end of the write leave the new password.
+  TEST_ASSERT_TRUE(is_new > 0);
+  TEST_ASSERT_TRUE(is_new < cut);
+}
+
+/***** Global Functions *****/
+
+int
+main(void)
+{
+  UNITY_BEGIN();
+
+  RUN_TEST(test_set_and_get);
+  RUN_TEST(test_missing_and_invalid);
+  RUN_TEST(test_delete);
+  RUN_TEST(test_state);
+  RUN_TEST(test_no_mount_after_deep_sleep);
+  RUN_TEST(test_loaded_once);
+  RUN_TEST(test_too_long);
+  RUN_TEST(test_migrate);
+  RUN_TEST(test_corrupt);
+  RUN_TEST(test_newest_copy_wins);
+  RUN_TEST(test_malformed_copy);
+  RUN_TEST(test_power_loss);
+
+  return UNITY_END();
+}
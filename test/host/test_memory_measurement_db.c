@@ -0,0 +1,463 @@
+/***** Includes *****/
+
+#include <stdio.h>
+
+#include "unity.h"
+#include "esp_partition.h"
+#include "flash_file.h"
+#include "memory_measurement_db.h"
+#include "memory_measurement_stage.h"
+
+/***** Defines *****/
+
+#define _LABEL "measure"
+#define _FILE "build/test_memory_measurement_db.bin"
+#define _FLASH_SIZE (64 * RING_LOG_SECTOR_SIZE)
+#define _START (1546300800)
+#define _INTERVAL (900)
+// Flash of the measurement log, in front of the rollups.
+#define _LOG_SIZE (_FLASH_SIZE - (16 * RING_LOG_SECTOR_SIZE))
+
+/***** Local Data *****/
+
+// The partition file, which the rollup log takes from _LOG_SIZE on.
+static struct ring_log_flash _file_flash;
+
+/***** Local Functions *****/
+
+static struct hatch_measurement
+_make(uint32_t n)
+{
+  struct hatch_measurement meas;
+
+  meas.unix_timestamp = _START + (n * _INTERVAL);
+  meas.temperature = 37.5f + (n % 50) * 0.01f;
+  meas.humidity = 55.0f - (n % 30) * 0.02f;
+  meas.air_pressure = 101325.0f + (n % 20);
+  meas.gas_resistance = 120000.0f + (n % 40) * 100.0f;
+
+  return meas;
+}
+
+static void
+_add(uint32_t first, uint32_t total)
+{
+  struct hatch_measurement meas;
+  uint32_t n = 0;
+
+  for (n = first; n < (first + total); n++) {
+    meas = _make(n);
+    TEST_ASSERT_TRUE(memory_measurement_db_add(&meas));
+  }
+}
+
+static void
+_expect_next(uint32_t n)
+{
+  struct hatch_measurement expect = _make(n);
+  struct hatch_measurement meas;
+
+  TEST_ASSERT_TRUE(memory_measurement_db_read_entry(&meas));
+  TEST_ASSERT_EQUAL_UINT32(expect.unix_timestamp, meas.unix_timestamp);
+  TEST_ASSERT_FLOAT_WITHIN(0.0051f, expect.temperature, meas.temperature);
+  TEST_ASSERT_FLOAT_WITHIN(0.0051f, expect.humidity, meas.humidity);
+  TEST_ASSERT_FLOAT_WITHIN(0.51f, expect.air_pressure, meas.air_pressure);
+}
+
+static void
+_expect_end(void)
+{
+  struct hatch_measurement meas;
+
+  TEST_ASSERT_FALSE(memory_measurement_db_read_entry(&meas));
+}
+
+/***** Unit Tests *****/
+
+void
+setUp(void)
+{
+  remove(_FILE);
+  TEST_ASSERT_TRUE(esp_partition_host_add(_LABEL, _FILE, _FLASH_SIZE));
+  TEST_ASSERT_TRUE(memory_measurement_db_init());
+  // Staged measurements live on from the previous test like RTC memory.
+  TEST_ASSERT_TRUE(memory_measurement_db_delete_all());
+}
+
+void
+tearDown(void)
+{
+  esp_partition_host_remove_all();
+}
+
+static void
+test_add_and_read(void)
+{
+  struct hatch_measurement meas[40];
+  uint32_t total = 0;
+  uint32_t n = 0;
+
+  _add(0, 1000);
+  TEST_ASSERT_EQUAL_UINT32(1000, memory_measurement_db_total());
+
+  TEST_ASSERT_TRUE(memory_measurement_db_read_open());
+  for (n = 0; n < 500; n++) {
+    _expect_next(n);
+  }
+  while (memory_measurement_db_read_batch(meas, 40, &total)) {
+    TEST_ASSERT_EQUAL_UINT32(_make(n).unix_timestamp, meas[0].unix_timestamp);
+    n += total;
+  }
+  TEST_ASSERT_EQUAL_UINT32(1000, n);
+  TEST_ASSERT_TRUE(memory_measurement_db_read_close());
+}
+
+static void
+test_staged_until_full(void)
+{
+  struct flash_file * ff = esp_partition_host_flash(_LABEL);
+  uint32_t n = 0;
+
+  flash_file_reset_stats(ff);
+  _add(0, MEMORY_MEASUREMENT_STAGE_LEN - 1);
+  TEST_ASSERT_EQUAL_UINT32(0, ff->write_ops);
+
+  // A wake from deep sleep keeps them.
+  TEST_ASSERT_TRUE(memory_measurement_db_init());
+  TEST_ASSERT_EQUAL_UINT32(MEMORY_MEASUREMENT_STAGE_LEN - 1,
+    memory_measurement_db_total());
+
+  _add(MEMORY_MEASUREMENT_STAGE_LEN - 1, 1);
+  TEST_ASSERT_EQUAL_UINT32(1, ff->write_ops);
+
+  _add(MEMORY_MEASUREMENT_STAGE_LEN, 3);
+  TEST_ASSERT_TRUE(memory_measurement_db_read_open());
+  for (n = 0; n < (MEMORY_MEASUREMENT_STAGE_LEN + 3); n++) {
+    _expect_next(n);
+  }
+  _expect_end();
+  TEST_ASSERT_TRUE(memory_measurement_db_read_close());
+}
+
+static void
+test_seek_time(void)
+{
+  TEST_ASSERT_TRUE(memory_measurement_db_read_open());
+  TEST_ASSERT_TRUE(memory_measurement_db_seek_time(_START));
+  _expect_end();
+  TEST_ASSERT_TRUE(memory_measurement_db_read_close());
+
+  _add(0, 5000);
+  TEST_ASSERT_TRUE(memory_measurement_db_read_open());
+
+  TEST_ASSERT_TRUE(memory_measurement_db_seek_time(0));
+  _expect_next(0);
+
+  TEST_ASSERT_TRUE(memory_measurement_db_seek_time(_make(1234).unix_timestamp));
+  _expect_next(1234);
+  _expect_next(1235);
+
+  TEST_ASSERT_TRUE(
+    memory_measurement_db_seek_time(_make(4000).unix_timestamp - 1));
+  _expect_next(4000);
+
+  TEST_ASSERT_TRUE(memory_measurement_db_seek_time(_make(4999).unix_timestamp));
+  _expect_next(4999);
+  _expect_end();
+
+  TEST_ASSERT_TRUE(
+    memory_measurement_db_seek_time(_make(4999).unix_timestamp + 1));
+  _expect_end();
+
+  // Measurements that were already removed are not found again.
+  TEST_ASSERT_TRUE(memory_measurement_db_delete_oldest(777));
+  TEST_ASSERT_TRUE(memory_measurement_db_seek_time(_make(100).unix_timestamp));
+  _expect_next(777);
+
+  TEST_ASSERT_TRUE(memory_measurement_db_read_close());
+}
+
+static void
+test_delete_oldest_while_reading(void)
+{
+  uint32_t n = 0;
+
+  _add(0, 300);
+  TEST_ASSERT_TRUE(memory_measurement_db_read_open());
+  for (n = 0; n < 200; n++) {
+    _expect_next(n);
+    if (15 == (n % 16)) {
+      TEST_ASSERT_TRUE(memory_measurement_db_delete_oldest(16));
+    }
+  }
+  TEST_ASSERT_TRUE(memory_measurement_db_read_close());
+  TEST_ASSERT_EQUAL_UINT32(300 - 192, memory_measurement_db_total());
+
+  TEST_ASSERT_TRUE(memory_measurement_db_init());
+  TEST_ASSERT_TRUE(memory_measurement_db_read_open());
+  for (n = 192; n < 300; n++) {
+    _expect_next(n);
+  }
+  _expect_end();
+  TEST_ASSERT_TRUE(memory_measurement_db_read_close());
+}
+
+static void
+test_uploaded_survives_init(void)
+{
+  uint32_t from = 1;
+  uint32_t until = 1;
+
+  TEST_ASSERT_TRUE(memory_measurement_db_uploaded_get(&from, &until));
+  TEST_ASSERT_EQUAL_UINT32(0, from);
+  TEST_ASSERT_EQUAL_UINT32(0, until);
+
+  _add(0, 100);
+  TEST_ASSERT_TRUE(
+    memory_measurement_db_uploaded_set(_START + 40, _START + 99));
+
+  // A power cycle keeps it, removing every measurement does not.
+  TEST_ASSERT_TRUE(memory_measurement_db_init());
+  TEST_ASSERT_TRUE(memory_measurement_db_uploaded_get(&from, &until));
+  TEST_ASSERT_EQUAL_UINT32(_START + 40, from);
+  TEST_ASSERT_EQUAL_UINT32(_START + 99, until);
+
+  TEST_ASSERT_TRUE(memory_measurement_db_delete_all());
+  TEST_ASSERT_TRUE(memory_measurement_db_uploaded_get(&from, &until));
+  TEST_ASSERT_EQUAL_UINT32(0, from);
+  TEST_ASSERT_EQUAL_UINT32(0, until);
+}
+
+// Store measurements first to first + 99 with total records that have a good
+// CRC but are no measurement in the middle.
+static void
+_add_with_bad(uint32_t first, uint32_t total)
+{
+  struct ring_log_flash flash;
+  struct ring_log log;
+  uint8_t bad = 0xFF;
+  uint32_t n = 0;
+
+  _add(first, 50);
+  TEST_ASSERT_TRUE(memory_measurement_db_read_open());
+  TEST_ASSERT_TRUE(memory_measurement_db_read_close());
+
+  flash_file_get(esp_partition_host_flash(_LABEL), &flash);
+  flash.size = _LOG_SIZE;
+  TEST_ASSERT_TRUE(ring_log_init(&log, &flash));
+  TEST_ASSERT_TRUE(ring_log_mount(&log));
+  for (n = 0; n < total; n++) {
+    TEST_ASSERT_TRUE(ring_log_append(&log, &bad, sizeof(bad)));
+  }
+  TEST_ASSERT_TRUE(memory_measurement_db_init());
+  _add(first + 50, 50);
+}
+
+static bool
+_rollup_flash_read(void * ctx, uint32_t addr, void * dst, uint32_t len)
+{
+  return _file_flash.read(ctx, _LOG_SIZE + addr, dst, len);
+}
+
+static bool
+_rollup_flash_write(void * ctx, uint32_t addr, const void * src, uint32_t len)
+{
+  return _file_flash.write(ctx, _LOG_SIZE + addr, src, len);
+}
+
+static bool
+_rollup_flash_erase(void * ctx, uint32_t addr, uint32_t len)
+{
+  return _file_flash.erase(ctx, _LOG_SIZE + addr, len);
+}
+
+// Append total rollups, one an hour from _START, each after bad_after[n]
+// records of the wrong length and the last bad_after[total] before the end,
+// through a second handle on the rollup log.
+static void
+_add_rollups_with_bad(uint32_t total, const uint32_t * bad_after)
+{
+  struct hatch_measurement_rollup rollup;
+  struct ring_log_flash flash;
+  struct ring_log log;
+  uint8_t bad = 0xFF;
+  uint32_t n = 0;
+  uint32_t i = 0;
+
+  flash_file_get(esp_partition_host_flash(_LABEL), &_file_flash);
+  flash = _file_flash;
+  flash.read = _rollup_flash_read;
+  flash.write = _rollup_flash_write;
+  flash.erase = _rollup_flash_erase;
+  flash.size = _FLASH_SIZE - _LOG_SIZE;
+  TEST_ASSERT_TRUE(ring_log_init(&log, &flash));
+  TEST_ASSERT_TRUE(ring_log_mount(&log));
+
+  for (n = 0; n <= total; n++) {
+    for (i = 0; i < bad_after[n]; i++) {
+      TEST_ASSERT_TRUE(ring_log_append(&log, &bad, sizeof(bad)));
+    }
+    if (n < total) {
+      hatch_measurement_rollup_init(&rollup, _START + (n * 3600), 3600);
+      TEST_ASSERT_TRUE(ring_log_append(&log, &rollup, sizeof(rollup)));
+    }
+  }
+  TEST_ASSERT_TRUE(memory_measurement_db_init());
+}
+
+static void
+test_undecodable_record(void)
+{
+  struct hatch_measurement meas[40];
+  uint32_t total = 0;
+  uint32_t n = 0;
+
+  _add_with_bad(0, 1);
+  _add(100, 100);
+  TEST_ASSERT_EQUAL_UINT32(201, memory_measurement_db_total());
+
+  // Acknowledging everything read leaves nothing behind.
+  TEST_ASSERT_TRUE(memory_measurement_db_read_open());
+  while (memory_measurement_db_read_batch(meas, 40, &total)) {
+    TEST_ASSERT_EQUAL_UINT32(_make(n).unix_timestamp, meas[0].unix_timestamp);
+    TEST_ASSERT_EQUAL_UINT32(_make(n + total - 1).unix_timestamp,
+      meas[total - 1].unix_timestamp);
+    TEST_ASSERT_TRUE(memory_measurement_db_delete_oldest(total));
+    n += total;
+  }
+  TEST_ASSERT_TRUE(memory_measurement_db_read_close());
+  TEST_ASSERT_EQUAL_UINT32(200, n);
+  TEST_ASSERT_EQUAL_UINT32(0, memory_measurement_db_total());
+}
+
+static void
+test_many_undecodable_records(void)
+{
+  struct hatch_measurement meas[40];
+  uint32_t total = 0;
+  uint32_t n = 0;
+
+  _add_with_bad(0, 70);
+
+  // Reading from the oldest measurement stops short of the newest once too
+  // many records were passed over with nothing deleted.
+  TEST_ASSERT_TRUE(memory_measurement_db_read_open());
+  while (memory_measurement_db_read_batch(meas, 40, &total)) {
+    n += total;
+  }
+  TEST_ASSERT_EQUAL_UINT32(50, n);
+  TEST_ASSERT_FALSE(memory_measurement_db_read_is_end());
+
+  // Reading from later on, nothing can be deleted and nothing stops it.
+  n = 0;
+  TEST_ASSERT_TRUE(memory_measurement_db_seek_time(_make(10).unix_timestamp));
+  while (memory_measurement_db_read_batch(meas, 40, &total)) {
+    TEST_ASSERT_EQUAL_UINT32(_make(n + 10).unix_timestamp,
+      meas[0].unix_timestamp);
+    n += total;
+  }
+  TEST_ASSERT_EQUAL_UINT32(90, n);
+  TEST_ASSERT_TRUE(memory_measurement_db_read_is_end());
+  TEST_ASSERT_TRUE(memory_measurement_db_read_close());
+
+  // Deleting as it goes, everything is read and nothing left behind.
+  n = 0;
+  TEST_ASSERT_TRUE(memory_measurement_db_read_open());
+  while (memory_measurement_db_read_batch(meas, 40, &total)) {
+    TEST_ASSERT_TRUE(memory_measurement_db_delete_oldest(total));
+    n += total;
+  }
+  TEST_ASSERT_EQUAL_UINT32(100, n);
+  TEST_ASSERT_TRUE(memory_measurement_db_read_is_end());
+  TEST_ASSERT_TRUE(memory_measurement_db_read_close());
+  TEST_ASSERT_EQUAL_UINT32(0, memory_measurement_db_total());
+}
+
+static void
+test_rollup_wrong_length(void)
+{
+  // Records of the wrong length ahead of, between and after the rollups, more
+  // ahead than a read can pass over.
+  const uint32_t bad_after[11] = {70, 0, 0, 1, 0, 0, 2, 0, 0, 0, 1};
+  struct hatch_measurement_rollup rollup[4];
+  uint32_t total = 0;
+  uint32_t n = 0;
+
+  _add_rollups_with_bad(10, bad_after);
+  TEST_ASSERT_EQUAL_UINT32(84, memory_measurement_db_rollup_total());
+
+  // Rollups acknowledged a few at a time are deleted with the records around
+  // them, so each is read once and nothing is left behind.
+  while (memory_measurement_db_rollup_read(rollup, 4, &total)) {
+    TEST_ASSERT_EQUAL_UINT32(_START + (n * 3600), rollup[0].unix_timestamp);
+    TEST_ASSERT_EQUAL_UINT32(_START + ((n + total - 1) * 3600),
+      rollup[total - 1].unix_timestamp);
+    TEST_ASSERT_TRUE(memory_measurement_db_rollup_delete_oldest(1));
+    TEST_ASSERT_TRUE(memory_measurement_db_rollup_delete_oldest(total - 1));
+    n += total;
+  }
+  TEST_ASSERT_EQUAL_UINT32(10, n);
+  TEST_ASSERT_EQUAL_UINT32(0, memory_measurement_db_rollup_total());
+}
+
+static void
+test_compact_when_full(void)
+{
+  struct hatch_measurement_rollup rollup[16];
+  struct hatch_measurement meas;
+  uint32_t samples = 0;
+  uint32_t last = 0;
+  uint32_t total = 0;
+  uint32_t n = 0;
+
+  // One measurement a minute for two weeks is more than the log holds.
+  for (n = 0; n < (14 * 24 * 60); n++) {
+    meas = _make(n);
+    meas.unix_timestamp = _START + (n * 60);
+    TEST_ASSERT_TRUE(memory_measurement_db_add(&meas));
+  }
+
+  // Whatever was not kept is summed up in full hours, right up to the oldest
+  // measurement kept, and the last day is all there.
+  TEST_ASSERT_TRUE(memory_measurement_db_rollup_total() > 0);
+  last = _START;
+  while (memory_measurement_db_rollup_read(rollup, 16, &total)) {
+    for (n = 0; n < total; n++) {
+      TEST_ASSERT_EQUAL_UINT32(last, rollup[n].unix_timestamp);
+      TEST_ASSERT_EQUAL_UINT32(60, rollup[n].samples);
+      TEST_ASSERT_EQUAL_FLOAT(37.5f, rollup[n].temperature.min);
+      last += rollup[n].period_sec;
+      samples += rollup[n].samples;
+    }
+    TEST_ASSERT_TRUE(memory_measurement_db_rollup_delete_oldest(total));
+  }
+
+  TEST_ASSERT_TRUE(memory_measurement_db_read_open());
+  TEST_ASSERT_TRUE(memory_measurement_db_read_entry(&meas));
+  TEST_ASSERT_EQUAL_UINT32(last, meas.unix_timestamp);
+  TEST_ASSERT_TRUE(memory_measurement_db_read_close());
+
+  TEST_ASSERT_EQUAL_UINT32(14 * 24 * 60,
+    samples + memory_measurement_db_total());
+  TEST_ASSERT_TRUE(memory_measurement_db_total() >= (24 * 60));
+}
+
+/***** Global Functions *****/
+
+int
+main(void)
+{
+  UNITY_BEGIN();
+
+  RUN_TEST(test_add_and_read);
+  RUN_TEST(test_staged_until_full);
+  RUN_TEST(test_seek_time);
+  RUN_TEST(test_delete_oldest_while_reading);
+  RUN_TEST(test_uploaded_survives_init);
+  RUN_TEST(test_undecodable_record);
+  RUN_TEST(test_many_undecodable_records);
+  RUN_TEST(test_rollup_wrong_length);
+  RUN_TEST(test_compact_when_full);
+
+  return UNITY_END();
+}
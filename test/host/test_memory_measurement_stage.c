@@ -0,0 +1,116 @@
+/***** Includes *****/
+
+#include <string.h>
+
+#include "unity.h"
+#include "memory_measurement_stage.h"
+
+/***** Local Data *****/
+
+static struct memory_measurement_stage _stage;
+
+/***** Local Functions *****/
+
+static struct hatch_measurement
+_make(uint32_t n)
+{
+  struct hatch_measurement meas;
+
+  meas.unix_timestamp = 1546300800 + (n * 900);
+  meas.temperature = 37.5f + n;
+  meas.humidity = 55.0f - n;
+  meas.air_pressure = 101325.0f + n;
+  meas.gas_resistance = 120000.0f + n;
+
+  return meas;
+}
+
+/***** Unit Tests *****/
+
+void
+setUp(void)
+{
+  // RTC memory holds garbage after a power on.
+  memset(&_stage, 0xA5, sizeof(_stage));
+}
+
+void
+tearDown(void)
+{
+}
+
+static void
+test_garbage_is_cleared(void)
+{
+  TEST_ASSERT_EQUAL_UINT32(0, memory_measurement_stage_init(&_stage));
+  TEST_ASSERT_EQUAL_UINT32(0, memory_measurement_stage_total(&_stage));
+  TEST_ASSERT_FALSE(memory_measurement_stage_is_full(&_stage));
+  TEST_ASSERT_NULL(memory_measurement_stage_get(&_stage, 0));
+}
+
+static void
+test_survives_init(void)
+{
+  struct hatch_measurement meas;
+  uint32_t n = 0;
+
+  memory_measurement_stage_init(&_stage);
+  for (n = 0; n < 5; n++) {
+    meas = _make(n);
+    TEST_ASSERT_TRUE(memory_measurement_stage_add(&_stage, &meas));
+  }
+
+  // Waking up from deep sleep keeps what was staged.
+  TEST_ASSERT_EQUAL_UINT32(5, memory_measurement_stage_init(&_stage));
+  for (n = 0; n < 5; n++) {
+    meas = _make(n);
+    TEST_ASSERT_EQUAL_MEMORY(&meas, memory_measurement_stage_get(&_stage, n),
+      sizeof(meas));
+  }
+}
+
+static void
+test_full(void)
+{
+  struct hatch_measurement meas;
+  uint32_t n = 0;
+
+  memory_measurement_stage_init(&_stage);
+  for (n = 0; n < MEMORY_MEASUREMENT_STAGE_LEN; n++) {
+    TEST_ASSERT_FALSE(memory_measurement_stage_is_full(&_stage));
+    meas = _make(n);
+    TEST_ASSERT_TRUE(memory_measurement_stage_add(&_stage, &meas));
+  }
+
+  TEST_ASSERT_TRUE(memory_measurement_stage_is_full(&_stage));
+  TEST_ASSERT_FALSE(memory_measurement_stage_add(&_stage, &meas));
+  TEST_ASSERT_EQUAL_UINT32(MEMORY_MEASUREMENT_STAGE_LEN,
+    memory_measurement_stage_total(&_stage));
+
+  memory_measurement_stage_clear(&_stage);
+  TEST_ASSERT_EQUAL_UINT32(0, memory_measurement_stage_init(&_stage));
+  TEST_ASSERT_TRUE(memory_measurement_stage_add(&_stage, &meas));
+}
+
+static void
+test_bad_total_is_cleared(void)
+{
+  memory_measurement_stage_init(&_stage);
+  _stage.total = MEMORY_MEASUREMENT_STAGE_LEN + 1;
+  TEST_ASSERT_EQUAL_UINT32(0, memory_measurement_stage_init(&_stage));
+}
+
+/***** Global Functions *****/
+
+int
+main(void)
+{
+  UNITY_BEGIN();
+
+  RUN_TEST(test_garbage_is_cleared);
+  RUN_TEST(test_survives_init);
+  RUN_TEST(test_full);
+  RUN_TEST(test_bad_total_is_cleared);
+
+  return UNITY_END();
+}
@@ -0,0 +1,479 @@
+/***** Includes *****/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "unity.h"
+#include "flash_file.h"
+#include "ring_log.h"
+
+/***** Defines *****/
+
+#define _FILE "build/test_ring_log.bin"
+#define _FLASH_SIZE (16 * RING_LOG_SECTOR_SIZE)
+
+/***** Local Data *****/
+
+static struct flash_file _ff;
+static struct ring_log_flash _flash;
+static struct ring_log _log;
+
+/***** Local Functions *****/
+
+// Records of varying length whose content identifies them.
+static uint32_t
+_make(uint8_t * rec, uint32_t n)
+{
+  uint32_t len = 4 + (n % 13);
+  uint32_t i = 0;
+
+  memcpy(rec, &n, sizeof(n));
+  for (i = sizeof(n); i < len; i++) {
+    rec[i] = (uint8_t) (n + i);
+  }
+
+  return len;
+}
+
+static void
+_remount(void)
+{
+  TEST_ASSERT_TRUE(ring_log_init(&_log, &_flash));
+  TEST_ASSERT_TRUE(ring_log_mount(&_log));
+}
+
+static void
+_append(uint32_t first, uint32_t total)
+{
+  uint8_t rec[RING_LOG_RECORD_LEN_MAX];
+  uint32_t len = 0;
+  uint32_t n = 0;
+
+  for (n = first; n < (first + total); n++) {
+    len = _make(rec, n);
+    TEST_ASSERT_TRUE(ring_log_append(&_log, rec, len));
+  }
+}
+
+static void
+_expect_next(uint32_t n)
+{
+  uint8_t rec[RING_LOG_RECORD_LEN_MAX];
+  uint8_t expect[RING_LOG_RECORD_LEN_MAX];
+  uint32_t expect_len = 0;
+  uint32_t len = 0;
+
+  expect_len = _make(expect, n);
+  TEST_ASSERT_TRUE(ring_log_read_next(&_log, rec, &len));
+  TEST_ASSERT_EQUAL_UINT32(expect_len, len);
+  TEST_ASSERT_EQUAL_MEMORY(expect, rec, len);
+}
+
+static void
+_expect(uint32_t first, uint32_t total)
+{
+  uint8_t rec[RING_LOG_RECORD_LEN_MAX];
+  uint32_t len = 0;
+  uint32_t n = 0;
+
+  TEST_ASSERT_EQUAL_UINT32(total, ring_log_count(&_log));
+
+  ring_log_read_rewind(&_log);
+  for (n = first; n < (first + total); n++) {
+    _expect_next(n);
+  }
+  TEST_ASSERT_FALSE(ring_log_read_next(&_log, rec, &len));
+}
+
+/***** Unit Tests *****/
+
+void
+setUp(void)
+{
+  remove(_FILE);
+  TEST_ASSERT_TRUE(flash_file_open(&_ff, _FILE, _FLASH_SIZE));
+  flash_file_get(&_ff, &_flash);
+  TEST_ASSERT_TRUE(ring_log_init(&_log, &_flash));
+}
+
+void
+tearDown(void)
+{
+  flash_file_close(&_ff);
+}
+
+static void
+test_mount_blank_fails(void)
+{
+  TEST_ASSERT_FALSE(ring_log_mount(&_log));
+  TEST_ASSERT_TRUE(ring_log_format(&_log));
+  _remount();
+  TEST_ASSERT_EQUAL_UINT32(0, ring_log_count(&_log));
+}
+
+static void
+test_append_survives_remount(void)
+{
+  TEST_ASSERT_TRUE(ring_log_format(&_log));
+  _append(0, 500);
+  _expect(0, 500);
+
+  _remount();
+  _expect(0, 500);
+
+  _append(500, 10);
+  _remount();
+  _expect(0, 510);
+}
+
+static void
+test_wrap_drops_oldest(void)
+{
+  uint32_t capacity = 0;
+  uint32_t total = 0;
+  uint32_t count = 0;
+
+  TEST_ASSERT_TRUE(ring_log_format(&_log));
+  // Largest test record plus its framing.
+  capacity = ring_log_capacity(&_log) / (16 + RING_LOG_FRAME_OVERHEAD);
+  total = capacity * 3 + 17;
+  _append(0, total);
+
+  count = ring_log_count(&_log);
+  TEST_ASSERT_TRUE(count >= capacity);
+  _expect(total - count, count);
+
+  _remount();
+  _expect(total - count, count);
+}
+
+static void
+test_erase_is_bounded(void)
+{
+  uint8_t rec[RING_LOG_RECORD_LEN_MAX];
+  uint32_t n = 0;
+
+  TEST_ASSERT_TRUE(ring_log_format(&_log));
+  flash_file_reset_stats(&_ff);
+
+  // Appends within a sector never erase, crossing into the next one erases
+  // it plus at most one meta sector.
+  memset(rec, 0, sizeof(rec));
+  for (n = 0; n < ((RING_LOG_SECTOR_SIZE / 16) - 1); n++) {
+    TEST_ASSERT_TRUE(ring_log_append(&_log, rec, 16 - RING_LOG_FRAME_OVERHEAD));
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, _ff.erase_ops);
+  TEST_ASSERT_FALSE(ring_log_is_sector_start(&_log, 16 - RING_LOG_FRAME_OVERHEAD));
+  TEST_ASSERT_TRUE(ring_log_is_sector_start(&_log, 17 - RING_LOG_FRAME_OVERHEAD));
+  TEST_ASSERT_TRUE(ring_log_append(&_log, rec, 17 - RING_LOG_FRAME_OVERHEAD));
+  TEST_ASSERT_TRUE(_ff.erase_ops <= 2);
+}
+
+static void
+test_clear(void)
+{
+  TEST_ASSERT_TRUE(ring_log_format(&_log));
+  _append(0, 300);
+  TEST_ASSERT_TRUE(ring_log_clear(&_log));
+  TEST_ASSERT_EQUAL_UINT32(0, ring_log_count(&_log));
+
+  _remount();
+  TEST_ASSERT_EQUAL_UINT32(0, ring_log_count(&_log));
+
+  _append(300, 5);
+  _remount();
+  _expect(300, 5);
+}
+
+static void
+test_user_words(void)
+{
+  uint32_t user[RING_LOG_USER_LEN];
+  uint32_t n = 0;
+
+  TEST_ASSERT_TRUE(ring_log_format(&_log));
+  ring_log_user_get(&_log, user);
+  for (n = 0; n < RING_LOG_USER_LEN; n++) {
+    TEST_ASSERT_EQUAL_UINT32(0, user[n]);
+    user[n] = n + 1;
+  }
+  TEST_ASSERT_TRUE(ring_log_user_set(&_log, user));
+
+  // Setting them again unchanged writes nothing.
+  flash_file_reset_stats(&_ff);
+  TEST_ASSERT_TRUE(ring_log_user_set(&_log, user));
+  TEST_ASSERT_EQUAL_UINT32(0, _ff.write_ops);
+
+  _append(0, 300);
+  TEST_ASSERT_TRUE(ring_log_clear(&_log));
+  _remount();
+  memset(user, 0, sizeof(user));
+  ring_log_user_get(&_log, user);
+  for (n = 0; n < RING_LOG_USER_LEN; n++) {
+    TEST_ASSERT_EQUAL_UINT32(n + 1, user[n]);
+  }
+}
+
+static void
+test_discard_while_reading(void)
+{
+  uint8_t rec[RING_LOG_RECORD_LEN_MAX];
+  uint32_t len = 0;
+  uint32_t n = 0;
+
+  TEST_ASSERT_TRUE(ring_log_format(&_log));
+  _append(0, 1000);
+
+  // Acknowledge in batches as an uploader would, then lose power mid way.
+  ring_log_read_rewind(&_log);
+  for (n = 0; n < 600; n++) {
+    _expect_next(n);
+    if (15 == (n % 16)) {
+      TEST_ASSERT_TRUE(ring_log_discard(&_log, 16));
+    }
+  }
+
+  _remount();
+  _expect(592, 408);
+
+  // Discarding more than was read moves the cursor along with the tail.
+  ring_log_read_rewind(&_log);
+  _expect_next(592);
+  TEST_ASSERT_TRUE(ring_log_discard(&_log, 8));
+  _expect_next(600);
+
+  TEST_ASSERT_TRUE(ring_log_discard(&_log, 1000));
+  TEST_ASSERT_EQUAL_UINT32(0, ring_log_count(&_log));
+  TEST_ASSERT_FALSE(ring_log_read_next(&_log, rec, &len));
+}
+
+static void
+test_read_at(void)
+{
+  struct ring_log_pos pos = {0, 0};
+  struct ring_log_pos head;
+  uint8_t rec[RING_LOG_RECORD_LEN_MAX];
+  uint8_t expect[RING_LOG_RECORD_LEN_MAX];
+  uint32_t len = 0;
+  uint32_t n = 0;
+
+  TEST_ASSERT_TRUE(ring_log_format(&_log));
+  _append(0, 700);
+  head = ring_log_head(&_log);
+
+  for (n = 0; (pos.sector != head.sector) || (pos.offset != head.offset); n++) {
+    TEST_ASSERT_TRUE(ring_log_read_at(&_log, &pos, rec, &len));
+    TEST_ASSERT_EQUAL_UINT32(_make(expect, n), len);
+    TEST_ASSERT_EQUAL_MEMORY(expect, rec, len);
+  }
+  TEST_ASSERT_EQUAL_UINT32(700, n);
+}
+
+static void
+test_read_frames(void)
+{
+  uint8_t buf[RING_LOG_SECTOR_SIZE];
+  uint8_t expect[RING_LOG_RECORD_LEN_MAX];
+  uint32_t expect_len = 0;
+  uint32_t total = 0;
+  uint32_t len = 0;
+  uint32_t i = 0;
+  uint32_t n = 0;
+
+  TEST_ASSERT_TRUE(ring_log_format(&_log));
+  _append(0, 2000);
+
+  // Odd buffer sizes and limits, mixed with single reads, visit every record
+  // once and in order.
+  ring_log_read_rewind(&_log);
+  while (n < 2000) {
+    if (0 == (n % 7)) {
+      _expect_next(n++);
+      continue;
+    }
+    TEST_ASSERT_TRUE(ring_log_read_frames(&_log, buf, 100 + (n % 300),
+      1 + (n % 50), &len, &total));
+    TEST_ASSERT_TRUE(total <= (1 + (n % 50)));
+    for (i = 0; i < len; i += buf[i] + 1) {
+      expect_len = _make(expect, n++);
+      TEST_ASSERT_EQUAL_UINT32(expect_len, buf[i]);
+      TEST_ASSERT_EQUAL_MEMORY(expect, &buf[i + 1], expect_len);
+      total--;
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, total);
+  }
+  TEST_ASSERT_FALSE(ring_log_read_frames(&_log, buf, sizeof(buf), 10, &len,
+    &total));
+
+  // Too small for the next record.
+  ring_log_read_rewind(&_log);
+  TEST_ASSERT_FALSE(ring_log_read_frames(&_log, buf, 4, 10, &len, &total));
+  _expect_next(0);
+}
+
+static void
+test_append_pending(void)
+{
+  uint32_t n = 0;
+
+  TEST_ASSERT_TRUE(ring_log_format(&_log));
+  _append(0, 10);
+
+  // Collected appends cost a write per RING_LOG_PENDING_LEN bytes or sector
+  // change, and read back like any others.
+  for (n = 10; n < 1000; n += 50) {
+    flash_file_reset_stats(&_ff);
+    ring_log_append_begin(&_log);
+    _append(n, 50);
+    TEST_ASSERT_TRUE(ring_log_append_end(&_log));
+    TEST_ASSERT_TRUE(_ff.write_ops <= 8);
+  }
+  _expect(0, n);
+
+  _remount();
+  _expect(0, n);
+}
+
+static void
+test_append_pending_fails(void)
+{
+  TEST_ASSERT_TRUE(ring_log_format(&_log));
+  _append(0, 10);
+
+  // Nothing is written until the end, a failure then drops all of them.
+  ring_log_append_begin(&_log);
+  _append(10, 5);
+  _ff.write_budget = 3;
+  TEST_ASSERT_FALSE(ring_log_append_end(&_log));
+  _ff.write_budget = UINT32_MAX;
+  _expect(0, 10);
+
+  _remount();
+  _expect(0, 10);
+  _append(10, 5);
+  _remount();
+  _expect(0, 15);
+}
+
+static void
+test_append_fails(void)
+{
+  uint8_t rec[RING_LOG_RECORD_LEN_MAX];
+  uint32_t len = 0;
+
+  TEST_ASSERT_TRUE(ring_log_format(&_log));
+  _append(0, 10);
+
+  // The next appends must not land on the bytes a failed write left behind.
+  _ff.write_budget = 3;
+  len = _make(rec, 1000);
+  TEST_ASSERT_FALSE(ring_log_append(&_log, rec, len));
+  _ff.write_budget = UINT32_MAX;
+  _append(10, 5);
+  _expect(0, 15);
+
+  ring_log_append_begin(&_log);
+  _append(1000, 5);
+  _ff.write_budget = 3;
+  TEST_ASSERT_FALSE(ring_log_append_end(&_log));
+  _ff.write_budget = UINT32_MAX;
+  _append(15, 5);
+  _expect(0, 20);
+
+  _remount();
+  _expect(0, 20);
+}
+
+static void
+test_mount_is_bounded(void)
+{
+  TEST_ASSERT_TRUE(ring_log_format(&_log));
+  _append(0, 5000);
+
+  // Meta sectors plus one pass over the head sector, however full the log.
+  flash_file_reset_stats(&_ff);
+  _remount();
+  TEST_ASSERT_TRUE(_ff.read_bytes <=
+    ((RING_LOG_META_SECTORS + 2) * RING_LOG_SECTOR_SIZE));
+}
+
+static void
+test_power_loss(void)
+{
+  uint32_t prefix = 0;
+  uint32_t total = 0;
+  uint32_t cut = 0;
+  uint32_t done = 0;
+  uint8_t rec[RING_LOG_RECORD_LEN_MAX];
+  uint32_t len = 0;
+
+  // Fill the first sector almost up, so the appends under test also move the
+  // head into the next sector and commit the header.
+  TEST_ASSERT_TRUE(ring_log_format(&_log));
+  while (ring_log_head(&_log).offset < (RING_LOG_SECTOR_SIZE - 100)) {
+    _append(prefix++, 1);
+  }
+  flash_file_reset_stats(&_ff);
+  _append(prefix, 20);
+  total = _ff.write_bytes;
+
+  // Cut the power at every byte written and check that each time exactly the
+  // appends that completed are there after a reset, and the log still works.
+  for (cut = 0; cut < total; cut++) {
+    TEST_ASSERT_TRUE(ring_log_format(&_log));
+    _append(0, prefix);
+
+    _ff.write_budget = cut;
+    for (done = 0; done < 20; done++) {
+      len = _make(rec, prefix + done);
+      if (!ring_log_append(&_log, rec, len)) {
+        break;
+      }
+    }
+    TEST_ASSERT_TRUE(done < 20);
+    _ff.write_budget = UINT32_MAX;
+
+    _remount();
+    _expect(0, prefix + done);
+
+    _append(prefix + done, 5);
+    _remount();
+    _expect(0, prefix + done + 5);
+  }
+}
+
+static void
+test_oversize_record(void)
+{
+  uint8_t rec[RING_LOG_RECORD_LEN_MAX + 1];
+
+  memset(rec, 0, sizeof(rec));
+  TEST_ASSERT_TRUE(ring_log_format(&_log));
+  TEST_ASSERT_FALSE(ring_log_append(&_log, rec, 0));
+  TEST_ASSERT_FALSE(ring_log_append(&_log, rec, sizeof(rec)));
+  TEST_ASSERT_EQUAL_UINT32(0, ring_log_count(&_log));
+}
+
+/***** Global Functions *****/
+
+int
+main(void)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_mount_blank_fails);
+  RUN_TEST(test_append_survives_remount);
+  RUN_TEST(test_wrap_drops_oldest);
+  RUN_TEST(test_erase_is_bounded);
+  RUN_TEST(test_clear);
+  RUN_TEST(test_user_words);
+  RUN_TEST(test_discard_while_reading);
+  RUN_TEST(test_read_at);
+  RUN_TEST(test_read_frames);
+  RUN_TEST(test_append_pending);
+  RUN_TEST(test_append_pending_fails);
+  RUN_TEST(test_append_fails);
+  RUN_TEST(test_mount_is_bounded);
+  RUN_TEST(test_power_loss);
+  RUN_TEST(test_oversize_record);
+  return UNITY_END();
+}
@@ -0,0 +1,170 @@
+/***** Includes *****/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "unity.h"
+#include "timekeeper.h"
+
+/***** Defines *****/
+
+#define _US (1000000LL)
+#define _START_US (1546300800LL * _US)
+#define _WAKE_US (900LL * _US)
+#define _ERROR_MAX_MS (2000)
+
+/***** Structs *****/
+
+// A system clock running drift_ppm fast, set to UTC at every sync.
+struct _clock {
+  int64_t utc_us;
+  int64_t clock_us;
+  double drift_ppm;
+};
+
+/***** Local Data *****/
+
+static struct timekeeper _tk;
+
+/***** Local Functions *****/
+
+static void
+_clock_run(struct _clock * clock, int64_t us)
+{
+  clock->utc_us += us;
+  clock->clock_us += us + (int64_t) (us * clock->drift_ppm / 1e6);
+}
+
+static void
+_clock_sync(struct _clock * clock, int64_t noise_us)
+{
+  timekeeper_sync(&_tk, clock->clock_us, clock->utc_us + noise_us);
+  clock->clock_us = clock->utc_us + noise_us;
+}
+
+// Wake every 15 minutes for hours, syncing when the error bound is exceeded
+// as task_measure does. Returns the number of syncs.
+static uint32_t
+_run(struct _clock * clock, uint32_t hours, int64_t * error_max_us)
+{
+  uint32_t wakes = hours * 4;
+  uint32_t syncs = 0;
+  int64_t error_us = 0;
+  uint32_t n = 0;
+
+  for (n = 0; n < wakes; n++) {
+    _clock_run(clock, _WAKE_US);
+
+    if (timekeeper_error_ms(&_tk, clock->clock_us) > _ERROR_MAX_MS) {
+      _clock_sync(clock, (rand() % 100001) - 50000);
+      syncs++;
+    }
+
+    error_us = llabs(timekeeper_now_us(&_tk, clock->clock_us) - clock->utc_us);
+    *error_max_us = (error_us > *error_max_us) ? error_us : *error_max_us;
+  }
+
+  return syncs;
+}
+
+/***** Unit Tests *****/
+
+void
+setUp(void)
+{
+  memset(&_tk, 0xa5, sizeof(_tk));
+  timekeeper_init(&_tk);
+  srand(1);
+}
+
+void
+tearDown(void)
+{
+}
+
+static void
+test_not_set(void)
+{
+  TEST_ASSERT_FALSE(timekeeper_is_set(&_tk));
+  TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, timekeeper_error_ms(&_tk, _START_US));
+  TEST_ASSERT_TRUE(_START_US == timekeeper_now_us(&_tk, _START_US));
+
+  timekeeper_sync(&_tk, 0, _START_US);
+  TEST_ASSERT_TRUE(timekeeper_is_set(&_tk));
+  TEST_ASSERT_EQUAL_UINT32(TIMEKEEPER_SYNC_ERROR_MS,
+    timekeeper_error_ms(&_tk, _START_US));
+
+  // Survives deep sleep.
+  timekeeper_init(&_tk);
+  TEST_ASSERT_TRUE(timekeeper_is_set(&_tk));
+}
+
+static void
+test_drift_is_learned(void)
+{
+  struct _clock clock = {_START_US, 0, 1500};
+  int64_t error_max_us = 0;
+  uint32_t syncs = 0;
+
+  _clock_sync(&clock, 0);
+
+  // The first wake syncs as the drift is unknown, the next syncs get further
+  // apart as it is learned.
+  syncs = _run(&clock, 24, &error_max_us);
+  TEST_ASSERT_TRUE((syncs >= 2) && (syncs <= 5));
+  TEST_ASSERT_FLOAT_WITHIN(10, 1500, (float) _tk.drift_ppm);
+
+  // Then about twice a day, and the error stays within the bound.
+  error_max_us = 0;
+  syncs = _run(&clock, 48, &error_max_us);
+  TEST_ASSERT_TRUE(syncs <= 6);
+  TEST_ASSERT_TRUE(error_max_us <= (_ERROR_MAX_MS * 1000LL));
+  TEST_ASSERT_FLOAT_WITHIN(10, 1500, (float) _tk.drift_ppm);
+}
+
+static void
+test_drift_follows_temperature(void)
+{
+  struct _clock clock = {_START_US, 0, -800};
+  int64_t error_max_us = 0;
+
+  _clock_sync(&clock, 0);
+  _run(&clock, 48, &error_max_us);
+  TEST_ASSERT_FLOAT_WITHIN(10, -800, (float) _tk.drift_ppm);
+
+  clock.drift_ppm = -600;
+  error_max_us = 0;
+  _run(&clock, 72, &error_max_us);
+  TEST_ASSERT_FLOAT_WITHIN(20, -600, (float) _tk.drift_ppm);
+}
+
+static void
+test_clock_jump_ignored(void)
+{
+  struct _clock clock = {_START_US, 0, 1000};
+  int64_t error_max_us = 0;
+
+  _clock_sync(&clock, 0);
+  _run(&clock, 24, &error_max_us);
+
+  // Something else set the clock an hour off.
+  _clock_run(&clock, _WAKE_US);
+  clock.clock_us += 3600 * _US;
+  _clock_sync(&clock, 0);
+  TEST_ASSERT_FLOAT_WITHIN(10, 1000, (float) _tk.drift_ppm);
+}
+
+/***** Global Functions *****/
+
+int
+main(void)
+{
+  UNITY_BEGIN();
+
+  RUN_TEST(test_not_set);
+  RUN_TEST(test_drift_is_learned);
+  RUN_TEST(test_drift_follows_temperature);
+  RUN_TEST(test_clock_jump_ignored);
+
+  return UNITY_END();
+}
@@ -0,0 +1,189 @@
+/***** Includes *****/
+
+#include <string.h>
+
+#include "unity.h"
+#include "esp_timer.h"
+#include "wake_timing.h"
+
+/***** Local Functions *****/
+
+// One wake as task_measure runs it, sensor_ms long for the sensor read and
+// connected or not.
+static void
+_wake(uint32_t sensor_ms, bool is_connected)
+{
+  esp_timer_host_set(300 * 1000);
+  wake_timing_init();
+
+  wake_timing_begin(WAKE_PHASE_SENSOR_READ);
+  esp_timer_host_advance(sensor_ms * 1000);
+  wake_timing_end(WAKE_PHASE_SENSOR_READ);
+
+  if (is_connected) {
+    wake_timing_begin(WAKE_PHASE_WIFI_CONNECT);
+    esp_timer_host_advance(1200 * 1000);
+    wake_timing_end(WAKE_PHASE_WIFI_CONNECT);
+  }
+
+  esp_timer_host_advance(100 * 1000);
+  wake_timing_commit();
+}
+
+/***** Unit Tests *****/
+
+void
+setUp(void)
+{
+  wake_timing_init();
+  wake_timing_clear();
+}
+
+void
+tearDown(void)
+{
+}
+
+static void
+test_phases(void)
+{
+  struct wake_timing_stats stats;
+
+  _wake(250, true);
+  TEST_ASSERT_EQUAL_UINT32(1, wake_timing_total());
+
+  TEST_ASSERT_TRUE(wake_timing_stats(WAKE_PHASE_BOOT, &stats));
+  TEST_ASSERT_EQUAL_UINT32(300, stats.max);
+  TEST_ASSERT_TRUE(wake_timing_stats(WAKE_PHASE_SENSOR_READ, &stats));
+  TEST_ASSERT_EQUAL_UINT32(250, stats.max);
+  TEST_ASSERT_TRUE(wake_timing_stats(WAKE_PHASE_AWAKE, &stats));
+  TEST_ASSERT_EQUAL_UINT32(300 + 250 + 1200 + 100, stats.max);
+  TEST_ASSERT_FALSE(wake_timing_stats(WAKE_PHASE_SHADOW_GET, &stats));
+}
+
+static void
+test_repeated_phase_adds_up(void)
+{
+  struct wake_timing_stats stats;
+
+  esp_timer_host_set(0);
+  wake_timing_init();
+  wake_timing_begin(WAKE_PHASE_PUBLISH);
+  esp_timer_host_advance(40 * 1000);
+  wake_timing_end(WAKE_PHASE_PUBLISH);
+  wake_timing_begin(WAKE_PHASE_PUBLISH);
+  esp_timer_host_advance(60 * 1000);
+  wake_timing_end(WAKE_PHASE_PUBLISH);
+  wake_timing_commit();
+
+  TEST_ASSERT_TRUE(wake_timing_stats(WAKE_PHASE_PUBLISH, &stats));
+  TEST_ASSERT_EQUAL_UINT32(100, stats.max);
+}
+
+static void
+test_stats(void)
+{
+  struct wake_timing_stats stats;
+  uint32_t n = 0;
+
+  // 1..10 x 100 ms, in an order that is not sorted.
+  for (n = 0; n < 10; n++) {
+    _wake(((n * 7) % 10 + 1) * 100, (0 == (n % 2)));
+  }
+
+  TEST_ASSERT_TRUE(wake_timing_stats(WAKE_PHASE_SENSOR_READ, &stats));
+  TEST_ASSERT_EQUAL_UINT32(10, stats.count);
+  TEST_ASSERT_EQUAL_UINT32(100, stats.min);
+  TEST_ASSERT_EQUAL_UINT32(600, stats.p50);
+  TEST_ASSERT_EQUAL_UINT32(1000, stats.p90);
+  TEST_ASSERT_EQUAL_UINT32(1000, stats.max);
+
+  // Only counts the wakes the phase ran on.
+  TEST_ASSERT_TRUE(wake_timing_stats(WAKE_PHASE_WIFI_CONNECT, &stats));
+  TEST_ASSERT_EQUAL_UINT32(5, stats.count);
+}
+
+static void
+test_ring_wraps(void)
+{
+  struct wake_timing_stats stats;
+  uint32_t n = 0;
+
+  for (n = 0; n < WAKE_TIMING_LEN; n++) {
+    _wake(100, false);
+  }
+  for (n = 0; n < 4; n++) {
+    _wake(500, false);
+  }
+
+  TEST_ASSERT_EQUAL_UINT32(WAKE_TIMING_LEN, wake_timing_total());
+  TEST_ASSERT_TRUE(wake_timing_stats(WAKE_PHASE_SENSOR_READ, &stats));
+  TEST_ASSERT_EQUAL_UINT32(WAKE_TIMING_LEN, stats.count);
+  TEST_ASSERT_EQUAL_UINT32(500, stats.max);
+
+  // Survives deep sleep, forgotten once published.
+  wake_timing_init();
+  TEST_ASSERT_EQUAL_UINT32(WAKE_TIMING_LEN, wake_timing_total());
+  wake_timing_clear();
+  TEST_ASSERT_EQUAL_UINT32(0, wake_timing_total());
+}
+
+static void
+test_format_json(void)
+{
+  char buf[1024];
+
+  _wake(250, true);
+  _wake(350, false);
+
+  TEST_ASSERT_TRUE(wake_timing_format_json(buf, sizeof(buf), "peep"));
+  TEST_ASSERT_EQUAL_STRING(
+    "{\"peepUUID\":\"peep\",\"wakes\":2,\"phases\":{"
+    "\"boot\":{\"n\":2,\"min\":300,\"p50\":300,\"p90\":300,\"max\":300},"
+    "\"sensorRead\":{\"n\":2,\"min\":250,\"p50\":350,\"p90\":350,\"max\":350},"
+    "\"wifiConnect\":{\"n\":1,\"min\":1200,\"p50\":1200,\"p90\":1200,"
+    "\"max\":1200},"
+    "\"awake\":{\"n\":2,\"min\":750,\"p50\":1850,\"p90\":1850,\"max\":1850}}}",
+    buf);
+
+  // Fails rather than cut the message short.
+  TEST_ASSERT_FALSE(wake_timing_format_json(buf, 64, "peep"));
+}
+
+static void
+test_format_json_fits(void)
+{
+  const char * peep_uuid = "0e4c4f26-1cae-4d3f-8e44-5a4c6d14e1a9";
+  // Payload room aws_mqtt_publish_begin() leaves in the 1024 byte TX buffer.
+  char buf[1024 - (1 + 2 + 2 + sizeof("hatchtrack/telemetry/put") - 1)];
+  uint32_t n = 0;
+
+  // Every phase ran, each for the longest time that can be recorded.
+  esp_timer_host_set(0);
+  wake_timing_init();
+  for (n = 0; n < WAKE_PHASE_TOTAL; n++) {
+    wake_timing_begin(n);
+    esp_timer_host_advance(70 * 1000 * 1000);
+    wake_timing_end(n);
+  }
+  wake_timing_commit();
+
+  TEST_ASSERT_TRUE(wake_timing_format_json(buf, sizeof(buf), peep_uuid));
+}
+
+/***** Global Functions *****/
+
+int
+main(void)
+{
+  UNITY_BEGIN();
+
+  RUN_TEST(test_phases);
+  RUN_TEST(test_repeated_phase_adds_up);
+  RUN_TEST(test_stats);
+  RUN_TEST(test_ring_wraps);
+  RUN_TEST(test_format_json);
+  RUN_TEST(test_format_json_fits);
+
+  return UNITY_END();
+}
@@ -0,0 +1,223 @@
+/***** Includes *****/
+
+#include <string.h>
+
+#include "unity.h"
+#include "wifi_cache.h"
+
+/***** Defines *****/
+
+#define _SSID "peep-net"
+#define _NOW (1546300800)
+
+/***** Structs *****/
+
+// Access point the mocked driver finds, and what it was asked to do.
+struct _mock {
+  struct wifi_link ap;
+  bool is_ap_up;
+  bool is_lease_valid;
+  uint32_t full;
+  uint32_t fast;
+  uint32_t fast_static_ip;
+  uint32_t timeout_ms;
+  bool is_connected;
+};
+
+/***** Local Data *****/
+
+static struct _mock _mock;
+static struct wifi_cache _cache;
+
+/***** Local Functions *****/
+
+static bool
+_connect(void * ctx, const struct wifi_link * link, bool is_static_ip,
+  uint32_t timeout_ms)
+{
+  struct _mock * mock = ctx;
+
+  mock->timeout_ms = timeout_ms;
+  mock->is_connected = false;
+
+  if (NULL == link) {
+    mock->full++;
+    mock->is_connected = mock->is_ap_up;
+  }
+  else {
+    mock->fast += (is_static_ip) ? 0 : 1;
+    mock->fast_static_ip += (is_static_ip) ? 1 : 0;
+    mock->is_connected = mock->is_ap_up &&
+      (0 == memcmp(link->bssid, mock->ap.bssid, sizeof(link->bssid))) &&
+      (link->channel == mock->ap.channel) &&
+      (!is_static_ip || mock->is_lease_valid);
+  }
+
+  return mock->is_connected;
+}
+
+static bool
+_get_link(void * ctx, struct wifi_link * link)
+{
+  struct _mock * mock = ctx;
+
+  *link = mock->ap;
+
+  return mock->is_connected;
+}
+
+static const struct wifi_driver _driver = {_connect, _get_link, &_mock};
+
+static bool
+_wake(uint32_t now_sec)
+{
+  _mock.full = 0;
+  _mock.fast = 0;
+  _mock.fast_static_ip = 0;
+
+  return wifi_cache_connect(&_cache, &_driver, _SSID, now_sec, 3000, 15000);
+}
+
+/***** Unit Tests *****/
+
+void
+setUp(void)
+{
+  const struct wifi_link ap = {
+    {0x24, 0x0a, 0xc4, 0x01, 0x02, 0x03}, 6,
+    0x6401a8c0, 0x00ffffff, 0x0101a8c0, 0x0101a8c0};
+
+  memset(&_mock, 0, sizeof(_mock));
+  _mock.ap = ap;
+  _mock.is_ap_up = true;
+  _mock.is_lease_valid = true;
+  wifi_cache_invalidate(&_cache);
+}
+
+void
+tearDown(void)
+{
+}
+
+static void
+test_first_connect_is_full(void)
+{
+  TEST_ASSERT_EQUAL(WIFI_CACHE_PLAN_FULL,
+    wifi_cache_plan(&_cache, _SSID, _NOW));
+  TEST_ASSERT_TRUE(_wake(_NOW));
+  TEST_ASSERT_EQUAL_UINT32(1, _mock.full);
+  TEST_ASSERT_EQUAL_UINT32(15000, _mock.timeout_ms);
+  TEST_ASSERT_EQUAL_UINT8(6, _cache.link.channel);
+}
+
+static void
+test_next_connect_is_fast(void)
+{
+  TEST_ASSERT_TRUE(_wake(_NOW));
+
+  TEST_ASSERT_TRUE(_wake(_NOW + 900));
+  TEST_ASSERT_EQUAL_UINT32(1, _mock.fast_static_ip);
+  TEST_ASSERT_EQUAL_UINT32(0, _mock.full);
+  TEST_ASSERT_EQUAL_UINT32(3000, _mock.timeout_ms);
+
+  // Reusing the lease does not renew it, it ages from the DHCP at _NOW.
+  TEST_ASSERT_EQUAL(WIFI_CACHE_PLAN_FAST_STATIC_IP,
+    wifi_cache_plan(&_cache, _SSID, _NOW + WIFI_CACHE_IP_AGE_MAX_SEC - 1));
+  TEST_ASSERT_EQUAL(WIFI_CACHE_PLAN_FAST,
+    wifi_cache_plan(&_cache, _SSID, _NOW + WIFI_CACHE_IP_AGE_MAX_SEC));
+  TEST_ASSERT_TRUE(_wake(_NOW + WIFI_CACHE_IP_AGE_MAX_SEC));
+  TEST_ASSERT_EQUAL_UINT32(1, _mock.fast);
+  TEST_ASSERT_EQUAL_UINT32(0, _mock.full);
+
+  // DHCP renewed it.
+  TEST_ASSERT_TRUE(_wake(_NOW + WIFI_CACHE_IP_AGE_MAX_SEC + 900));
+  TEST_ASSERT_EQUAL_UINT32(1, _mock.fast_static_ip);
+}
+
+static void
+test_fast_falls_back_to_full(void)
+{
+  TEST_ASSERT_TRUE(_wake(_NOW));
+
+  // The access point moved to another channel.
+  _mock.ap.channel = 11;
+  TEST_ASSERT_TRUE(_wake(_NOW + 900));
+  TEST_ASSERT_EQUAL_UINT32(1, _mock.fast_static_ip);
+  TEST_ASSERT_EQUAL_UINT32(1, _mock.full);
+  TEST_ASSERT_EQUAL_UINT32(12000, _mock.timeout_ms);
+  TEST_ASSERT_EQUAL_UINT8(11, _cache.link.channel);
+
+  TEST_ASSERT_TRUE(_wake(_NOW + 1800));
+  TEST_ASSERT_EQUAL_UINT32(0, _mock.full);
+}
+
+static void
+test_rejected_lease(void)
+{
+  TEST_ASSERT_TRUE(_wake(_NOW));
+
+  _mock.is_lease_valid = false;
+  TEST_ASSERT_TRUE(_wake(_NOW + 900));
+  TEST_ASSERT_EQUAL_UINT32(1, _mock.fast_static_ip);
+  TEST_ASSERT_EQUAL_UINT32(1, _mock.full);
+}
+
+static void
+test_clock_went_backwards(void)
+{
+  TEST_ASSERT_TRUE(_wake(_NOW));
+
+  TEST_ASSERT_EQUAL(WIFI_CACHE_PLAN_FAST,
+    wifi_cache_plan(&_cache, _SSID, _NOW - 1));
+}
+
+static void
+test_ssid_changed(void)
+{
+  TEST_ASSERT_TRUE(_wake(_NOW));
+
+  TEST_ASSERT_EQUAL(WIFI_CACHE_PLAN_FULL,
+    wifi_cache_plan(&_cache, "other-net", _NOW + 900));
+}
+
+static void
+test_access_point_down(void)
+{
+  uint32_t n = 0;
+
+  TEST_ASSERT_TRUE(_wake(_NOW));
+
+  _mock.is_ap_up = false;
+  for (n = 0; n < WIFI_CACHE_FAILURES_MAX; n++) {
+    TEST_ASSERT_NOT_EQUAL(WIFI_CACHE_PLAN_FULL,
+      wifi_cache_plan(&_cache, _SSID, _NOW + 900));
+    TEST_ASSERT_FALSE(_wake(_NOW + 900));
+    TEST_ASSERT_EQUAL_UINT32(1, _mock.full);
+  }
+
+  // Given up on the cached access point.
+  TEST_ASSERT_EQUAL(WIFI_CACHE_PLAN_FULL,
+    wifi_cache_plan(&_cache, _SSID, _NOW + 900));
+  _mock.is_ap_up = true;
+  TEST_ASSERT_TRUE(_wake(_NOW + 900));
+  TEST_ASSERT_EQUAL(WIFI_CACHE_PLAN_FAST_STATIC_IP,
+    wifi_cache_plan(&_cache, _SSID, _NOW + 1800));
+}
+
+/***** Global Functions *****/
+
+int
+main(void)
+{
+  UNITY_BEGIN();
+
+  RUN_TEST(test_first_connect_is_full);
+  RUN_TEST(test_next_connect_is_fast);
+  RUN_TEST(test_fast_falls_back_to_full);
+  RUN_TEST(test_rejected_lease);
+  RUN_TEST(test_clock_went_backwards);
+  RUN_TEST(test_ssid_changed);
+  RUN_TEST(test_access_point_down);
+
+  return UNITY_END();
+}
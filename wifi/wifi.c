@@ -4,18 +4,25 @@
 #include <time.h>
 #include <sys/time.h>
 
-#include "lwip/apps/sntp.h"
-
 #include "wifi.h"
+#include "wifi_cache.h"
 #include "system.h"
 #include "freertos/event_groups.h"
+#include "esp_attr.h"
 #include "esp_wifi.h"
 #include "esp_event_loop.h"
 #include "lwip/err.h"
+#include "lwip/netdb.h"
+#include "lwip/sockets.h"
 
 /***** Defines *****/
 
-#define POLL_SEC (1)
+#define NTP_SERVER "pool.ntp.org"
+#define NTP_PACKET_LEN (48)
+// Seconds from the NTP epoch in 1900 to the Unix epoch.
+#define NTP_UNIX_OFFSET (2208988800UL)
+// Time the cached access point gets before falling back to a full scan.
+#define FAST_TIMEOUT_MS (3000)
 
 /***** Local Data *****/
 
@@ -29,6 +36,10 @@ const int WIFI_CONNECTED_BIT = BIT0;
 const int WIFI_DISCONNECT_BIT = BIT1;
 
 static volatile bool _is_active = false;
+static bool _is_started = false;
+static wifi_config_t _wifi_config;
+// Last good access point and IP lease, to skip the scan and DHCP next wake.
+static RTC_DATA_ATTR struct wifi_cache _cache;
 
 /***** Local Functions *****/
 
@@ -88,108 +99,163 @@ _event_handler(void *ctx, system_event_t *event)
   return ESP_OK;
 }
 
+// struct wifi_driver connect() on top of esp_wifi. Every attempt starts the
+// station afresh, so a fallback does not race the previous attempt.
 static bool
-_init_time(int32_t timeout_sec)
+_driver_connect(void * ctx, const struct wifi_link * link, bool is_static_ip,
+  uint32_t timeout_ms)
 {
-  const TickType_t poll_ticks = (POLL_SEC * 1000) / portTICK_PERIOD_MS;
-  const int retry_max = timeout_sec / POLL_SEC;
-  struct tm timeinfo = {0};
-  time_t now = 0;
-  int retry = 0;
-  bool r = true;
+  tcpip_adapter_ip_info_t ip_info;
+  tcpip_adapter_dns_info_t dns_info;
+  tcpip_adapter_dhcp_status_t dhcp_status;
+  EventBits_t bits = 0;
 
-  time(&now);
-  localtime_r(&now, &timeinfo);
-  // Is time set? If not, tm_year will be (1970 - 1900).
-  if (timeinfo.tm_year < (2016 - 1900)) {
-    LOGI("time not set, initializing SNTP");
-    sntp_setoperatingmode(SNTP_OPMODE_POLL);
-    sntp_setservername(0, "pool.ntp.org");
-    sntp_init();
-
-    // wait for time to be set
-    while ((timeinfo.tm_year < (2016 - 1900)) && (++retry < retry_max)) {
-      vTaskDelay(poll_ticks);
-      time(&now);
-      localtime_r(&now, &timeinfo);
-    }
+  (void) ctx;
+
+  if (_is_started) {
+    _is_active = false;
+    esp_wifi_stop();
+    _is_started = false;
   }
 
-  if (retry < retry_max) {
-    LOGI(
-      "%d-%d-%d %d:%d:%d",
-      timeinfo.tm_year + 1900,
-      timeinfo.tm_mon + 1,
-      timeinfo.tm_mday,
-      timeinfo.tm_hour,
-      timeinfo.tm_min,
-      timeinfo.tm_sec);
-    r = true;
+  if (NULL != link) {
+    _wifi_config.sta.bssid_set = true;
+    memcpy(_wifi_config.sta.bssid, link->bssid, sizeof(link->bssid));
+    _wifi_config.sta.channel = link->channel;
+    _wifi_config.sta.scan_method = WIFI_FAST_SCAN;
   }
   else {
-    LOGE("failed to sync time");
-    r = false;
+    _wifi_config.sta.bssid_set = false;
+    _wifi_config.sta.channel = 0;
+    _wifi_config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+  }
+
+  if (is_static_ip) {
+    memset(&ip_info, 0, sizeof(ip_info));
+    ip_info.ip.addr = link->ip;
+    ip_info.netmask.addr = link->netmask;
+    ip_info.gw.addr = link->gateway;
+    memset(&dns_info, 0, sizeof(dns_info));
+    dns_info.ip.type = IPADDR_TYPE_V4;
+    dns_info.ip.u_addr.ip4.addr = link->dns;
+
+    tcpip_adapter_dhcpc_stop(TCPIP_ADAPTER_IF_STA);
+    tcpip_adapter_set_ip_info(TCPIP_ADAPTER_IF_STA, &ip_info);
+    tcpip_adapter_set_dns_info(TCPIP_ADAPTER_IF_STA, TCPIP_ADAPTER_DNS_MAIN,
+      &dns_info);
+  }
+  else {
+    tcpip_adapter_dhcpc_get_status(TCPIP_ADAPTER_IF_STA, &dhcp_status);
+    if (TCPIP_ADAPTER_DHCP_STOPPED == dhcp_status) {
+      tcpip_adapter_dhcpc_start(TCPIP_ADAPTER_IF_STA);
+    }
+  }
+
+  xEventGroupClearBits(_wifi_event_group, WIFI_CONNECTED_BIT);
+  _is_active = true;
+  ESP_ERROR_CHECK( esp_wifi_set_config(WIFI_IF_STA, &_wifi_config) );
+  ESP_ERROR_CHECK( esp_wifi_start() );
+  _is_started = true;
+
+  bits = xEventGroupWaitBits(
+    _wifi_event_group,
+    WIFI_CONNECTED_BIT,
+    false,
+    true,
+    timeout_ms / portTICK_PERIOD_MS);
+
+  return (bits & WIFI_CONNECTED_BIT) ? true : false;
+}
+
+static bool
+_driver_get_link(void * ctx, struct wifi_link * link)
+{
+  wifi_ap_record_t ap;
+  tcpip_adapter_ip_info_t ip_info;
+  tcpip_adapter_dns_info_t dns_info;
+  bool r = true;
+
+  (void) ctx;
+
+  r = (ESP_OK == esp_wifi_sta_get_ap_info(&ap)) &&
+    (ESP_OK == tcpip_adapter_get_ip_info(TCPIP_ADAPTER_IF_STA, &ip_info)) &&
+    (ESP_OK == tcpip_adapter_get_dns_info(TCPIP_ADAPTER_IF_STA,
+      TCPIP_ADAPTER_DNS_MAIN, &dns_info));
+
+  if (r) {
+    memcpy(link->bssid, ap.bssid, sizeof(link->bssid));
+    link->channel = ap.primary;
+    link->ip = ip_info.ip.addr;
+    link->netmask = ip_info.netmask.addr;
+    link->gateway = ip_info.gw.addr;
+    link->dns = dns_info.ip.u_addr.ip4.addr;
   }
 
   return r;
 }
 
+static int64_t
+_clock_us(void)
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+
+  return ((int64_t) tv.tv_sec * 1000000) + tv.tv_usec;
+}
+
+static uint32_t
+_be32(const uint8_t * buf)
+{
+  return ((uint32_t) buf[0] << 24) | ((uint32_t) buf[1] << 16) |
+    ((uint32_t) buf[2] << 8) | buf[3];
+}
+
 /***** Global Functions *****/
 
 bool
 wifi_connect(char * ssid, char * password, int32_t timeout_sec)
 {
-  const TickType_t poll_ticks = (POLL_SEC * 1000) / portTICK_PERIOD_MS;
+  const struct wifi_driver driver = {_driver_connect, _driver_get_link, NULL};
   wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-  wifi_config_t wifi_config;
-  EventBits_t bits = 0;
+  enum wifi_cache_plan plan = WIFI_CACHE_PLAN_FULL;
+  TickType_t start = 0;
+  uint32_t ms = 0;
   bool r = true;
 
   // IF YOU DON'T DO THIS, YOU WILL HAVE A GARBAGE FILLED STRUCT
-  memset(&wifi_config, 0, sizeof(wifi_config_t));
+  memset(&_wifi_config, 0, sizeof(wifi_config_t));
   // Do one less than max length to make sure values are NULL terminated.
-  strncpy((char *) wifi_config.sta.ssid, ssid, WIFI_SSID_LEN_MAX-1);
-  strncpy((char *) wifi_config.sta.password, password, WIFI_PASSWORD_LEN_MAX-1);
+  strncpy((char *) _wifi_config.sta.ssid, ssid, WIFI_SSID_LEN_MAX-1);
+  strncpy((char *) _wifi_config.sta.password, password,
+    WIFI_PASSWORD_LEN_MAX-1);
 
   if (r) {
-    _is_active = true;
     tcpip_adapter_init();
     _wifi_event_group = xEventGroupCreate();
     ESP_ERROR_CHECK( esp_event_loop_init(_event_handler, NULL) );
     ESP_ERROR_CHECK( esp_wifi_init(&cfg) );
     ESP_ERROR_CHECK( esp_wifi_set_storage(WIFI_STORAGE_RAM) );
     ESP_ERROR_CHECK( esp_wifi_set_mode(WIFI_MODE_STA) );
-    ESP_ERROR_CHECK( esp_wifi_set_config(WIFI_IF_STA, &wifi_config) );
-    ESP_ERROR_CHECK( esp_wifi_start() );
-
-    LOGI("%d second connection timeout", timeout_sec);
-    while ((0 == (bits & WIFI_CONNECTED_BIT)) && (timeout_sec > 0)) {
-      /* Wait for WiFI to show as connected */
-      bits = xEventGroupWaitBits(
-        _wifi_event_group,
-        WIFI_CONNECTED_BIT,
-        false,
-        true,
-        poll_ticks);
-      
-      if (0 == (bits & WIFI_CONNECTED_BIT)) {
-        timeout_sec -= POLL_SEC;
-      }
-    }
 
-    if (bits & WIFI_CONNECTED_BIT) {
-      ESP_LOGI(__func__, "connected to SSID %s", wifi_config.sta.ssid);
+    plan = wifi_cache_plan(&_cache, ssid, time(NULL));
+    LOGI("%d second connection timeout, %s connect", timeout_sec,
+      (WIFI_CACHE_PLAN_FAST_STATIC_IP == plan) ? "fast static IP" :
+      (WIFI_CACHE_PLAN_FAST == plan) ? "fast" : "full");
+
+    start = xTaskGetTickCount();
+    r = wifi_cache_connect(&_cache, &driver, ssid, time(NULL),
+      FAST_TIMEOUT_MS, timeout_sec * 1000);
+    ms = (xTaskGetTickCount() - start) * portTICK_PERIOD_MS;
+
+    if (r) {
+      ESP_LOGI(__func__, "connected to SSID %s in %d ms", ssid, ms);
     }
     else {
-      ESP_LOGE(__func__, "failed to connect to SSID %s", wifi_config.sta.ssid);
-      r = false;
+      ESP_LOGE(__func__, "failed to connect to SSID %s", ssid);
     }
   }
 
-  if (r) {
-    r = _init_time(timeout_sec);
-  }
-
   return r;
 }
 
@@ -200,6 +266,7 @@ wifi_disconnect(void)
   EventBits_t bits = 0;
 
   _is_active = false;
+  _is_started = false;
 
   r = esp_wifi_stop();
   if (ESP_OK != r) {
@@ -225,3 +292,77 @@ wifi_disconnect(void)
 
   return (ESP_OK == r) ? true : false;
 }
+
+bool
+wifi_time_query(int32_t timeout_sec, int64_t * clock_us, int64_t * ntp_us)
+{
+  const struct addrinfo hints = {
+    .ai_family = AF_INET,
+    .ai_socktype = SOCK_DGRAM,
+  };
+  struct addrinfo * res = NULL;
+  uint8_t packet[NTP_PACKET_LEN];
+  struct timeval tv;
+  int64_t sent_us = 0;
+  int64_t received_us = 0;
+  uint32_t sec = 0;
+  uint32_t frac = 0;
+  int s = -1;
+  bool r = true;
+
+  if (0 != getaddrinfo(NTP_SERVER, "123", &hints, &res)) {
+    LOGE("failed to resolve %s", NTP_SERVER);
+    r = false;
+  }
+
+  if (r) {
+    s = socket(AF_INET, SOCK_DGRAM, 0);
+    r = (0 <= s) ? true : false;
+  }
+
+  if (r) {
+    tv.tv_sec = timeout_sec;
+    tv.tv_usec = 0;
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    // Version 3 client request, everything else zero.
+    memset(packet, 0, sizeof(packet));
+    packet[0] = (3 << 3) | 3;
+    sent_us = _clock_us();
+    r = (sizeof(packet) == sendto(s, packet, sizeof(packet), 0, res->ai_addr,
+      res->ai_addrlen)) ? true : false;
+  }
+
+  if (r) {
+    r = (sizeof(packet) == recv(s, packet, sizeof(packet), 0)) ? true : false;
+    received_us = _clock_us();
+    if (!r) {
+      LOGE("no answer from %s", NTP_SERVER);
+    }
+  }
+
+  if (r) {
+    // A server answer with a stratum, the transmit timestamp at byte 40.
+    sec = _be32(&packet[40]);
+    frac = _be32(&packet[44]);
+    r = ((4 == (packet[0] & 0x7)) && (0 != packet[1]) && (0 != sec)) ?
+      true : false;
+  }
+
+  if (r) {
+    *ntp_us = ((int64_t) (sec - NTP_UNIX_OFFSET) * 1000000) +
+      (((uint64_t) frac * 1000000) >> 32);
+    // The server stamped its answer about half a round trip ago.
+    *clock_us = received_us - ((received_us - sent_us) / 2);
+    LOGI("SNTP round trip %d ms", (int32_t) ((received_us - sent_us) / 1000));
+  }
+
+  if (0 <= s) {
+    close(s);
+  }
+  if (NULL != res) {
+    freeaddrinfo(res);
+  }
+
+  return r;
+}
@@ -19,4 +19,12 @@ wifi_connect(char * ssid, char * password, int32_t timeout_sec);
 extern bool
 wifi_disconnect(void);
 
+/*
+ * Ask an SNTP server for the time once connected. ntp_us is the server time
+ * and clock_us what the system clock read at that moment, both microseconds
+ * since the Unix epoch. The system clock is not set.
+ */
+extern bool
+wifi_time_query(int32_t timeout_sec, int64_t * clock_us, int64_t * ntp_us);
+
 #endif
@@ -0,0 +1,116 @@
+/***** Includes *****/
+
+#include <string.h>
+
+#include "wifi_cache.h"
+
+/***** Defines *****/
+
+#define _MAGIC (0x57494649) // "WIFI"
+
+/***** Local Functions *****/
+
+static bool
+_is_valid(const struct wifi_cache * cache, const char * ssid)
+{
+  bool r = true;
+
+  r = (_MAGIC == cache->magic) ? true : false;
+
+  if (r) {
+    r = (0 == strncmp(cache->ssid, ssid, sizeof(cache->ssid))) ? true : false;
+  }
+
+  if (r) {
+    r = (WIFI_CACHE_FAILURES_MAX > cache->failures) ? true : false;
+  }
+
+  return r;
+}
+
+static void
+_save(struct wifi_cache * cache, const struct wifi_driver * driver,
+  const char * ssid, uint32_t now_sec, bool is_static_ip)
+{
+  struct wifi_link link;
+
+  if (driver->get_link(driver->ctx, &link)) {
+    cache->magic = _MAGIC;
+    strncpy(cache->ssid, ssid, sizeof(cache->ssid) - 1);
+    cache->ssid[sizeof(cache->ssid) - 1] = 0;
+    cache->link = link;
+    cache->leased_sec = (is_static_ip) ? cache->leased_sec : now_sec;
+    cache->failures = 0;
+  }
+  else {
+    wifi_cache_invalidate(cache);
+  }
+}
+
+/***** Global Functions *****/
+
+void
+wifi_cache_invalidate(struct wifi_cache * cache)
+{
+  memset(cache, 0, sizeof(*cache));
+}
+
+enum wifi_cache_plan
+wifi_cache_plan(const struct wifi_cache * cache, const char * ssid,
+  uint32_t now_sec)
+{
+  enum wifi_cache_plan plan = WIFI_CACHE_PLAN_FULL;
+
+  if (_is_valid(cache, ssid)) {
+    plan = WIFI_CACHE_PLAN_FAST;
+
+    // A clock that went backwards says nothing about the lease age.
+    if ((0 != cache->link.ip) && (now_sec >= cache->leased_sec) &&
+        ((now_sec - cache->leased_sec) < WIFI_CACHE_IP_AGE_MAX_SEC)) {
+      plan = WIFI_CACHE_PLAN_FAST_STATIC_IP;
+    }
+  }
+
+  return plan;
+}
+
+bool
+wifi_cache_connect(struct wifi_cache * cache, const struct wifi_driver * driver,
+  const char * ssid, uint32_t now_sec, uint32_t fast_timeout_ms,
+  uint32_t timeout_ms)
+{
+  enum wifi_cache_plan plan = wifi_cache_plan(cache, ssid, now_sec);
+  bool is_static_ip = false;
+  bool r = false;
+
+  if (WIFI_CACHE_PLAN_FULL != plan) {
+    if (fast_timeout_ms > timeout_ms) {
+      fast_timeout_ms = timeout_ms;
+    }
+
+    r = driver->connect(driver->ctx, &(cache->link),
+      (WIFI_CACHE_PLAN_FAST_STATIC_IP == plan), fast_timeout_ms);
+    is_static_ip = r && (WIFI_CACHE_PLAN_FAST_STATIC_IP == plan);
+    if (!r) {
+      // The lease might be what failed, so it is not reused. If the full path
+      // fails too, the access point is retried next wake until
+      // WIFI_CACHE_FAILURES_MAX.
+      cache->failures++;
+      cache->link.ip = 0;
+      timeout_ms -= fast_timeout_ms;
+    }
+  }
+
+  if (!r && (timeout_ms > 0)) {
+    r = driver->connect(driver->ctx, NULL, false, timeout_ms);
+  }
+
+  if (r) {
+    _save(cache, driver, ssid, now_sec, is_static_ip);
+  }
+  else if (WIFI_CACHE_FAILURES_MAX <= cache->failures) {
+    wifi_cache_invalidate(cache);
+  }
+
+  return r;
+}
@@ -0,0 +1,81 @@
+#ifndef _WIFI_CACHE_H
+#define _WIFI_CACHE_H
+
+/***** Includes *****/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/***** Defines *****/
+
+// Reuse the cached IP address without DHCP while the lease is younger.
+#define WIFI_CACHE_IP_AGE_MAX_SEC (60 * 60)
+// Fast connects that may fail in a row before the cache is dropped.
+#define WIFI_CACHE_FAILURES_MAX (2)
+
+/***** Enums *****/
+
+enum wifi_cache_plan {
+  WIFI_CACHE_PLAN_FULL = 0,       // scan all channels, DHCP
+  WIFI_CACHE_PLAN_FAST,           // cached BSSID and channel, DHCP
+  WIFI_CACHE_PLAN_FAST_STATIC_IP, // cached BSSID, channel and IP lease
+};
+
+/***** Structs *****/
+
+// Addresses are IPv4 in network byte order, as lwIP keeps them.
+struct wifi_link {
+  uint8_t bssid[6];
+  uint8_t channel;
+  uint32_t ip;
+  uint32_t netmask;
+  uint32_t gateway;
+  uint32_t dns;
+};
+
+// The access point and lease of the last good connect, kept in RTC memory.
+// leased_sec is when DHCP last handed out the lease, reusing it does not
+// renew it.
+struct wifi_cache {
+  uint32_t magic;
+  char ssid[33];
+  struct wifi_link link;
+  uint32_t leased_sec;
+  uint32_t failures;
+};
+
+/*
+ * What wifi_cache_connect() needs from the WiFi driver. connect() associates
+ * and waits for an IP address: with a NULL link by scanning every channel for
+ * the SSID and running DHCP, otherwise straight to the BSSID on the channel of
+ * link, using its IP configuration when is_static_ip. get_link() fills in the
+ * link of the current connection.
+ */
+struct wifi_driver {
+  bool (*connect)(void * ctx, const struct wifi_link * link,
+    bool is_static_ip, uint32_t timeout_ms);
+  bool (*get_link)(void * ctx, struct wifi_link * link);
+  void * ctx;
+};
+
+/***** Global Functions *****/
+
+extern void
+wifi_cache_invalidate(struct wifi_cache * cache);
+
+// How to connect to ssid at Unix time now_sec given the cache.
+extern enum wifi_cache_plan
+wifi_cache_plan(const struct wifi_cache * cache, const char * ssid,
+  uint32_t now_sec);
+
+/*
+ * Connect to ssid following wifi_cache_plan(). A fast connect gets at most
+ * fast_timeout_ms and falls back to the full path on failure, which gets the
+ * rest of timeout_ms. The cache is refreshed after every successful connect.
+ */
+extern bool
+wifi_cache_connect(struct wifi_cache * cache, const struct wifi_driver * driver,
+  const char * ssid, uint32_t now_sec, uint32_t fast_timeout_ms,
+  uint32_t timeout_ms);
+
+#endif